@@ -0,0 +1,191 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+#include <gdk/gdk.h>
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+
+#include "active-window.h"
+
+struct _ActiveWindow
+{
+    Display *display;
+    Window root;
+    Atom active_atom; // _NET_ACTIVE_WINDOW
+    Window window; // None if there is no active window
+    // PropertyChangeMask was added by us, so it's removed when done
+    gboolean root_selected;
+    gboolean window_selected;
+    ActiveWindowNotify notify;
+    gpointer notify_data;
+};
+
+// Adds PropertyChangeMask to the events selected by this client, without
+// dropping the ones GDK (or anybody else in the process, like the window
+// manager in hildon-desktop) already selected. Returns TRUE if it was added.
+static gboolean
+select_property_events (ActiveWindow *active, Window window)
+{
+    XWindowAttributes attrs;
+    gboolean added = FALSE;
+
+    gdk_error_trap_push ();
+    if (XGetWindowAttributes (active->display, window, &attrs)
+            && !(attrs.your_event_mask & PropertyChangeMask)) {
+        XSelectInput (active->display, window,
+                attrs.your_event_mask | PropertyChangeMask);
+        added = TRUE;
+    }
+    gdk_error_trap_pop ();
+
+    return added;
+}
+
+// Undoes select_property_events (), keeping the rest of the mask
+static void
+unselect_property_events (ActiveWindow *active, Window window)
+{
+    XWindowAttributes attrs;
+
+    // the window might be gone already
+    gdk_error_trap_push ();
+    if (XGetWindowAttributes (active->display, window, &attrs))
+        XSelectInput (active->display, window,
+                attrs.your_event_mask & ~PropertyChangeMask);
+    gdk_error_trap_pop ();
+}
+
+static Window
+get_active_window (ActiveWindow *active)
+{
+    Atom type;
+    int format;
+    unsigned long items, bytes_after;
+    unsigned char *data = NULL;
+    Window window = None;
+
+    gdk_error_trap_push ();
+    int r = XGetWindowProperty (active->display, active->root,
+            active->active_atom, 0, 1, False, XA_WINDOW, &type, &format,
+            &items, &bytes_after, &data);
+    if (gdk_error_trap_pop () == 0 && r == Success && type == XA_WINDOW
+            && format == 32 && items == 1)
+        window = *(Window *) data;
+    if (data != NULL)
+        XFree (data);
+
+    return window;
+}
+
+static void
+report_class (ActiveWindow *active)
+{
+    XClassHint hint = { NULL, NULL };
+
+    // the window might be gone already
+    gdk_error_trap_push ();
+    if (active->window != None)
+        XGetClassHint (active->display, active->window, &hint);
+    gdk_error_trap_pop ();
+
+    active->notify (hint.res_name, hint.res_class, active->notify_data);
+
+    if (hint.res_name != NULL)
+        XFree (hint.res_name);
+    if (hint.res_class != NULL)
+        XFree (hint.res_class);
+}
+
+static void
+update_active_window (ActiveWindow *active)
+{
+    Window window = get_active_window (active);
+
+    if (window == active->window)
+        return;
+
+    if (active->window_selected)
+        unselect_property_events (active, active->window);
+    active->window = window;
+    // to know when the class changes (some toolkits set it late)
+    active->window_selected = window != None
+            && select_property_events (active, window);
+    report_class (active);
+}
+
+static GdkFilterReturn
+on_x_event (GdkXEvent *xevent, GdkEvent *event, ActiveWindow *active)
+{
+    XEvent *e = (XEvent *) xevent;
+
+    if (e->type != PropertyNotify)
+        return GDK_FILTER_CONTINUE;
+
+    if (e->xproperty.window == active->root
+            && e->xproperty.atom == active->active_atom)
+        update_active_window (active);
+    else if (e->xproperty.window == active->window
+            && e->xproperty.atom == XA_WM_CLASS)
+        report_class (active);
+
+    return GDK_FILTER_CONTINUE;
+}
+
+ActiveWindow *
+active_window_new (ActiveWindowNotify notify, gpointer data)
+{
+    ActiveWindow *active = g_slice_new (ActiveWindow);
+
+    active->display = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+    active->root = GDK_ROOT_WINDOW ();
+    active->active_atom = gdk_x11_get_xatom_by_name ("_NET_ACTIVE_WINDOW");
+    active->window = None;
+    active->window_selected = FALSE;
+    active->notify = notify;
+    active->notify_data = data;
+
+    // not through gdk_window_set_events (), it would select only the GDK
+    // events, dropping the window manager ones (SubstructureRedirectMask)
+    active->root_selected = select_property_events (active, active->root);
+    // a global filter, so we get the events of the foreign active window too
+    gdk_window_add_filter (NULL, (GdkFilterFunc) on_x_event, active);
+
+    update_active_window (active);
+    // there was no active window, but the callback is always called once
+    if (active->window == None)
+        report_class (active);
+
+    return active;
+}
+
+void
+active_window_free (ActiveWindow *active)
+{
+    gdk_window_remove_filter (NULL, (GdkFilterFunc) on_x_event, active);
+
+    if (active->window_selected)
+        unselect_property_events (active, active->window);
+    if (active->root_selected)
+        unselect_property_events (active, active->root);
+
+    g_slice_free (ActiveWindow, active);
+}
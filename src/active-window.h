@@ -0,0 +1,44 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Active window tracking. The window manager's _NET_ACTIVE_WINDOW root
+// window property and the WM_CLASS property of the active window are
+// watched through X PropertyNotify events, so nothing is polled. It works
+// with any EWMH window manager (including under Xvfb).
+
+#ifndef ACTIVE_WINDOW_H
+#define ACTIVE_WINDOW_H
+
+#include <glib.h>
+
+typedef struct _ActiveWindow ActiveWindow;
+
+// Called when the active window or its class changes, res_name and
+// res_class are the WM_CLASS parts, both NULL if there is no active window
+// or it has no class
+typedef void (*ActiveWindowNotify) (const gchar *res_name,
+        const gchar *res_class, gpointer data);
+
+// notify is called once from here with the current active window
+ActiveWindow *active_window_new (ActiveWindowNotify notify, gpointer data);
+
+void active_window_free (ActiveWindow *active);
+
+#endif // ACTIVE_WINDOW_H
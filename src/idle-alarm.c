@@ -0,0 +1,136 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+#include <string.h>
+#include <gdk/gdk.h>
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/sync.h>
+
+#include "idle-alarm.h"
+
+struct _IdleAlarm
+{
+    Display *display;
+    int event_base;
+    XSyncCounter counter; // IDLETIME
+    XSyncAlarm alarm; // None if disarmed
+    IdleAlarmNotify notify;
+    gpointer notify_data;
+};
+
+static GdkFilterReturn
+on_x_event (GdkXEvent *xevent, GdkEvent *event, IdleAlarm *alarm)
+{
+    XEvent *e = (XEvent *) xevent;
+
+    if (e->type != alarm->event_base + XSyncAlarmNotify)
+        return GDK_FILTER_CONTINUE;
+
+    XSyncAlarmNotifyEvent *ae = (XSyncAlarmNotifyEvent *) e;
+    // a destroyed alarm reports it too
+    if (alarm->alarm == None || ae->alarm != alarm->alarm
+            || ae->state == XSyncAlarmDestroyed)
+        return GDK_FILTER_CONTINUE;
+
+    alarm->notify (alarm, alarm->notify_data);
+
+    return GDK_FILTER_CONTINUE;
+}
+
+static XSyncCounter
+find_idle_counter (Display *display)
+{
+    int n = 0;
+    XSyncSystemCounter *counters = XSyncListSystemCounters (display, &n);
+    XSyncCounter counter = None;
+
+    for (int i = 0; i < n; i++)
+        if (strcmp (counters[i].name, "IDLETIME") == 0)
+            counter = counters[i].counter;
+    if (counters != NULL)
+        XSyncFreeSystemCounterList (counters);
+
+    return counter;
+}
+
+IdleAlarm *
+idle_alarm_new (IdleAlarmNotify notify, gpointer data)
+{
+    Display *display = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+    int event_base, error_base, major, minor;
+
+    if (!XSyncQueryExtension (display, &event_base, &error_base)
+            || !XSyncInitialize (display, &major, &minor))
+        return NULL;
+
+    XSyncCounter counter = find_idle_counter (display);
+    if (counter == None)
+        return NULL;
+
+    IdleAlarm *alarm = g_slice_new (IdleAlarm);
+
+    alarm->display = display;
+    alarm->event_base = event_base;
+    alarm->counter = counter;
+    alarm->alarm = None;
+    alarm->notify = notify;
+    alarm->notify_data = data;
+
+    // alarm events are not tied to any window
+    gdk_window_add_filter (NULL, (GdkFilterFunc) on_x_event, alarm);
+
+    return alarm;
+}
+
+void
+idle_alarm_free (IdleAlarm *alarm)
+{
+    idle_alarm_set (alarm, 0);
+    gdk_window_remove_filter (NULL, (GdkFilterFunc) on_x_event, alarm);
+
+    g_slice_free (IdleAlarm, alarm);
+}
+
+void
+idle_alarm_set (IdleAlarm *alarm, guint timeout)
+{
+    if (alarm->alarm != None) {
+        XSyncDestroyAlarm (alarm->display, alarm->alarm);
+        alarm->alarm = None;
+    }
+
+    if (timeout == 0)
+        return;
+
+    // triggers once, when the idle time goes up to the timeout
+    XSyncAlarmAttributes attrs;
+    attrs.trigger.counter = alarm->counter;
+    attrs.trigger.value_type = XSyncAbsolute;
+    XSyncIntToValue (&attrs.trigger.wait_value, timeout * 1000);
+    attrs.trigger.test_type = XSyncPositiveComparison;
+    XSyncIntToValue (&attrs.delta, 0);
+    attrs.events = True;
+
+    alarm->alarm = XSyncCreateAlarm (alarm->display, XSyncCACounter
+            | XSyncCAValueType | XSyncCAValue | XSyncCATestType
+            | XSyncCADelta | XSyncCAEvents, &attrs);
+    XFlush (alarm->display);
+}
@@ -0,0 +1,44 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// User idle alarm, based on the X SYNC extension IDLETIME system counter
+// (the time since the last touchscreen or keyboard input). A single X
+// alarm is set on the counter and the server sends an event when it
+// triggers, so nothing is polled. It works under Xvfb too.
+
+#ifndef IDLE_ALARM_H
+#define IDLE_ALARM_H
+
+#include <glib.h>
+
+typedef struct _IdleAlarm IdleAlarm;
+
+typedef void (*IdleAlarmNotify) (IdleAlarm *alarm, gpointer data);
+
+// NULL if the X server has no IDLETIME counter
+IdleAlarm *idle_alarm_new (IdleAlarmNotify notify, gpointer data);
+
+void idle_alarm_free (IdleAlarm *alarm);
+
+// notify is called once when there was no input for timeout seconds
+// counted from the last input, 0 disarms the alarm
+void idle_alarm_set (IdleAlarm *alarm, guint timeout);
+
+#endif // IDLE_ALARM_H
@@ -0,0 +1,784 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L // for clock_gettime ()
+
+#include <string.h>
+#include <time.h>
+#include <mce/dbus-names.h>
+#include <mce/mode-names.h>
+
+#include "inhibit-engine.h"
+#include "monotonic-time.h"
+
+
+#define INHIBIT_MSG_INTERVAL 30 // in seconds, minimum keepalive interval
+// MCE keeps the display on for this long after each MCE_PREVENT_BLANK_REQ,
+// then the regular dim/blank timeouts start counting again
+#define MCE_PREVENT_BLANK_TIMEOUT 60 // in seconds
+#define INHIBIT_MSG_MARGIN 10 // in seconds, safety margin for keepalives
+// ends the blank pause right away, so the regular timeouts apply from now.
+// The Fremantle MCE doesn't know it and ignores it, there the display stays
+// on until MCE_PREVENT_BLANK_TIMEOUT after the last keepalive, and then
+// for the dim/blank timeouts.
+#ifndef MCE_CANCEL_PREVENT_BLANK_REQ
+#define MCE_CANCEL_PREVENT_BLANK_REQ "req_display_cancel_blanking_pause"
+#endif
+
+#define MCE_DISPLAY_MATCH "type='signal',interface='" MCE_SIGNAL_IF "'," \
+        "member='" MCE_DISPLAY_SIG "'"
+#define MCE_TKLOCK_MATCH "type='signal',interface='" MCE_SIGNAL_IF "'," \
+        "member='" MCE_TKLOCK_MODE_SIG "'"
+#define MCE_OWNER_MATCH "type='signal',sender='" DBUS_SERVICE_DBUS "'," \
+        "interface='" DBUS_INTERFACE_DBUS "',member='NameOwnerChanged'," \
+        "arg0='" MCE_SERVICE "'"
+
+struct _InhibitEngine
+{
+    DBusConnection *dbus_conn;
+    DBusPendingCall *keepalive_call; // NULL if no reply is pending
+    gint64 keepalive_sent; // monotonic, in microseconds
+    gint64 last_latency;   // last keepalive round trip, in microseconds
+    gint64 max_latency;
+    GConfClient *gconf_client;
+    guint gconf_notify_ids[2]; // dim and blank timeouts
+    guint interval; // between keepalives, from the dim/blank timeouts
+    InhibitEngineNotify notify;
+    gpointer notify_data;
+    InhibitEngineState state;
+    // single deadline timer used both to send the keepalive messages and
+    // to end a timed inhibition, if == 0 no timer is set
+    gint timer_id;
+    time_t deadline; // monotonic, if == 0 the inhibition is not timed
+    time_t start;    // monotonic
+    guint wakeups;   // keepalive wakeups in the current inhibition
+    // totals for the whole engine life, wakeups_saved is compared to a
+    // fixed INHIBIT_MSG_INTERVAL
+    guint wakeups_total;
+    guint wakeups_saved;
+    guint keepalives_sent;
+    guint mode_changes;
+    guint64 inhibited_time; // finished inhibitions only, in seconds
+    // keepalives are useless while the display is off or the touchscreen
+    // is locked, so they are paused (but the deadline is still honored)
+    gboolean display_off;
+    gboolean tklocked;
+    gboolean suspended; // by inhibit_engine_suspend ()
+    // nobody gets the keepalives while MCE is not running (or restarting)
+    gboolean mce_absent;
+    DBusPendingCall *owner_query; // NULL when done
+    guint mce_restarts;
+    time_t display_on_since; // monotonic, valid while the display is on
+    guint64 display_on_time; // finished display on periods, in seconds
+    DBusPendingCall *display_query; // initial state queries, NULL when done
+    DBusPendingCall *tklock_query;
+};
+
+GQuark
+inhibit_engine_error_quark (void)
+{
+    return g_quark_from_static_string ("inhibit-engine-error-quark");
+}
+
+static void
+disable_timer (gint *timer_id)
+{
+    g_assert (*timer_id != 0);
+    gboolean ok = g_source_remove (*timer_id);
+    g_assert (ok == TRUE);
+    *timer_id = 0;
+}
+
+static gint64
+monotonic_time_usec (void)
+{
+    struct timespec ts;
+    int r = clock_gettime (CLOCK_MONOTONIC, &ts);
+    g_assert (r == 0);
+    return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+// Longest interval between keepalives that still keeps MCE from dimming
+static guint
+keepalive_interval (InhibitEngine *engine)
+{
+    // values are cached by the GConf client since the dir is added
+    gint dim = gconf_client_get_int (engine->gconf_client,
+            DIM_TIMEOUT_GCONF_KEY, NULL);
+    gint blank = gconf_client_get_int (engine->gconf_client,
+            BLANK_TIMEOUT_GCONF_KEY, NULL);
+
+    gint timeout = dim > 0 && blank > 0 ? MIN (dim, blank) : MAX (dim, blank);
+    if (timeout <= 0)
+        return INHIBIT_MSG_INTERVAL;
+
+    return MAX (INHIBIT_MSG_INTERVAL,
+            MCE_PREVENT_BLANK_TIMEOUT + timeout - INHIBIT_MSG_MARGIN);
+}
+
+static void
+cancel_keepalive_call (InhibitEngine *engine)
+{
+    dbus_pending_call_cancel (engine->keepalive_call);
+    dbus_pending_call_unref (engine->keepalive_call);
+    engine->keepalive_call = NULL;
+}
+
+static void
+on_keepalive_reply (DBusPendingCall *call, InhibitEngine *engine)
+{
+    g_assert (call == engine->keepalive_call);
+
+    engine->last_latency = monotonic_time_usec () - engine->keepalive_sent;
+    engine->max_latency = MAX (engine->max_latency, engine->last_latency);
+
+    DBusMessage *reply = dbus_pending_call_steal_reply (call);
+    dbus_pending_call_unref (call);
+    engine->keepalive_call = NULL;
+
+    if (reply == NULL)
+        return;
+
+    if (dbus_message_get_type (reply) == DBUS_MESSAGE_TYPE_ERROR)
+        g_warning ("MCE rejected the blank pause request: %s",
+                dbus_message_get_error_name (reply));
+    else
+        g_debug ("Blank pause request delivered in %.2f ms",
+                engine->last_latency / 1000.0);
+
+    dbus_message_unref (reply);
+}
+
+// MCE replies to the request, the reply is only used to measure the delivery
+// latency and report errors, nothing waits for it
+static void
+inhibit_display_blanking (InhibitEngine *engine)
+{
+    // even if it fails, the next attempt is scheduled from here
+    engine->keepalive_sent = monotonic_time_usec ();
+
+    if (!dbus_connection_get_is_connected (engine->dbus_conn)) {
+        g_warning ("Not connected to the system bus, can't inhibit blanking");
+        return;
+    }
+
+    // MCE should reply way before the next keepalive, but don't pile up calls
+    if (engine->keepalive_call != NULL) {
+        g_warning ("MCE didn't reply to the previous blank pause request");
+        cancel_keepalive_call (engine);
+    }
+
+    DBusMessage *msg = dbus_message_new_method_call (MCE_SERVICE,
+            MCE_REQUEST_PATH, MCE_REQUEST_IF, MCE_PREVENT_BLANK_REQ);
+    if (msg == NULL) {
+        g_warning ("Can't create the blank pause request");
+        return;
+    }
+
+    if (!dbus_connection_send_with_reply (engine->dbus_conn, msg,
+                &(engine->keepalive_call), -1)
+            || engine->keepalive_call == NULL) {
+        g_warning ("Can't send the blank pause request");
+        engine->keepalive_call = NULL;
+    }
+    else {
+        engine->keepalives_sent++;
+        dbus_pending_call_set_notify (engine->keepalive_call,
+                (DBusPendingCallNotifyFunction) on_keepalive_reply, engine,
+                NULL);
+        // don't wait for the main loop to get to the outgoing queue
+        dbus_connection_flush (engine->dbus_conn);
+    }
+
+    dbus_message_unref (msg);
+}
+
+// Nothing waits for a reply, MCE might not even know the request
+static void
+cancel_blanking_pause (InhibitEngine *engine)
+{
+    // its reply is of no use now
+    if (engine->keepalive_call != NULL)
+        cancel_keepalive_call (engine);
+
+    DBusMessage *msg = dbus_message_new_method_call (MCE_SERVICE,
+            MCE_REQUEST_PATH, MCE_REQUEST_IF, MCE_CANCEL_PREVENT_BLANK_REQ);
+    if (msg == NULL) {
+        g_warning ("Can't create the blank pause cancel request");
+        return;
+    }
+    dbus_message_set_no_reply (msg, TRUE);
+    if (!dbus_connection_send (engine->dbus_conn, msg, NULL))
+        g_warning ("Can't send the blank pause cancel request");
+    dbus_connection_flush (engine->dbus_conn);
+    dbus_message_unref (msg);
+}
+
+static void
+set_state (InhibitEngine *engine, InhibitEngineState state,
+        InhibitEngineReason reason)
+{
+    engine->state = state;
+    if (engine->notify != NULL)
+        engine->notify (engine, state, reason, engine->notify_data);
+}
+
+// Timed inhibitions report their keepalives, the deadline is the same but
+// the time left changed
+static void
+notify_keepalive (InhibitEngine *engine)
+{
+    if (engine->state == INHIBIT_ENGINE_TIMED)
+        set_state (engine, engine->state, INHIBIT_ENGINE_REASON_KEEPALIVE);
+}
+
+static gboolean
+is_paused (InhibitEngine *engine)
+{
+    return engine->display_off || engine->tklocked || engine->suspended
+            || engine->mce_absent;
+}
+
+static gboolean on_inhibit_timeout (InhibitEngine *engine);
+
+static void
+schedule_timer (InhibitEngine *engine)
+{
+    // while paused only the deadline (if any) needs a timer
+    if (is_paused (engine) && engine->deadline == 0)
+        return;
+
+    guint timeout = 0;
+    if (!is_paused (engine)) {
+        // counted from the last keepalive, the interval might have changed
+        // since it was sent
+        gint64 elapsed = (monotonic_time_usec () - engine->keepalive_sent)
+                / G_USEC_PER_SEC;
+        if (elapsed < engine->interval)
+            timeout = engine->interval - elapsed;
+    }
+
+    if (engine->deadline != 0) {
+        guint remaining = MAX (engine->deadline
+                - monotonic_time (), 0);
+        if (is_paused (engine) || remaining < timeout)
+            timeout = remaining;
+    }
+
+    g_assert (engine->timer_id == 0);
+    engine->timer_id = g_timeout_add_seconds (timeout,
+            (GSourceFunc) on_inhibit_timeout, engine);
+    g_assert (engine->timer_id > 0);
+}
+
+static void
+reschedule_timer (InhibitEngine *engine)
+{
+    if (engine->timer_id != 0)
+        disable_timer (&(engine->timer_id));
+    schedule_timer (engine);
+}
+
+static void
+stop (InhibitEngine *engine)
+{
+    // the timer is already gone if we got here from on_inhibit_timeout ()
+    if (engine->timer_id != 0)
+        disable_timer (&(engine->timer_id));
+    engine->deadline = 0;
+
+    // wakeups a fixed INHIBIT_MSG_INTERVAL heartbeat would have needed
+    time_t elapsed = monotonic_time () - engine->start;
+    engine->inhibited_time += elapsed;
+    guint fixed_wakeups = elapsed / INHIBIT_MSG_INTERVAL;
+    if (fixed_wakeups > engine->wakeups)
+        engine->wakeups_saved += fixed_wakeups - engine->wakeups;
+    g_debug ("Inhibition lasted %lds using %u wakeups (%u saved in total)",
+            (long) elapsed, engine->wakeups, engine->wakeups_saved);
+}
+
+static gboolean
+on_inhibit_timeout (InhibitEngine *engine)
+{
+    // the source is removed when returning FALSE
+    engine->timer_id = 0;
+    engine->wakeups++;
+    engine->wakeups_total++;
+
+    if (engine->deadline != 0
+            && monotonic_time () >= engine->deadline) {
+        stop (engine);
+        set_state (engine, INHIBIT_ENGINE_OFF, INHIBIT_ENGINE_REASON_TIMEOUT);
+        return FALSE;
+    }
+
+    gboolean paused = is_paused (engine);
+    if (!paused)
+        inhibit_display_blanking (engine);
+    schedule_timer (engine);
+    // last, the engine is consistent if the callback calls it back
+    if (!paused)
+        notify_keepalive (engine);
+
+    return FALSE;
+}
+
+static void
+update_pause (InhibitEngine *engine, gboolean was_paused)
+{
+    gboolean paused = is_paused (engine);
+
+    if (paused == was_paused)
+        return;
+    g_debug ("Keepalives %s", paused ? "paused" : "resumed");
+
+    if (engine->state == INHIBIT_ENGINE_OFF)
+        return;
+
+    // the display might blank any time now, don't wait for the timer
+    if (!paused)
+        inhibit_display_blanking (engine);
+    reschedule_timer (engine);
+    if (!paused)
+        notify_keepalive (engine);
+}
+
+static void
+on_timeout_gconf_notify (GConfClient *client, guint cnxn_id,
+        GConfEntry *entry, InhibitEngine *engine)
+{
+    guint interval = keepalive_interval (engine);
+    if (interval == engine->interval)
+        return;
+    g_debug ("Keepalive interval changed from %us to %us", engine->interval,
+            interval);
+    engine->interval = interval;
+
+    // with lower timeouts the armed timer might fire after the display
+    // dims, if the last keepalive is already too old it fires right away
+    if (engine->state != INHIBIT_ENGINE_OFF)
+        reschedule_timer (engine);
+}
+
+static void
+set_display_status (InhibitEngine *engine, const gchar *status)
+{
+    gboolean was_paused = is_paused (engine);
+    // a dimmed display is still on, and needs the keepalives to come back
+    gboolean display_off = strcmp (status, MCE_DISPLAY_OFF_STRING) == 0;
+    if (display_off && !engine->display_off)
+        engine->display_on_time += monotonic_time ()
+                - engine->display_on_since;
+    else if (!display_off && engine->display_off)
+        engine->display_on_since = monotonic_time ();
+    engine->display_off = display_off;
+    update_pause (engine, was_paused);
+}
+
+static void
+set_tklock_mode (InhibitEngine *engine, const gchar *mode)
+{
+    gboolean was_paused = is_paused (engine);
+    engine->tklocked = strcmp (mode, MCE_TK_LOCKED) == 0;
+    update_pause (engine, was_paused);
+}
+
+static void query_mce_state (InhibitEngine *engine);
+
+static void
+set_mce_absent (InhibitEngine *engine, gboolean absent)
+{
+    if (absent == engine->mce_absent)
+        return;
+
+    gboolean was_paused = is_paused (engine);
+    engine->mce_absent = absent;
+    g_debug ("MCE %s", absent ? "went away" : "is back");
+    if (!absent) {
+        // a restarted MCE doesn't know about our last keepalive, and its
+        // display and touchscreen lock might be different now
+        engine->mce_restarts++;
+        query_mce_state (engine);
+    }
+    update_pause (engine, was_paused);
+}
+
+static DBusHandlerResult
+on_dbus_message (DBusConnection *conn, DBusMessage *msg,
+        InhibitEngine *engine)
+{
+    const gchar *name, *old_owner, *new_owner;
+    if (dbus_message_is_signal (msg, DBUS_INTERFACE_DBUS, "NameOwnerChanged")
+            && dbus_message_get_args (msg, NULL, DBUS_TYPE_STRING, &name,
+                DBUS_TYPE_STRING, &old_owner, DBUS_TYPE_STRING, &new_owner,
+                DBUS_TYPE_INVALID)
+            && strcmp (name, MCE_SERVICE) == 0) {
+        set_mce_absent (engine, *new_owner == '\0');
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
+    const gchar *value = NULL;
+    gboolean display = dbus_message_is_signal (msg, MCE_SIGNAL_IF,
+            MCE_DISPLAY_SIG);
+    gboolean tklock = dbus_message_is_signal (msg, MCE_SIGNAL_IF,
+            MCE_TKLOCK_MODE_SIG);
+
+    if ((display || tklock) && dbus_message_get_args (msg, NULL,
+                DBUS_TYPE_STRING, &value, DBUS_TYPE_INVALID)) {
+        if (display)
+            set_display_status (engine, value);
+        else
+            set_tklock_mode (engine, value);
+    }
+
+    // other filters in hildon-desktop might be interested too
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+// Steals the reply from *call, returns FALSE if it was not a valid string
+static gboolean
+get_query_reply (DBusPendingCall **call, gchar **value)
+{
+    DBusMessage *reply = dbus_pending_call_steal_reply (*call);
+    dbus_pending_call_unref (*call);
+    *call = NULL;
+
+    if (reply == NULL)
+        return FALSE;
+
+    const gchar *str = NULL;
+    gboolean ok = dbus_message_get_args (reply, NULL, DBUS_TYPE_STRING, &str,
+            DBUS_TYPE_INVALID);
+    if (ok)
+        *value = g_strdup (str);
+    else
+        g_warning ("Can't get initial state from MCE: %s",
+                dbus_message_get_error_name (reply));
+
+    dbus_message_unref (reply);
+
+    return ok;
+}
+
+static void
+on_display_query_reply (DBusPendingCall *call, InhibitEngine *engine)
+{
+    gchar *status = NULL;
+    if (get_query_reply (&(engine->display_query), &status)) {
+        set_display_status (engine, status);
+        g_free (status);
+    }
+}
+
+static void
+on_tklock_query_reply (DBusPendingCall *call, InhibitEngine *engine)
+{
+    gchar *mode = NULL;
+    if (get_query_reply (&(engine->tklock_query), &mode)) {
+        set_tklock_mode (engine, mode);
+        g_free (mode);
+    }
+}
+
+static DBusPendingCall *
+query_mce (InhibitEngine *engine, const gchar *method,
+        DBusPendingCallNotifyFunction cb)
+{
+    DBusMessage *msg = dbus_message_new_method_call (MCE_SERVICE,
+            MCE_REQUEST_PATH, MCE_REQUEST_IF, method);
+    g_assert (msg != NULL);
+
+    DBusPendingCall *call = NULL;
+    if (!dbus_connection_send_with_reply (engine->dbus_conn, msg, &call, -1)
+            || call == NULL)
+        g_warning ("Can't query MCE for %s", method);
+    else
+        dbus_pending_call_set_notify (call, cb, engine, NULL);
+
+    dbus_message_unref (msg);
+
+    return call;
+}
+
+static void
+cancel_query (DBusPendingCall **call)
+{
+    if (*call == NULL)
+        return;
+
+    dbus_pending_call_cancel (*call);
+    dbus_pending_call_unref (*call);
+    *call = NULL;
+}
+
+static void
+query_mce_state (InhibitEngine *engine)
+{
+    // an older answer is outdated now
+    cancel_query (&(engine->display_query));
+    cancel_query (&(engine->tklock_query));
+
+    engine->display_query = query_mce (engine, MCE_DISPLAY_STATUS_GET,
+            (DBusPendingCallNotifyFunction) on_display_query_reply);
+    engine->tklock_query = query_mce (engine, MCE_TKLOCK_MODE_GET,
+            (DBusPendingCallNotifyFunction) on_tklock_query_reply);
+}
+
+static void
+on_owner_query_reply (DBusPendingCall *call, InhibitEngine *engine)
+{
+    DBusMessage *reply = dbus_pending_call_steal_reply (call);
+    dbus_pending_call_unref (engine->owner_query);
+    engine->owner_query = NULL;
+
+    dbus_bool_t has_owner = TRUE;
+    if (reply == NULL || !dbus_message_get_args (reply, NULL,
+                DBUS_TYPE_BOOLEAN, &has_owner, DBUS_TYPE_INVALID))
+        g_warning ("Can't know if MCE is running, assuming it is");
+    else
+        set_mce_absent (engine, !has_owner);
+
+    if (reply != NULL)
+        dbus_message_unref (reply);
+}
+
+static void
+query_mce_owner (InhibitEngine *engine)
+{
+    DBusMessage *msg = dbus_message_new_method_call (DBUS_SERVICE_DBUS,
+            DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS, "NameHasOwner");
+    g_assert (msg != NULL);
+    const gchar *name = MCE_SERVICE;
+    dbus_message_append_args (msg, DBUS_TYPE_STRING, &name,
+            DBUS_TYPE_INVALID);
+
+    if (!dbus_connection_send_with_reply (engine->dbus_conn, msg,
+                &(engine->owner_query), -1) || engine->owner_query == NULL) {
+        g_warning ("Can't know if MCE is running, assuming it is");
+        engine->owner_query = NULL;
+    }
+    else
+        dbus_pending_call_set_notify (engine->owner_query,
+                (DBusPendingCallNotifyFunction) on_owner_query_reply,
+                engine, NULL);
+
+    dbus_message_unref (msg);
+}
+
+// The connection must be integrated with the GLib main loop
+static void
+watch_mce (InhibitEngine *engine)
+{
+    dbus_bus_add_match (engine->dbus_conn, MCE_DISPLAY_MATCH, NULL);
+    dbus_bus_add_match (engine->dbus_conn, MCE_TKLOCK_MATCH, NULL);
+    // MCE is assumed to be running until told otherwise
+    dbus_bus_add_match (engine->dbus_conn, MCE_OWNER_MATCH, NULL);
+    dbus_bool_t ok = dbus_connection_add_filter (engine->dbus_conn,
+            (DBusHandleMessageFunction) on_dbus_message, engine, NULL);
+    g_assert (ok == TRUE);
+
+    query_mce_owner (engine);
+    query_mce_state (engine);
+}
+
+static void
+unwatch_mce (InhibitEngine *engine)
+{
+    cancel_query (&(engine->owner_query));
+    cancel_query (&(engine->display_query));
+    cancel_query (&(engine->tklock_query));
+
+    dbus_connection_remove_filter (engine->dbus_conn,
+            (DBusHandleMessageFunction) on_dbus_message, engine);
+    dbus_bus_remove_match (engine->dbus_conn, MCE_DISPLAY_MATCH, NULL);
+    dbus_bus_remove_match (engine->dbus_conn, MCE_TKLOCK_MATCH, NULL);
+    dbus_bus_remove_match (engine->dbus_conn, MCE_OWNER_MATCH, NULL);
+}
+
+InhibitEngine *
+inhibit_engine_new (DBusConnection *dbus_conn, GConfClient *gconf_client,
+        InhibitEngineNotify notify, gpointer notify_data)
+{
+    g_assert (dbus_conn != NULL);
+    g_assert (GCONF_IS_CLIENT (gconf_client));
+
+    InhibitEngine *engine = g_slice_new0 (InhibitEngine);
+
+    engine->dbus_conn = dbus_connection_ref (dbus_conn);
+    engine->gconf_client = g_object_ref (gconf_client);
+    engine->notify = notify;
+    engine->notify_data = notify_data;
+    engine->state = INHIBIT_ENGINE_OFF;
+    // until MCE tells otherwise, we are usually started by a user action
+    engine->display_on_since = monotonic_time ();
+
+    // watching the keys makes the client cache them
+    gconf_client_add_dir (gconf_client, DIM_TIMEOUT_GCONF_KEY,
+            GCONF_CLIENT_PRELOAD_NONE, NULL);
+    gconf_client_add_dir (gconf_client, BLANK_TIMEOUT_GCONF_KEY,
+            GCONF_CLIENT_PRELOAD_NONE, NULL);
+    engine->gconf_notify_ids[0] = gconf_client_notify_add (gconf_client,
+            DIM_TIMEOUT_GCONF_KEY,
+            (GConfClientNotifyFunc) on_timeout_gconf_notify, engine, NULL,
+            NULL);
+    engine->gconf_notify_ids[1] = gconf_client_notify_add (gconf_client,
+            BLANK_TIMEOUT_GCONF_KEY,
+            (GConfClientNotifyFunc) on_timeout_gconf_notify, engine, NULL,
+            NULL);
+    engine->interval = keepalive_interval (engine);
+
+    watch_mce (engine);
+
+    return engine;
+}
+
+void
+inhibit_engine_free (InhibitEngine *engine)
+{
+    if (engine->state != INHIBIT_ENGINE_OFF)
+        stop (engine);
+
+    unwatch_mce (engine);
+
+    for (int i = 0; i < 2; i++)
+        gconf_client_notify_remove (engine->gconf_client,
+                engine->gconf_notify_ids[i]);
+    gconf_client_remove_dir (engine->gconf_client, DIM_TIMEOUT_GCONF_KEY,
+            NULL);
+    gconf_client_remove_dir (engine->gconf_client, BLANK_TIMEOUT_GCONF_KEY,
+            NULL);
+
+    if (engine->keepalive_call != NULL)
+        cancel_keepalive_call (engine);
+    dbus_connection_unref (engine->dbus_conn);
+    g_object_unref (engine->gconf_client);
+
+    g_slice_free (InhibitEngine, engine);
+}
+
+InhibitEngineState
+inhibit_engine_get_state (InhibitEngine *engine)
+{
+    return engine->state;
+}
+
+guint
+inhibit_engine_get_remaining (InhibitEngine *engine)
+{
+    if (engine->deadline == 0)
+        return 0;
+
+    return MAX (engine->deadline - monotonic_time (), 0);
+}
+
+void
+inhibit_engine_inhibit (InhibitEngine *engine, guint timeout)
+{
+    engine->deadline = timeout ? monotonic_time () + timeout : 0;
+
+    if (engine->state == INHIBIT_ENGINE_OFF) {
+        if (!is_paused (engine))
+            inhibit_display_blanking (engine);
+        engine->start = monotonic_time ();
+        engine->wakeups = 0;
+    }
+    // re-arms the timer for the new deadline if already inhibiting
+    reschedule_timer (engine);
+
+    set_state (engine, timeout ? INHIBIT_ENGINE_TIMED : INHIBIT_ENGINE_MANUAL,
+            INHIBIT_ENGINE_REASON_REQUEST);
+}
+
+gboolean
+inhibit_engine_release (InhibitEngine *engine, InhibitEngineReason reason,
+        GError **error)
+{
+    if (engine->state == INHIBIT_ENGINE_OFF) {
+        g_set_error (error, INHIBIT_ENGINE_ERROR,
+                INHIBIT_ENGINE_ERROR_NOT_INHIBITED,
+                "Display blanking is not inhibited");
+        return FALSE;
+    }
+
+    stop (engine);
+    set_state (engine, INHIBIT_ENGINE_OFF, reason);
+
+    return TRUE;
+}
+
+void
+inhibit_engine_suspend (InhibitEngine *engine, gboolean suspended)
+{
+    gboolean was_paused = is_paused (engine);
+    engine->suspended = suspended;
+    update_pause (engine, was_paused);
+
+    // stopping the keepalives is not enough, the last one would keep the
+    // display on for a while
+    if (suspended && !was_paused && engine->state != INHIBIT_ENGINE_OFF)
+        cancel_blanking_pause (engine);
+}
+
+gboolean
+inhibit_engine_set_mode (InhibitEngine *engine, gint mode, GError **error)
+{
+    if (mode < 0 || mode >= BLANKING_MODES) {
+        g_set_error (error, INHIBIT_ENGINE_ERROR,
+                INHIBIT_ENGINE_ERROR_INVALID_MODE,
+                "Invalid display blanking mode %d", mode);
+        return FALSE;
+    }
+
+    GError *gconf_error = NULL;
+    gconf_client_set_int (engine->gconf_client, MODE_GCONF_KEY, mode,
+            &gconf_error);
+    if (gconf_error != NULL) {
+        g_set_error (error, INHIBIT_ENGINE_ERROR, INHIBIT_ENGINE_ERROR_GCONF,
+                "Can't set display blanking mode: %s", gconf_error->message);
+        g_error_free (gconf_error);
+        return FALSE;
+    }
+    engine->mode_changes++;
+
+    return TRUE;
+}
+
+void
+inhibit_engine_get_stats (InhibitEngine *engine, InhibitEngineStats *stats)
+{
+    stats->keepalives_sent = engine->keepalives_sent;
+    stats->wakeups = engine->wakeups_total;
+    stats->wakeups_saved = engine->wakeups_saved;
+    stats->mode_changes = engine->mode_changes;
+    stats->current_inhibited_time = 0;
+    if (engine->state != INHIBIT_ENGINE_OFF)
+        stats->current_inhibited_time = monotonic_time ()
+                - engine->start;
+    stats->inhibited_time = engine->inhibited_time
+            + stats->current_inhibited_time;
+    stats->last_latency = engine->last_latency;
+    stats->max_latency = engine->max_latency;
+    stats->mce_restarts = engine->mce_restarts;
+    stats->keepalive_interval = engine->interval;
+    stats->display_on_time = engine->display_on_time;
+    if (!engine->display_off)
+        stats->display_on_time += monotonic_time ()
+                - engine->display_on_since;
+}
@@ -0,0 +1,129 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Display blanking inhibition engine. It owns the inhibition state and
+// sends the MCE keepalive messages, and it doesn't depend on GTK, so it can
+// be used without a GUI.
+
+#ifndef INHIBIT_ENGINE_H
+#define INHIBIT_ENGINE_H
+
+#include <time.h>
+#include <glib.h>
+#include <gconf/gconf-client.h>
+#include <dbus/dbus.h>
+
+#define MODE_GCONF_ROOT "/system/osso/dsm/display"
+#define MODE_GCONF_KEY  MODE_GCONF_ROOT "/inhibit_blank_mode"
+#define DIM_TIMEOUT_GCONF_KEY   MODE_GCONF_ROOT "/display_dim_timeout"
+#define BLANK_TIMEOUT_GCONF_KEY MODE_GCONF_ROOT "/display_blank_timeout"
+
+// Undocumented blanking modes as reported by David Weinehall from Nokia:
+// http://www.gossamer-threads.com/lists/maemo/developers/61201#61201
+#define BLANKING_MODES 5
+
+#define INHIBIT_ENGINE_ERROR inhibit_engine_error_quark ()
+
+typedef enum
+{
+    INHIBIT_ENGINE_ERROR_NOT_INHIBITED, // release without inhibition
+    INHIBIT_ENGINE_ERROR_INVALID_MODE,
+    INHIBIT_ENGINE_ERROR_GCONF
+} InhibitEngineError;
+
+typedef enum
+{
+    INHIBIT_ENGINE_OFF,
+    INHIBIT_ENGINE_MANUAL, // until explicitly released
+    INHIBIT_ENGINE_TIMED
+} InhibitEngineState;
+
+// Why the state changed
+typedef enum
+{
+    INHIBIT_ENGINE_REASON_REQUEST, // inhibit/release was called
+    INHIBIT_ENGINE_REASON_TIMEOUT, // a timed inhibition reached its deadline
+    INHIBIT_ENGINE_REASON_BATTERY_LOW, // released to save the battery
+    // a timed inhibition sent a keepalive (or resumed them), the state
+    // didn't change, so countdowns can be updated without waking up on
+    // their own
+    INHIBIT_ENGINE_REASON_KEEPALIVE
+} InhibitEngineReason;
+
+typedef struct _InhibitEngine InhibitEngine;
+
+typedef struct
+{
+    guint keepalives_sent;
+    guint wakeups;
+    guint wakeups_saved; // compared to a fixed 30 seconds heartbeat
+    guint mode_changes;
+    guint64 inhibited_time; // in seconds, including the current inhibition
+    guint64 current_inhibited_time; // in seconds, 0 if not inhibited
+    gint64 last_latency; // keepalive round trip, in microseconds
+    gint64 max_latency;
+    guint64 display_on_time; // in seconds, since the engine was created
+    guint mce_restarts; // times MCE came back after going away
+    guint keepalive_interval; // in seconds, from the dim/blank timeouts
+} InhibitEngineStats;
+
+typedef void (*InhibitEngineNotify) (InhibitEngine *engine,
+        InhibitEngineState state, InhibitEngineReason reason, gpointer data);
+
+GQuark inhibit_engine_error_quark (void);
+
+// The engine keeps a reference to both the connection and the client. The
+// connection must be integrated with the GLib main loop, since the engine
+// listens to MCE signals. notify is called after every state change, and
+// after the keepalives of timed inhibitions.
+InhibitEngine *inhibit_engine_new (DBusConnection *dbus_conn,
+        GConfClient *gconf_client, InhibitEngineNotify notify,
+        gpointer notify_data);
+
+void inhibit_engine_free (InhibitEngine *engine);
+
+InhibitEngineState inhibit_engine_get_state (InhibitEngine *engine);
+
+// Seconds left for a timed inhibition, 0 if the inhibition is not timed
+guint inhibit_engine_get_remaining (InhibitEngine *engine);
+
+// Starts an inhibition or changes the current one. timeout is in seconds,
+// if it's 0 the inhibition lasts until inhibit_engine_release () is called.
+void inhibit_engine_inhibit (InhibitEngine *engine, guint timeout);
+
+// reason is what gets reported to the notify callback
+gboolean inhibit_engine_release (InhibitEngine *engine,
+        InhibitEngineReason reason, GError **error);
+
+// Pauses the keepalives (if suspended is TRUE) without changing the state,
+// like while the display is off, so the display can blank. The pending
+// blank pause is cancelled too, so MCE dims and blanks after its regular
+// timeouts (an MCE without the cancel request keeps the display on for up
+// to 60 seconds more first). A timed inhibition still ends at its
+// deadline.
+void inhibit_engine_suspend (InhibitEngine *engine, gboolean suspended);
+
+gboolean inhibit_engine_set_mode (InhibitEngine *engine, gint mode,
+        GError **error);
+
+void inhibit_engine_get_stats (InhibitEngine *engine,
+        InhibitEngineStats *stats);
+
+#endif // INHIBIT_ENGINE_H
@@ -0,0 +1,184 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L // for ftruncate ()
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "journal.h"
+
+#define JOURNAL_SIZE (sizeof (JournalHeader) \
+        + JOURNAL_CAPACITY * sizeof (JournalRecord))
+
+struct _Journal
+{
+    gsize size;
+    JournalHeader *header; // the whole mapping
+    JournalRecord *records;
+};
+
+static void
+set_error_from_errno (GError **error, const gchar *action, const gchar *path)
+{
+    int errsv = errno;
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+            "Can't %s %s: %s", action, path, g_strerror (errsv));
+}
+
+static gboolean
+is_valid (JournalHeader *header, gsize size)
+{
+    return size == JOURNAL_SIZE
+            && memcmp (header->magic, JOURNAL_MAGIC, sizeof (JOURNAL_MAGIC))
+                == 0
+            && header->capacity == JOURNAL_CAPACITY
+            && header->next < JOURNAL_CAPACITY;
+}
+
+gchar *
+journal_default_path (void)
+{
+    return g_build_filename (g_get_home_dir (), ".sadba", "journal", NULL);
+}
+
+Journal *
+journal_open (const gchar *path, gboolean writable, GError **error)
+{
+    if (writable) {
+        gchar *dir = g_path_get_dirname (path);
+        g_mkdir_with_parents (dir, 0700);
+        g_free (dir);
+    }
+
+    int fd = g_open (path, writable ? O_RDWR | O_CREAT : O_RDONLY, 0600);
+    if (fd < 0) {
+        set_error_from_errno (error, "open", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat (fd, &st) != 0) {
+        set_error_from_errno (error, "stat", path);
+        close (fd);
+        return NULL;
+    }
+
+    gsize size = st.st_size;
+    if (writable && size != JOURNAL_SIZE) {
+        // a new journal, or an incompatible one
+        if (ftruncate (fd, 0) != 0 || ftruncate (fd, JOURNAL_SIZE) != 0) {
+            set_error_from_errno (error, "resize", path);
+            close (fd);
+            return NULL;
+        }
+        size = JOURNAL_SIZE;
+    }
+    if (size < sizeof (JournalHeader)) {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                "%s is not a journal", path);
+        close (fd);
+        return NULL;
+    }
+
+    void *map = mmap (NULL, size, writable ? PROT_READ | PROT_WRITE :
+            PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping stays valid without the descriptor
+    close (fd);
+    if (map == MAP_FAILED) {
+        set_error_from_errno (error, "map", path);
+        return NULL;
+    }
+
+    Journal *journal = g_slice_new (Journal);
+    journal->size = size;
+    journal->header = map;
+    journal->records = (JournalRecord *) (journal->header + 1);
+
+    if (!is_valid (journal->header, size)) {
+        if (!writable) {
+            g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                    "%s is not a journal", path);
+            journal_close (journal);
+            return NULL;
+        }
+        memset (map, 0, size);
+        memcpy (journal->header->magic, JOURNAL_MAGIC,
+                sizeof (JOURNAL_MAGIC));
+        journal->header->capacity = JOURNAL_CAPACITY;
+    }
+
+    return journal;
+}
+
+void
+journal_close (Journal *journal)
+{
+    munmap (journal->header, journal->size);
+    g_slice_free (Journal, journal);
+}
+
+JournalRecord *
+journal_append (Journal *journal, JournalRef *ref)
+{
+    JournalHeader *header = journal->header;
+    JournalRecord *record = journal->records + header->next;
+
+    memset (record, 0, sizeof (JournalRecord));
+    record->sequence = header->appended;
+    if (ref != NULL) {
+        ref->slot = header->next;
+        ref->sequence = record->sequence;
+    }
+    header->next = (header->next + 1) % header->capacity;
+    header->appended++;
+
+    return record;
+}
+
+JournalRecord *
+journal_get (Journal *journal, const JournalRef *ref)
+{
+    if (ref->slot >= journal->header->capacity)
+        return NULL;
+
+    JournalRecord *record = journal->records + ref->slot;
+    if (record->sequence != ref->sequence)
+        return NULL;
+
+    return record;
+}
+
+void
+journal_foreach (Journal *journal, JournalFunc func, gpointer data)
+{
+    JournalHeader *header = journal->header;
+    guint32 count = MIN (header->appended, header->capacity);
+    guint32 first = (header->next + header->capacity - count)
+            % header->capacity;
+
+    for (guint32 i = 0; i < count; i++)
+        func (journal->records + (first + i) % header->capacity, data);
+}
@@ -0,0 +1,89 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Inhibition journal, a fixed size ring of session records in a memory
+// mapped file, so appending never blocks on I/O. The records are in the
+// host byte order.
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <glib.h>
+
+#define JOURNAL_MAGIC "SADBAJ1" // including the final '\0'
+#define JOURNAL_CAPACITY 4096 // records, 128 KiB
+
+typedef enum
+{
+    JOURNAL_TRIGGER_MANUAL, // inhibited until released
+    JOURNAL_TRIGGER_TIMED,
+    JOURNAL_TRIGGER_MODE // a blanking mode that never blanks the display
+} JournalTrigger;
+
+typedef struct
+{
+    gint64 start; // wall clock, in seconds since the epoch
+    gint64 end;   // 0 while the session is still going on
+    guint32 display_on; // in seconds
+    guint32 keepalives;
+    guint32 trigger; // JournalTrigger
+    guint32 sequence; // JournalHeader.appended when it was appended
+                      // (wrapping), to tell when it's overwritten
+} JournalRecord;
+
+typedef struct
+{
+    gchar magic[8];
+    guint32 capacity; // in records
+    guint32 next; // slot for the next record
+    guint64 appended; // records appended since the journal was created
+} JournalHeader;
+
+typedef struct _Journal Journal;
+
+// A record in the ring, until JOURNAL_CAPACITY more records are appended
+typedef struct
+{
+    guint32 slot;
+    guint32 sequence;
+} JournalRef;
+
+typedef void (*JournalFunc) (const JournalRecord *record, gpointer data);
+
+// ~/.sadba/journal, to be freed with g_free ()
+gchar *journal_default_path (void);
+
+// A writable journal is created (or reset if it's not a valid one) when
+// needed, errors are in the G_FILE_ERROR domain
+Journal *journal_open (const gchar *path, gboolean writable, GError **error);
+
+void journal_close (Journal *journal);
+
+// Appends a zeroed record and returns it to be filled in place. It can be
+// updated later through ref (which can be NULL).
+JournalRecord *journal_append (Journal *journal, JournalRef *ref);
+
+// The record ref points to, NULL if it was overwritten by newer ones
+JournalRecord *journal_get (Journal *journal, const JournalRef *ref);
+
+// From the oldest record to the newest one
+void journal_foreach (Journal *journal, JournalFunc func, gpointer data);
+
+#endif // JOURNAL_H
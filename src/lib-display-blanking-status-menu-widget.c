@@ -19,16 +19,28 @@
  *
  ***********************************************************************************/
 
+#define _POSIX_C_SOURCE 199309L // for clock_gettime ()
+
+#include <math.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <libintl.h>
 #include <gtk/gtk.h>
 #include <hildon/hildon.h>
 #include <libhildondesktop/libhildondesktop.h>
 #include <gconf/gconf-client.h>
 #include <dbus/dbus.h>
-#include <mce/dbus-names.h>
+#include <dbus/dbus-glib-lowlevel.h>
+
+#include "active-window.h"
+#include "idle-alarm.h"
+#include "inhibit-engine.h"
+#include "monotonic-time.h"
+#include "sadba-dbus.h"
+#include "stats.h"
 
 
 #define TYPE_DISPLAY_BLANKING_STATUS_PLUGIN (display_blanking_status_plugin_get_type ())
@@ -73,23 +85,55 @@ GType display_blanking_status_plugin_get_type (void);
                 TYPE_DISPLAY_BLANKING_STATUS_PLUGIN, \
                 DisplayBlankingStatusPluginPrivate))
 
-#define MODE_GCONF_ROOT "/system/osso/dsm/display"
-#define MODE_GCONF_KEY  MODE_GCONF_ROOT "/inhibit_blank_mode"
-
-#define HOURS_GCONF_KEY   "/apps/Maemo/sadba/timed_inhibit_hours"
-#define MINUTES_GCONF_KEY "/apps/Maemo/sadba/timed_inhibit_minutes"
+#define SADBA_GCONF_ROOT  "/apps/Maemo/sadba"
+#define HOURS_GCONF_KEY   SADBA_GCONF_ROOT "/timed_inhibit_hours"
+#define MINUTES_GCONF_KEY SADBA_GCONF_ROOT "/timed_inhibit_minutes"
+// list of the last used timed inhibition timeouts, in seconds
+#define RECENT_GCONF_KEY  SADBA_GCONF_ROOT "/timed_inhibit_recent"
+// list of WM_CLASS names or classes of the applications that inhibit
+// display blanking while their window is active
+#define AUTO_INHIBIT_GCONF_KEY SADBA_GCONF_ROOT "/auto_inhibit_apps"
+#define BRIGHTNESS_GCONF_KEY MODE_GCONF_ROOT "/display_brightness"
+// minutes without user input after which a manual inhibition is released,
+// 0 disables it
+#define IDLE_RELEASE_GCONF_KEY SADBA_GCONF_ROOT "/idle_release_minutes"
+
+#define BRIGHTNESS_MIN 1
+#define BRIGHTNESS_MAX 5
+// in seconds, the ones offered by the display settings applet
+static const gint dim_timeouts[] = { 10, 30, 60, 120, 300 };
+#define DIM_TIMEOUTS G_N_ELEMENTS (dim_timeouts)
+
+#define RECENT_TIMEOUTS 4
+// offered after the recent ones in the timed inhibit dialog, finer than
+// its 10 minutes steps; the first one is used by the timed inhibit button
+// tap and hold if there is no recent one
+static const guint preset_timeouts[] = { 5 * 60, 15 * 60, 45 * 60 };
+// the one tap timeouts above the dialog pickers, as many as fit in a row
+#define QUICK_TIMEOUTS 4
+// dialog response of the one tap timeouts (the GTK ones are < 0)
+#define QUICK_RESPONSE 1
+
+// slider changes are written at most once per frame while dragging
+#define SLIDER_WRITE_INTERVAL 40 // in milliseconds
 
 #define BANNER_DURATION 5000 // in milliseconds
-#define INHIBIT_MSG_INTERVAL 30 // in seconds
+
+// hidden dialogs are destroyed when not used for this long
+#define DIALOG_CACHE_TIMEOUT 120 // in seconds
+
+// reported to the daemon as the reason of our inhibitions
+#define INHIBIT_REASON      "Status menu"
+#define AUTO_INHIBIT_REASON "Active application"
+
+// session bus name used to export the statistics
+#define STATS_BUS_NAME "ar.com.llucax.Sadba.Applet"
 
 #define GETTEXT_DOM "status-area-displayblanking-applet"
 #define _(str) dgettext (GETTEXT_DOM, (str))
 #define gettext_noop(str) (str)
 #define N_(str) gettext_noop(str)
 
-// Undocumented blanking modes as reported by David Weinehall from Nokia:
-// http://www.gossamer-threads.com/lists/maemo/developers/61201#61201
-#define BLANKING_MODES 5
 static const char *mode_title[BLANKING_MODES] =
 {
     N_ ("Both enabled"),
@@ -118,19 +162,111 @@ static const char *mode_icon_name[BLANKING_MODES] =
 #define TIMED_INHIBIT_ICON_NAME "display-blanking-inhibit-icon.timed"
 #define INHIBIT_STATUS_ICON_NAME "display-blanking-status"
 
+// Icon cache slots, the first BLANKING_MODES slots hold the mode icons
+enum
+{
+    INHIBIT_ICON = BLANKING_MODES,
+    TIMED_INHIBIT_ICON,
+    INHIBIT_STATUS_ICON,
+    ICONS
+};
+
+// Alpha divisor of the elapsed part of the countdown
+#define COUNTDOWN_FADE 3
+
+// User visible latency, from a tap to its effect
+typedef struct
+{
+    GTimer *timer;
+    gboolean running;
+} Latency;
+
+// An inhibition requested to the daemon
+typedef struct
+{
+    const gchar *reason;
+    guint cookie; // 0 if not held
+    gboolean timed;
+    // kept by the daemon when hildon-desktop leaves the bus, reclaimed when
+    // the plugin is loaded again
+    gboolean persistent;
+    // bumped on every request, so replies to superseded requests are undone
+    guint generation;
+} Inhibition;
+
 struct _DisplayBlankingStatusPluginPrivate
 {
     DisplayBlankingStatusPlugin* plugin;
+    gboolean disposed; // no more GUI updates or replies are expected
+    guint init_id; // init_deferred () idle, 0 when done
     GConfClient *gconf_client;
-    DBusConnection* dbus_conn;
-    DBusMessage* dbus_msg;
+    guint gconf_notify_ids[4];
+    // GConf notifications and writes are applied from a single idle
+    // callback, so bursts are coalesced
+    guint gconf_idle_id;
+    gint pending_mode; // < 0 if there is no mode change to apply
+    gint pending_brightness; // < 0 if there is no change to apply
+    gint pending_dim_timeout; // < 0 if there is no change to apply
+    GConfChangeSet *pending_changes;
+    DBusConnection* session_dbus_conn;
+    Stats *stats;
+    gboolean stats_exported; // STATS_BUS_NAME is ours
+    // last state reported by the daemon, the aggregate of all its clients
+    InhibitEngineState state;
+    guint remaining; // seconds left for a timed inhibition
+    time_t deadline; // monotonic, 0 if the inhibition is not timed
+    guint timed_total; // length of the timed inhibition, in seconds
+    Inhibition inhibition; // the one driven by the buttons
+    // held while a whitelisted application is active, it's independent
+    // from the buttons one so neither overrides the other
+    Inhibition auto_inhibition;
+    gboolean auto_inhibiting;
+    GSList *auto_inhibit_apps; // gchar *
+    ActiveWindow *active_window;
+    gchar *active_name; // WM_CLASS of the active window, NULL if unknown
+    gchar *active_class;
+    IdleAlarm *idle_alarm; // NULL if the X server can't provide it
+    guint idle_timeout; // the idle alarm timeout, 0 if disarmed
+    // loaded on first use, flushed when the icon theme changes
+    GdkPixbuf *icons[ICONS];
+    // the status icon of a timed inhibition fades clockwise as the time
+    // goes by; the full and faded versions are composed once and the
+    // countdown is only redrawn from them when the minutes left change
+    GdkPixbuf *countdown_base;
+    GdkPixbuf *countdown_faded;
+    // drawn alternately, so the status area sees a new icon each time
+    GdkPixbuf *countdown[2];
+    guint countdown_current;
+    guint8 *countdown_angles; // per pixel, clockwise from 12 o'clock
+    guint countdown_minutes; // drawn in the current countdown, 0 if none
+    gint mode; // < 0 until GConf is initialized
     GtkWidget *mode_button;
+    GtkWidget *mode_image;
     GtkWidget *mode_dialog;
+    GtkWidget *brightness_scale;
+    GtkWidget *dim_timeout_scale;
+    GtkWidget *dim_timeout_label;
+    gboolean slider_in_signal; // like inhibit_in_signal, for the sliders
+    gboolean slider_dragging; // GConf changes are not shown meanwhile
+    guint slider_write_id; // commits the slider changes, 0 if none queued
     GtkWidget *inhibit_button;
     GtkWidget *timed_inhibit_button;
     GtkWidget *timed_inhibit_dialog;
-    gint inhibit_timer_id;       // if == 0
-    gint timed_inhibit_timer_id; //     no timer is set
+    GtkWidget *hours_picker;
+    GtkWidget *minutes_picker;
+    // in seconds, the most recent first, 0 if unused; kept in memory so
+    // the timed inhibit button tap and hold needs no GConf reads
+    guint recent_timeouts[RECENT_TIMEOUTS];
+    GtkWidget *quick_box; // the one tap timeouts of the dialog
+    gboolean quick_box_stale; // the recent timeouts changed since filled
+    guint quick_timeout; // the one tapped, in seconds
+    guint dialogs_trim_id; // destroys the dialogs if they are not reused
+    // exported with the statistics as <name>_latency_us (the last one),
+    // <name>_latency_total_us and <name>_latency_samples
+    Latency dialog_latency; // tap to dialog mapped
+    Latency inhibit_latency; // tap to inhibition held (the first keepalive
+                             // is sent before the daemon replies)
+    Latency mode_latency; // mode picked to icon updated (through GConf)
     // gtk_toggle_button_set_active () triggers the "clicked" signal on the
     // affected button, since we don't want to process the signal while
     // changing the "pressed" state (we want just the GUI to change, we use
@@ -148,431 +284,1583 @@ display_blanking_status_plugin_class_finalize (
 {
 }
 
+static void display_blanking_status_plugin_dispose (GObject *object);
+static void display_blanking_status_plugin_finalize (GObject *object);
+
 static void
 display_blanking_status_plugin_class_init (DisplayBlankingStatusPluginClass *c)
 {
+    GObjectClass *object_class = G_OBJECT_CLASS (c);
+
+    object_class->dispose = display_blanking_status_plugin_dispose;
+    object_class->finalize = display_blanking_status_plugin_finalize;
+
     g_type_class_add_private (c, sizeof (DisplayBlankingStatusPluginPrivate));
 }
 
 static void
-update_mode_gui (gint mode, DisplayBlankingStatusPluginPrivate *priv)
+latency_start (Latency *latency)
 {
-    GtkWidget *icon = gtk_image_new_from_icon_name (mode_icon_name[mode],
-            GTK_ICON_SIZE_DIALOG);
-    gtk_button_set_image (GTK_BUTTON (priv->mode_button), icon);
+    g_timer_start (latency->timer);
+    latency->running = TRUE;
 }
 
 static void
-disable_timer (gint *timer_id)
+latency_stop (DisplayBlankingStatusPluginPrivate *priv, Latency *latency,
+        const gchar *name)
 {
-    g_assert (*timer_id != 0);
-    gboolean ok = g_source_remove (*timer_id);
-    g_assert (ok == TRUE);
-    *timer_id = 0;
+    if (!latency->running)
+        return;
+    latency->running = FALSE;
+
+    guint64 elapsed = g_timer_elapsed (latency->timer, NULL) * G_USEC_PER_SEC;
+    gchar *counter = g_strdup_printf ("%s_latency_us", name);
+    stats_set (priv->stats, counter, elapsed);
+    g_free (counter);
+    counter = g_strdup_printf ("%s_latency_total_us", name);
+    stats_add (priv->stats, counter, elapsed);
+    g_free (counter);
+    counter = g_strdup_printf ("%s_latency_samples", name);
+    stats_add (priv->stats, counter, 1);
+    g_free (counter);
 }
 
-static void
-disable_inhibition (DisplayBlankingStatusPluginPrivate *priv)
+static GdkPixbuf *
+get_icon (DisplayBlankingStatusPluginPrivate *priv, guint icon)
 {
-    disable_timer (&(priv->inhibit_timer_id));
-    hd_status_plugin_item_set_status_area_icon (
-            HD_STATUS_PLUGIN_ITEM (priv->plugin), NULL);
-}
+    g_assert (icon < ICONS);
+
+    if (priv->icons[icon] != NULL)
+        return priv->icons[icon];
+
+    const gchar *name = NULL;
+    gint size = 0;
+    gtk_icon_size_lookup (GTK_ICON_SIZE_DIALOG, &size, NULL);
+    switch (icon) {
+    case INHIBIT_ICON:
+        name = INHIBIT_ICON_NAME;
+        break;
+    case TIMED_INHIBIT_ICON:
+        name = TIMED_INHIBIT_ICON_NAME;
+        break;
+    case INHIBIT_STATUS_ICON:
+        name = INHIBIT_STATUS_ICON_NAME;
+        size = STATUS_AREA_DISPLAY_BLANKING_ICON_SIZE;
+        break;
+    default:
+        name = mode_icon_name[icon];
+    }
 
-static void
-inhibit_display_blanking (DisplayBlankingStatusPluginPrivate *priv)
-{
-    dbus_bool_t ok = dbus_connection_send (priv->dbus_conn, priv->dbus_msg,
-            NULL);
-    g_assert (ok == TRUE);
+    GTimer *timer = g_timer_new ();
+    priv->icons[icon] = gtk_icon_theme_load_icon (gtk_icon_theme_get_default (),
+            name, size, GTK_ICON_LOOKUP_NO_SVG, NULL);
+    stats_add (priv->stats, "icon_loads", 1);
+    stats_add (priv->stats, "icon_load_time_us",
+            g_timer_elapsed (timer, NULL) * G_USEC_PER_SEC);
+    g_timer_destroy (timer);
+
+    return priv->icons[icon];
 }
 
 static gboolean
-on_inhibit_timeout (DisplayBlankingStatusPluginPrivate *priv)
+countdown_compose (DisplayBlankingStatusPluginPrivate *priv)
 {
-    inhibit_display_blanking (priv);
+    if (priv->countdown_base != NULL)
+        return TRUE;
+
+    GdkPixbuf *icon = get_icon (priv, INHIBIT_STATUS_ICON);
+    if (icon == NULL)
+        return FALSE;
+
+    priv->countdown_base = gdk_pixbuf_add_alpha (icon, FALSE, 0, 0, 0);
+    priv->countdown_faded = gdk_pixbuf_copy (priv->countdown_base);
+    priv->countdown[0] = gdk_pixbuf_copy (priv->countdown_base);
+    priv->countdown[1] = gdk_pixbuf_copy (priv->countdown_base);
+
+    gint width = gdk_pixbuf_get_width (priv->countdown_base);
+    gint height = gdk_pixbuf_get_height (priv->countdown_base);
+    gint stride = gdk_pixbuf_get_rowstride (priv->countdown_faded);
+    guchar *faded = gdk_pixbuf_get_pixels (priv->countdown_faded);
+    priv->countdown_angles = g_new (guint8, width * height);
+    for (gint y = 0; y < height; y++) {
+        for (gint x = 0; x < width; x++) {
+            faded[y * stride + x * 4 + 3] /= COUNTDOWN_FADE;
+            gdouble a = atan2 (x - width / 2.0 + 0.5,
+                    height / 2.0 - 0.5 - y);
+            if (a < 0)
+                a += 2 * G_PI;
+            priv->countdown_angles[y * width + x] =
+                    MIN (a / (2 * G_PI) * 256, 255);
+        }
+    }
 
     return TRUE;
 }
 
-static gboolean
-on_timed_inhibit_timeout (DisplayBlankingStatusPluginPrivate *priv)
+static void
+countdown_clear (DisplayBlankingStatusPluginPrivate *priv)
 {
-    disable_inhibition (priv);
-    disable_timer (&(priv->timed_inhibit_timer_id));
+    if (priv->countdown_base == NULL)
+        return;
 
-    priv->inhibit_in_signal = TRUE;
-    gtk_toggle_button_set_active (
-            GTK_TOGGLE_BUTTON (priv->timed_inhibit_button), FALSE);
-    priv->inhibit_in_signal = FALSE;
+    g_object_unref (priv->countdown_base);
+    g_object_unref (priv->countdown_faded);
+    g_object_unref (priv->countdown[0]);
+    g_object_unref (priv->countdown[1]);
+    g_free (priv->countdown_angles);
+    priv->countdown_base = priv->countdown_faded = NULL;
+    priv->countdown[0] = priv->countdown[1] = NULL;
+    priv->countdown_angles = NULL;
+    priv->countdown_minutes = 0;
+}
 
-    GtkWidget *banner = hildon_banner_show_information (
-            priv->timed_inhibit_button, NULL,
-            _ ("Display blanking inhibition disabled"));
-    hildon_banner_set_timeout (HILDON_BANNER (banner), BANNER_DURATION);
+static GdkPixbuf *
+countdown_draw (DisplayBlankingStatusPluginPrivate *priv, guint minutes)
+{
+    if (minutes == priv->countdown_minutes)
+        return priv->countdown[priv->countdown_current];
+    priv->countdown_minutes = minutes;
+    priv->countdown_current = !priv->countdown_current;
+
+    GdkPixbuf *countdown = priv->countdown[priv->countdown_current];
+    guint total = MAX (priv->timed_total, minutes * 60);
+    guint elapsed = 256 - minutes * 60 * 256 / total;
+    gint width = gdk_pixbuf_get_width (countdown);
+    gint height = gdk_pixbuf_get_height (countdown);
+    gint stride = gdk_pixbuf_get_rowstride (countdown);
+    const guchar *base = gdk_pixbuf_get_pixels (priv->countdown_base);
+    const guchar *faded = gdk_pixbuf_get_pixels (priv->countdown_faded);
+    guchar *pixels = gdk_pixbuf_get_pixels (countdown);
+    for (gint y = 0; y < height; y++) {
+        for (gint x = 0; x < width; x++) {
+            gint i = y * stride + x * 4;
+            const guchar *src =
+                    priv->countdown_angles[y * width + x] < elapsed ?
+                    faded : base;
+            memcpy (pixels + i, src + i, 4);
+        }
+    }
+    stats_add (priv->stats, "countdown_redraws", 1);
 
-    return FALSE;
+    return countdown;
 }
 
-static void
-enable_inhibition (DisplayBlankingStatusPluginPrivate *priv)
+static GdkPixbuf *
+get_countdown_icon (DisplayBlankingStatusPluginPrivate *priv)
 {
-    inhibit_display_blanking (priv);
+    if (!countdown_compose (priv))
+        return NULL;
+
+    time_t now = monotonic_time ();
+    guint remaining = priv->deadline > now ? priv->deadline - now : 0;
+    guint minutes = (remaining + 59) / 60; // the started ones count
+
+    // redrawn when the daemon reports a keepalive that started a new
+    // minute, so the plugin wakes up with the daemon instead of on its own
+    // timer. It can lag up to a keepalive interval (30 seconds or more,
+    // from the dim and blank timeouts) behind, and the end of the last
+    // minute is a state change.
+    return countdown_draw (priv, MAX (minutes, 1));
+}
 
-    g_assert (priv->inhibit_timer_id == 0);
-    priv->inhibit_timer_id = g_timeout_add_seconds (INHIBIT_MSG_INTERVAL,
-            (GSourceFunc) on_inhibit_timeout, priv);
-    g_assert (priv->inhibit_timer_id > 0);
+static void
+update_status_icon (DisplayBlankingStatusPluginPrivate *priv)
+{
+    GdkPixbuf *icon = NULL;
+    if (priv->state == INHIBIT_ENGINE_MANUAL)
+        icon = get_icon (priv, INHIBIT_STATUS_ICON);
+    else if (priv->state == INHIBIT_ENGINE_TIMED)
+        icon = get_countdown_icon (priv);
 
-    GtkIconTheme *icon_theme = gtk_icon_theme_get_default ();
-    GdkPixbuf *pixbuf = gtk_icon_theme_load_icon (icon_theme,
-            INHIBIT_STATUS_ICON_NAME, 18, GTK_ICON_LOOKUP_NO_SVG, NULL);
     hd_status_plugin_item_set_status_area_icon (
-            HD_STATUS_PLUGIN_ITEM (priv->plugin), pixbuf);
+            HD_STATUS_PLUGIN_ITEM (priv->plugin), icon);
 }
 
+// Takes a state reported by the daemon
 static void
-on_inhibit_button_clicked (GtkWidget *button,
-        DisplayBlankingStatusPluginPrivate *priv)
+set_daemon_state (DisplayBlankingStatusPluginPrivate *priv,
+        InhibitEngineState state, guint remaining)
 {
-    if (priv->inhibit_in_signal)
-        return;
-
-    GtkWidget *parent = gtk_widget_get_ancestor (button, GTK_TYPE_WINDOW);
-    gtk_widget_hide (parent);
-
-    gboolean self_pressed = gtk_toggle_button_get_active (
-            GTK_TOGGLE_BUTTON (button));
-    gboolean other_pressed = gtk_toggle_button_get_active (
-            GTK_TOGGLE_BUTTON (priv->timed_inhibit_button));
-
-    if (self_pressed && other_pressed) {
-        g_assert (priv->inhibit_timer_id != 0);
+    priv->state = state;
+    priv->remaining = remaining;
 
-        disable_timer (&(priv->timed_inhibit_timer_id));
-
-        priv->inhibit_in_signal = TRUE;
-        gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (
-                priv->timed_inhibit_button), FALSE);
-        priv->inhibit_in_signal = FALSE;
-    }
-    else if (self_pressed && !other_pressed) {
-        g_assert (priv->timed_inhibit_timer_id == 0);
-
-        enable_inhibition (priv);
+    if (state != INHIBIT_ENGINE_TIMED) {
+        priv->deadline = 0;
+        return;
     }
-    else if (!self_pressed) {
-        g_assert (!other_pressed);
-        g_assert (priv->timed_inhibit_timer_id == 0);
 
-        disable_inhibition (priv);
+    // the same deadline is reported again when other clients change the
+    // state, a new one means a new timed inhibition
+    time_t deadline = monotonic_time () + remaining;
+    if (priv->deadline == 0 || ABS (deadline - priv->deadline) > 1) {
+        priv->timed_total = remaining;
+        priv->deadline = deadline;
+        priv->countdown_minutes = 0; // redraw
     }
-    else
-        g_assert (FALSE);
 }
 
-static GtkWidget *
-timed_inhibit_picker_new (const gchar* title, gsize current, guint max,
-        guint step)
+static void
+update_mode_gui (gint mode, DisplayBlankingStatusPluginPrivate *priv)
 {
-    g_assert (max < 100);
-    static gchar buffer[3]; // 2 for the number + 1 for \0
-
-    GtkWidget *selector = hildon_touch_selector_entry_new_text ();
-    gint selected = -1;
-    for (int i = 0; i*step <= max; i++) {
-        if (i*step == current)
-            selected = i;
-        hildon_touch_selector_append_text (HILDON_TOUCH_SELECTOR (selector),
-                g_ascii_formatd (buffer, 3, "%.0f", i*step));
+    if (mode < 0 || mode >= BLANKING_MODES) {
+        g_warning ("Unknown display blanking mode %d", mode);
+        return;
     }
-    hildon_gtk_entry_set_input_mode (GTK_ENTRY (
-                hildon_touch_selector_entry_get_entry (
-                    HILDON_TOUCH_SELECTOR_ENTRY (selector))),
-            HILDON_GTK_INPUT_MODE_NUMERIC);
-
-    GtkWidget *picker = hildon_picker_button_new (HILDON_SIZE_FINGER_HEIGHT,
-            HILDON_BUTTON_ARRANGEMENT_VERTICAL);
-    hildon_button_set_title (HILDON_BUTTON (picker), title);
-    hildon_picker_button_set_selector (HILDON_PICKER_BUTTON (picker),
-            HILDON_TOUCH_SELECTOR (selector));
-    hildon_picker_button_set_active (HILDON_PICKER_BUTTON (picker),
-            selected);
-    hildon_button_set_value (HILDON_BUTTON (picker),
-                g_ascii_formatd (buffer, 3, "%.0f", current));
 
-    g_object_set_data (G_OBJECT (picker), "max", GUINT_TO_POINTER (max));
+    priv->mode = mode;
+    gtk_image_set_from_pixbuf (GTK_IMAGE (priv->mode_image),
+            get_icon (priv, mode));
+    latency_stop (priv, &priv->mode_latency, "mode_change");
+}
 
-    return picker;
+static void
+update_brightness_gui (DisplayBlankingStatusPluginPrivate *priv,
+        gint brightness)
+{
+    priv->slider_in_signal = TRUE;
+    gtk_range_set_value (GTK_RANGE (priv->brightness_scale),
+            CLAMP (brightness, BRIGHTNESS_MIN, BRIGHTNESS_MAX));
+    priv->slider_in_signal = FALSE;
 }
 
-static guint
-timed_inhibit_picker_get_value (GtkWidget *picker)
+static void
+update_dim_timeout_label (DisplayBlankingStatusPluginPrivate *priv,
+        gint timeout)
 {
-    guint max = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (picker), "max"));
+    gchar *text = g_strdup_printf (_ ("Dim after %d s"), timeout);
+    gtk_label_set_text (GTK_LABEL (priv->dim_timeout_label), text);
+    g_free (text);
+}
 
-    return CLAMP (g_ascii_strtod (hildon_button_get_value (
-                    HILDON_BUTTON (picker)), NULL), 0, max);
+static void
+update_dim_timeout_gui (DisplayBlankingStatusPluginPrivate *priv,
+        gint timeout)
+{
+    // other tools might use values the slider doesn't have
+    guint i = 0;
+    while (i < DIM_TIMEOUTS - 1 && dim_timeouts[i] < timeout)
+        i++;
+
+    priv->slider_in_signal = TRUE;
+    gtk_range_set_value (GTK_RANGE (priv->dim_timeout_scale), i);
+    priv->slider_in_signal = FALSE;
+    update_dim_timeout_label (priv, timeout);
 }
 
-static guint
-timed_inhibit_get_input (DisplayBlankingStatusPluginPrivate *priv)
+static void
+commit_pending_changes (DisplayBlankingStatusPluginPrivate *priv)
 {
-    g_assert (priv->timed_inhibit_dialog == NULL);
-    priv->timed_inhibit_dialog = gtk_dialog_new_with_buttons (
-            _ ("Inhibit display blanking for..."), NULL, GTK_DIALOG_MODAL,
-            GTK_STOCK_OK, GTK_RESPONSE_ACCEPT,
-            GTK_STOCK_CANCEL, GTK_RESPONSE_REJECT, NULL);
+    if (gconf_change_set_size (priv->pending_changes) == 0)
+        return;
 
-    GtkWidget *h_picker = timed_inhibit_picker_new (_ ("Hours"),
-            gconf_client_get_int (priv->gconf_client, HOURS_GCONF_KEY, NULL),
-            24, 1);
-    GtkWidget *m_picker = timed_inhibit_picker_new (_ ("Minutes"),
-            gconf_client_get_int (priv->gconf_client, MINUTES_GCONF_KEY, NULL),
-            60, 10);
+    GError *error = NULL;
+    if (!gconf_client_commit_change_set (priv->gconf_client,
+                priv->pending_changes, TRUE, &error)) {
+        g_warning ("Can't save settings: %s", error->message);
+        g_error_free (error);
+        gconf_change_set_clear (priv->pending_changes);
+    }
+    // each one is a round trip to gconfd
+    stats_add (priv->stats, "gconf_commits", 1);
+}
 
-    GtkWidget *hbox = gtk_hbox_new (FALSE, 0);
-    g_assert (hbox != NULL);
+static gboolean
+on_gconf_idle (DisplayBlankingStatusPluginPrivate *priv)
+{
+    priv->gconf_idle_id = 0;
 
-    gtk_container_add (GTK_CONTAINER (hbox), h_picker);
-    gtk_container_add (GTK_CONTAINER (hbox), m_picker);
+    if (priv->pending_mode >= 0) {
+        update_mode_gui (priv->pending_mode, priv);
+        priv->pending_mode = -1;
+    }
 
-    GtkWidget *content_area = gtk_dialog_get_content_area (
-            GTK_DIALOG (priv->timed_inhibit_dialog));
-    gtk_container_add (GTK_CONTAINER (content_area), hbox);
+    // the slider position wins while it's being dragged, the final write
+    // on release brings GConf up to date
+    if (!priv->slider_dragging) {
+        if (priv->pending_brightness >= 0)
+            update_brightness_gui (priv, priv->pending_brightness);
+        if (priv->pending_dim_timeout >= 0)
+            update_dim_timeout_gui (priv, priv->pending_dim_timeout);
+    }
+    priv->pending_brightness = priv->pending_dim_timeout = -1;
 
-    gtk_widget_show_all (priv->timed_inhibit_dialog);
+    commit_pending_changes (priv);
 
-    gint result = gtk_dialog_run (GTK_DIALOG (priv->timed_inhibit_dialog));
+    return FALSE;
+}
 
-    guint timeout = 0;
-    if (result == GTK_RESPONSE_ACCEPT) {
-        gint hours = timed_inhibit_picker_get_value (h_picker);
-        gint mins = timed_inhibit_picker_get_value (m_picker);
+static void
+queue_gconf_idle (DisplayBlankingStatusPluginPrivate *priv)
+{
+    if (priv->gconf_idle_id == 0)
+        priv->gconf_idle_id = g_idle_add ((GSourceFunc) on_gconf_idle, priv);
+}
 
-        GError *e = NULL;
-        gconf_client_set_int (priv->gconf_client, HOURS_GCONF_KEY, hours, &e);
-        g_assert (e == NULL);
-        gconf_client_set_int (priv->gconf_client, MINUTES_GCONF_KEY, mins, &e);
-        g_assert (e == NULL);
+// Arms the idle alarm while the buttons hold a manual inhibition
+static void
+update_idle_release (DisplayBlankingStatusPluginPrivate *priv)
+{
+    if (priv->idle_alarm == NULL)
+        return;
 
-        timeout = hours*3600 + mins*60;
+    guint timeout = 0;
+    if (priv->inhibition.cookie != 0 && !priv->inhibition.timed)
+        // served from the client cache
+        timeout = MAX (gconf_client_get_int (priv->gconf_client,
+                    IDLE_RELEASE_GCONF_KEY, NULL), 0) * 60;
+
+    if (timeout != priv->idle_timeout) {
+        idle_alarm_set (priv->idle_alarm, timeout);
+        priv->idle_timeout = timeout;
     }
-
-    gtk_widget_destroy (priv->timed_inhibit_dialog);
-    priv->timed_inhibit_dialog = NULL;
-
-    return timeout;
 }
 
 static void
-on_timed_inhibit_button_clicked (GtkWidget *button,
-        DisplayBlankingStatusPluginPrivate *priv)
+update_inhibit_gui (DisplayBlankingStatusPluginPrivate *priv)
 {
-    if (priv->inhibit_in_signal)
-        return;
-
-    GtkWidget *parent = gtk_widget_get_ancestor (GTK_WIDGET (priv->mode_button),
-            GTK_TYPE_WINDOW);
-    gtk_widget_hide (parent);
+    InhibitEngineState state = priv->state;
 
-    gboolean self_pressed = gtk_toggle_button_get_active (
-            GTK_TOGGLE_BUTTON (button));
-    gboolean other_pressed = gtk_toggle_button_get_active (
-            GTK_TOGGLE_BUTTON (priv->inhibit_button));
+    // a late daemon reply, the buttons are gone
+    if (priv->disposed)
+        return;
 
-    if (self_pressed) {
-        g_assert (priv->timed_inhibit_timer_id == 0);
-        if (other_pressed)
-            g_assert (priv->inhibit_timer_id != 0);
+    priv->inhibit_in_signal = TRUE;
+    gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (priv->inhibit_button),
+            state == INHIBIT_ENGINE_MANUAL);
+    gtk_toggle_button_set_active (
+            GTK_TOGGLE_BUTTON (priv->timed_inhibit_button),
+            state == INHIBIT_ENGINE_TIMED);
+    priv->inhibit_in_signal = FALSE;
 
-        guint timeout = timed_inhibit_get_input (priv);
-        if (timeout) {
-            if (other_pressed) {
-                priv->inhibit_in_signal = TRUE;
-                gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (
-                            priv->inhibit_button), FALSE);
-                priv->inhibit_in_signal = FALSE;
-            }
-            else
-                enable_inhibition (priv);
-
-            priv->timed_inhibit_timer_id = g_timeout_add_seconds (timeout,
-                    (GSourceFunc) on_timed_inhibit_timeout, priv);
-            g_assert (priv->timed_inhibit_timer_id > 0);
-        }
-        else {
-            priv->inhibit_in_signal = TRUE;
-            gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (
-                        priv->timed_inhibit_button), FALSE);
-            priv->inhibit_in_signal = FALSE;
-        }
-    }
-    else { // !self_pressed
-        g_assert (!other_pressed);
+    update_status_icon (priv);
+    update_idle_release (priv);
+}
 
-        disable_inhibition (priv);
-        disable_timer (&(priv->timed_inhibit_timer_id));
-    }
+static void
+unref_plugin (DisplayBlankingStatusPluginPrivate *priv)
+{
+    g_object_unref (priv->plugin);
 }
 
+// Sends a method call to the daemon without blocking, the daemon is
+// started by D-Bus activation if it's not running. The plugin is kept
+// alive until the reply arrives, once disposed the replies are not waited.
+// free_data must release the plugin reference, if it's NULL data has to be
+// priv.
 static void
-on_mode_dialog_button_clicked (GtkWidget *button, GtkDialog *dialog)
+send_to_daemon (DisplayBlankingStatusPluginPrivate *priv, DBusMessage *msg,
+        DBusPendingCallNotifyFunction notify, gpointer data,
+        DBusFreeFunction free_data)
 {
-    const gchar *title = hildon_button_get_title (HILDON_BUTTON (button));
+    g_object_ref (priv->plugin);
+    if (free_data == NULL) {
+        g_assert (data == priv);
+        free_data = (DBusFreeFunction) unref_plugin;
+    }
 
-    gint *mode = (gint *) g_object_get_data (G_OBJECT (dialog), "mode");
-    g_assert (mode != NULL);
+    if (priv->disposed) {
+        dbus_message_set_no_reply (msg, TRUE);
+        if (!dbus_connection_send (priv->session_dbus_conn, msg, NULL))
+            g_warning ("Can't call %s on the inhibition daemon",
+                    dbus_message_get_member (msg));
+        free_data (data);
+        return;
+    }
 
-    for (*mode = 0; *mode < BLANKING_MODES; (*mode)++) {
-        if (strcmp (title, mode_title[*mode]) == 0)
-            break;
+    DBusPendingCall *call = NULL;
+    if (!dbus_connection_send_with_reply (priv->session_dbus_conn, msg,
+                &call, -1) || call == NULL) {
+        g_warning ("Can't call %s on the inhibition daemon",
+                dbus_message_get_member (msg));
+        free_data (data);
+        return;
     }
-    g_assert (*mode < BLANKING_MODES);
 
-    gtk_dialog_response (dialog, GTK_RESPONSE_OK);
+    dbus_pending_call_set_notify (call, notify, data, free_data);
+    dbus_connection_flush (priv->session_dbus_conn);
 }
 
-static gint
-mode_get_input (DisplayBlankingStatusPluginPrivate *priv)
+static void
+on_get_state_reply (DBusPendingCall *call,
+        DisplayBlankingStatusPluginPrivate *priv)
 {
-    g_assert (priv->mode_dialog == NULL);
-    priv->mode_dialog = gtk_dialog_new ();
-    gtk_window_set_modal (GTK_WINDOW (priv->mode_dialog), TRUE);
-    gtk_window_set_title (GTK_WINDOW (priv->mode_dialog),
-            _ ("Select display blanking mode"));
-
-    GtkWidget *pan_area = hildon_pannable_area_new ();
-    g_assert (pan_area != NULL);
-
-    GtkWidget *vbox = gtk_vbox_new (FALSE, 0);
-    g_assert (vbox != NULL);
-
-    hildon_pannable_area_add_with_viewport (HILDON_PANNABLE_AREA (pan_area),
-            vbox);
-    GtkWidget *content_area = gtk_dialog_get_content_area (
-            GTK_DIALOG (priv->mode_dialog));
-    gtk_box_pack_start (GTK_BOX (content_area), pan_area, TRUE, TRUE, 0);
-
-    gtk_widget_set_size_request (pan_area, -1, MIN (350, BLANKING_MODES * 70));
+    DBusMessage *reply = dbus_pending_call_steal_reply (call);
+    dbus_pending_call_unref (call);
 
-    gint mode = BLANKING_MODES;
-    for (int i = 0; i < BLANKING_MODES; i++) {
-        GtkWidget *button =
-                hildon_button_new_with_text (HILDON_SIZE_FINGER_HEIGHT,
-                    HILDON_BUTTON_ARRANGEMENT_VERTICAL, _ (mode_title[i]),
-                    _ (mode_desc[i]));
-        hildon_button_set_style (HILDON_BUTTON (button),
-            HILDON_BUTTON_STYLE_PICKER);
-        GtkWidget *icon = gtk_image_new_from_icon_name (mode_icon_name[i],
-                GTK_ICON_SIZE_DIALOG);
-        hildon_button_set_image (HILDON_BUTTON (button), icon);
-        gtk_button_set_alignment (GTK_BUTTON (button), 0.0f, 0.5f);
-        gtk_box_pack_start (GTK_BOX (vbox), button, FALSE, FALSE, 0);
-        g_signal_connect (button, "clicked",
-                G_CALLBACK (on_mode_dialog_button_clicked), priv->mode_dialog);
+    DBusError error;
+    dbus_error_init (&error);
+    dbus_uint32_t state, remaining;
+    if (dbus_set_error_from_message (&error, reply)
+            || !dbus_message_get_args (reply, &error,
+                DBUS_TYPE_UINT32, &state, DBUS_TYPE_UINT32, &remaining,
+                DBUS_TYPE_INVALID)) {
+        g_warning ("Can't get the inhibition state: %s", error.message);
+        dbus_error_free (&error);
+    }
+    else {
+        set_daemon_state (priv, state, remaining);
     }
+    dbus_message_unref (reply);
 
-    g_object_set_data (G_OBJECT (priv->mode_dialog), "mode", &mode);
-    gtk_widget_show_all (priv->mode_dialog);
-    gtk_dialog_run (GTK_DIALOG (priv->mode_dialog));
+    update_inhibit_gui (priv);
+}
 
-    gtk_widget_destroy (priv->mode_dialog);
-    priv->mode_dialog = NULL;
+static void
+sync_state (DisplayBlankingStatusPluginPrivate *priv)
+{
+    DBusMessage *msg = dbus_message_new_method_call (SADBA_SERVICE,
+            SADBA_PATH, SADBA_INTERFACE, SADBA_GET_STATE);
+    g_assert (msg != NULL);
 
-    return mode;
+    send_to_daemon (priv, msg,
+            (DBusPendingCallNotifyFunction) on_get_state_reply, priv, NULL);
+    dbus_message_unref (msg);
 }
 
 static void
-on_mode_button_clicked (GtkWidget *button,
+on_daemon_reply (DBusPendingCall *call,
         DisplayBlankingStatusPluginPrivate *priv)
 {
-    GtkWidget *parent = gtk_widget_get_ancestor (GTK_WIDGET (priv->mode_button),
-            GTK_TYPE_WINDOW);
-    gtk_widget_hide (parent);
-
-    gint mode = mode_get_input (priv);
+    DBusMessage *reply = dbus_pending_call_steal_reply (call);
+    dbus_pending_call_unref (call);
 
-    if (mode != BLANKING_MODES) {
-        // will trigger the gconf notify signal
-        GError *error = NULL;
-        gconf_client_set_int (priv->gconf_client, MODE_GCONF_KEY, mode, &error);
-        g_assert (error == NULL);
+    DBusError error;
+    dbus_error_init (&error);
+    if (dbus_set_error_from_message (&error, reply)) {
+        g_warning ("%s", error.message);
+        dbus_error_free (&error);
+        // the GUI might be out of sync
+        sync_state (priv);
     }
+    else // the aggregate might not have changed, undo the button toggle
+        update_inhibit_gui (priv);
+    dbus_message_unref (reply);
 }
 
+// The arguments are like in dbus_message_append_args (), the state changes
+// are reported later by the StateChanged signal
 static void
-on_gconf_notify (GConfClient* client, guint cnxn_id, GConfEntry* entry,
-        DisplayBlankingStatusPluginPrivate* priv)
+call_daemon (DisplayBlankingStatusPluginPrivate *priv, const gchar *method,
+        int first_arg_type, ...)
 {
-    const gchar* key = gconf_entry_get_key (entry);
-    g_assert (key != NULL);
-
-    // Ignore notification about keys we don't care about
-    if (strcmp (key, MODE_GCONF_KEY) != 0)
-        return;
-
-    const GConfValue* value = gconf_entry_get_value (entry);
-    g_assert (value != NULL);
-    g_assert (GCONF_VALUE_TYPE_VALID (value->type));
-    g_assert (value->type == GCONF_VALUE_INT);
-
-    gint mode = gconf_value_get_int (value);
-    update_mode_gui (mode, priv);
+    DBusMessage *msg = dbus_message_new_method_call (SADBA_SERVICE,
+            SADBA_PATH, SADBA_INTERFACE, method);
+    g_assert (msg != NULL);
+
+    va_list args;
+    va_start (args, first_arg_type);
+    dbus_message_append_args_valist (msg, first_arg_type, args);
+    va_end (args);
+
+    send_to_daemon (priv, msg,
+            (DBusPendingCallNotifyFunction) on_daemon_reply, priv, NULL);
+    dbus_message_unref (msg);
 }
 
 static void
-init_gconf (DisplayBlankingStatusPluginPrivate *priv)
+release_cookie (DisplayBlankingStatusPluginPrivate *priv, guint cookie)
 {
-    GError* error = NULL;
-
-    priv->gconf_client = gconf_client_get_default ();
-    g_assert (GCONF_IS_CLIENT (priv->gconf_client));
+    dbus_uint32_t c = cookie;
+    call_daemon (priv, SADBA_RELEASE, DBUS_TYPE_UINT32, &c,
+            DBUS_TYPE_INVALID);
+}
 
-    gconf_client_add_dir (priv->gconf_client, MODE_GCONF_ROOT,
-            GCONF_CLIENT_PRELOAD_NONE, &error);
-    g_assert (error == NULL);
+typedef struct
+{
+    DisplayBlankingStatusPluginPrivate *priv;
+    Inhibition *inhibition;
+    guint generation;
+    gboolean timed;
+} InhibitCall;
 
-    gconf_client_notify_add (priv->gconf_client, MODE_GCONF_KEY,
-            (GConfClientNotifyFunc) &on_gconf_notify, priv, NULL, &error);
-    g_assert (error == NULL);
+static void
+inhibit_call_free (InhibitCall *c)
+{
+    unref_plugin (c->priv);
+    g_slice_free (InhibitCall, c);
 }
 
+static void on_battery_low (DisplayBlankingStatusPluginPrivate *priv);
+
 static void
-init_dbus (DisplayBlankingStatusPluginPrivate *priv)
+on_inhibit_reply (DBusPendingCall *call, InhibitCall *c)
 {
+    DBusMessage *reply = dbus_pending_call_steal_reply (call);
+    dbus_pending_call_unref (call);
+
     DBusError error;
     dbus_error_init (&error);
+    dbus_uint32_t cookie;
+    if (dbus_set_error_from_message (&error, reply)
+            || !dbus_message_get_args (reply, &error,
+                DBUS_TYPE_UINT32, &cookie, DBUS_TYPE_INVALID)) {
+        gboolean battery_low = dbus_error_has_name (&error,
+                SADBA_ERROR_BATTERY_LOW);
+        if (!battery_low)
+            g_warning ("Can't inhibit display blanking: %s", error.message);
+        dbus_error_free (&error);
+        dbus_message_unref (reply);
+        if (c->priv->disposed)
+            return;
+        // the automatic inhibition is refused quietly, it's not the user
+        // asking for it
+        if (battery_low && c->inhibition == &c->priv->inhibition)
+            on_battery_low (c->priv);
+        sync_state (c->priv);
+        return;
+    }
+    dbus_message_unref (reply);
 
-    priv->dbus_conn = dbus_bus_get (DBUS_BUS_SYSTEM, &error);
-    g_assert (!dbus_error_is_set (&error));
-    g_assert (priv->dbus_conn != NULL);
+    // nobody is left to release it once the plugin is gone
+    Inhibition *inhibition = c->inhibition;
+    if (c->priv->disposed || c->generation != inhibition->generation) {
+        release_cookie (c->priv, cookie);
+        return;
+    }
 
-    priv->dbus_msg = dbus_message_new_method_call (MCE_SERVICE,
-            MCE_REQUEST_PATH, MCE_REQUEST_IF, MCE_PREVENT_BLANK_REQ);
-    g_assert (priv->dbus_msg != NULL);
-    dbus_message_set_no_reply (priv->dbus_msg, TRUE);
+    // the previous inhibition is released only once the new one is held,
+    // so the display doesn't blank in between
+    if (inhibition->cookie != 0)
+        release_cookie (c->priv, inhibition->cookie);
+    inhibition->cookie = cookie;
+    inhibition->timed = c->timed;
+    if (inhibition == &c->priv->inhibition)
+        latency_stop (c->priv, &c->priv->inhibit_latency, "inhibit");
+
+    update_inhibit_gui (c->priv);
 }
 
+// Replaces the current inhibition (if any) with a new one, timeout == 0
+// inhibits until disable_inhibition () is called
 static void
-init_mode_gui (DisplayBlankingStatusPluginPrivate *priv)
+enable_inhibition (DisplayBlankingStatusPluginPrivate *priv,
+        Inhibition *inhibition, guint timeout)
 {
-    priv->mode_dialog = NULL;
-    priv->mode_button = hildon_gtk_button_new (HILDON_SIZE_FINGER_HEIGHT |
+    const gchar *reason = inhibition->reason;
+    DBusMessage *msg = dbus_message_new_method_call (SADBA_SERVICE,
+            SADBA_PATH, SADBA_INTERFACE, inhibition->persistent ?
+                SADBA_INHIBIT_PERSISTENT : SADBA_INHIBIT);
+    g_assert (msg != NULL);
+    dbus_uint32_t t = timeout;
+    dbus_message_append_args (msg, DBUS_TYPE_STRING, &reason,
+            DBUS_TYPE_UINT32, &t, DBUS_TYPE_INVALID);
+
+    InhibitCall *c = g_slice_new (InhibitCall);
+    c->priv = priv;
+    c->inhibition = inhibition;
+    c->generation = ++inhibition->generation;
+    c->timed = timeout != 0;
+
+    send_to_daemon (priv, msg,
+            (DBusPendingCallNotifyFunction) on_inhibit_reply, c,
+            (DBusFreeFunction) inhibit_call_free);
+    dbus_message_unref (msg);
+}
+
+static void
+on_reclaim_reply (DBusPendingCall *call, InhibitCall *c)
+{
+    DBusMessage *reply = dbus_pending_call_steal_reply (call);
+    dbus_pending_call_unref (call);
+
+    DBusError error;
+    dbus_error_init (&error);
+    dbus_uint32_t cookie, timeout;
+    if (dbus_set_error_from_message (&error, reply)
+            || !dbus_message_get_args (reply, &error,
+                DBUS_TYPE_UINT32, &cookie, DBUS_TYPE_UINT32, &timeout,
+                DBUS_TYPE_INVALID)) {
+        g_warning ("Can't reclaim the inhibition: %s", error.message);
+        dbus_error_free (&error);
+        dbus_message_unref (reply);
+        return;
+    }
+    dbus_message_unref (reply);
+
+    if (cookie == 0)
+        return;
+
+    // the buttons were used meanwhile
+    Inhibition *inhibition = c->inhibition;
+    if (c->generation != inhibition->generation) {
+        release_cookie (c->priv, cookie);
+        return;
+    }
+
+    g_debug ("Reclaimed inhibition %u", cookie);
+    inhibition->cookie = cookie;
+    inhibition->timed = timeout != 0;
+    update_inhibit_gui (c->priv);
+}
+
+// Takes over the inhibition a previous instance left behind, if any (like
+// when hildon-desktop is restarted)
+static void
+reclaim_inhibition (DisplayBlankingStatusPluginPrivate *priv,
+        Inhibition *inhibition)
+{
+    g_assert (inhibition->persistent);
+
+    const gchar *reason = inhibition->reason;
+    DBusMessage *msg = dbus_message_new_method_call (SADBA_SERVICE,
+            SADBA_PATH, SADBA_INTERFACE, SADBA_RECLAIM);
+    g_assert (msg != NULL);
+    dbus_message_append_args (msg, DBUS_TYPE_STRING, &reason,
+            DBUS_TYPE_INVALID);
+
+    InhibitCall *c = g_slice_new (InhibitCall);
+    c->priv = priv;
+    c->inhibition = inhibition;
+    c->generation = inhibition->generation;
+    c->timed = FALSE;
+
+    send_to_daemon (priv, msg,
+            (DBusPendingCallNotifyFunction) on_reclaim_reply, c,
+            (DBusFreeFunction) inhibit_call_free);
+    dbus_message_unref (msg);
+}
+
+static void
+disable_inhibition (DisplayBlankingStatusPluginPrivate *priv,
+        Inhibition *inhibition)
+{
+    // a pending request is undone when its reply arrives
+    inhibition->generation++;
+
+    if (inhibition->cookie == 0) {
+        // somebody else is inhibiting, the buttons show the aggregate
+        update_inhibit_gui (priv);
+        return;
+    }
+
+    release_cookie (priv, inhibition->cookie);
+    inhibition->cookie = 0;
+}
+
+// Forgets about cookies the daemon dropped on its own
+static void
+forget_inhibition (Inhibition *inhibition, gboolean timed_only)
+{
+    if (!timed_only || inhibition->timed)
+        inhibition->cookie = 0;
+}
+
+static gboolean
+is_auto_inhibit_app (DisplayBlankingStatusPluginPrivate *priv)
+{
+    for (GSList *l = priv->auto_inhibit_apps; l != NULL; l = l->next) {
+        const gchar *app = l->data;
+        if ((priv->active_name != NULL
+                    && g_ascii_strcasecmp (app, priv->active_name) == 0)
+                || (priv->active_class != NULL
+                    && g_ascii_strcasecmp (app, priv->active_class) == 0))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+update_auto_inhibition (DisplayBlankingStatusPluginPrivate *priv)
+{
+    gboolean inhibit = is_auto_inhibit_app (priv);
+
+    if (inhibit == priv->auto_inhibiting)
+        return;
+    priv->auto_inhibiting = inhibit;
+
+    if (inhibit)
+        enable_inhibition (priv, &priv->auto_inhibition, 0);
+    else
+        disable_inhibition (priv, &priv->auto_inhibition);
+}
+
+static void
+on_active_window_changed (const gchar *res_name, const gchar *res_class,
+        DisplayBlankingStatusPluginPrivate *priv)
+{
+    g_free (priv->active_name);
+    g_free (priv->active_class);
+    priv->active_name = g_strdup (res_name);
+    priv->active_class = g_strdup (res_class);
+
+    update_auto_inhibition (priv);
+}
+
+static void
+load_auto_inhibit_apps (DisplayBlankingStatusPluginPrivate *priv)
+{
+    g_slist_foreach (priv->auto_inhibit_apps, (GFunc) g_free, NULL);
+    g_slist_free (priv->auto_inhibit_apps);
+
+    GError *error = NULL;
+    priv->auto_inhibit_apps = gconf_client_get_list (priv->gconf_client,
+            AUTO_INHIBIT_GCONF_KEY, GCONF_VALUE_STRING, &error);
+    if (error != NULL) {
+        g_warning ("Can't get %s: %s", AUTO_INHIBIT_GCONF_KEY,
+                error->message);
+        g_error_free (error);
+    }
+}
+
+static void
+on_auto_inhibit_gconf_notify (GConfClient* client, guint cnxn_id,
+        GConfEntry* entry, DisplayBlankingStatusPluginPrivate* priv)
+{
+    load_auto_inhibit_apps (priv);
+    update_auto_inhibition (priv);
+}
+
+static void
+show_banner (DisplayBlankingStatusPluginPrivate *priv, const gchar *text)
+{
+    GtkWidget *banner = hildon_banner_show_information (
+            priv->timed_inhibit_button, NULL, text);
+    hildon_banner_set_timeout (HILDON_BANNER (banner), BANNER_DURATION);
+}
+
+static void
+on_timed_inhibit_timeout (DisplayBlankingStatusPluginPrivate *priv)
+{
+    show_banner (priv, _ ("Display blanking inhibition disabled"));
+}
+
+static void
+on_idle_alarm (IdleAlarm *alarm, DisplayBlankingStatusPluginPrivate *priv)
+{
+    // the alarm triggers only once
+    priv->idle_timeout = 0;
+
+    // the daemon might have dropped it meanwhile
+    if (priv->inhibition.cookie == 0 || priv->inhibition.timed)
+        return;
+
+    g_debug ("No user input for a while, releasing the inhibition");
+    disable_inhibition (priv, &priv->inhibition);
+    on_timed_inhibit_timeout (priv);
+}
+
+static void
+on_battery_low (DisplayBlankingStatusPluginPrivate *priv)
+{
+    show_banner (priv,
+            _ ("Display blanking inhibition disabled, battery low"));
+}
+
+static void
+on_state_changed (DBusMessage *msg, DisplayBlankingStatusPluginPrivate *priv)
+{
+    dbus_uint32_t state, remaining, reason;
+    if (!dbus_message_get_args (msg, NULL, DBUS_TYPE_UINT32, &state,
+                DBUS_TYPE_UINT32, &remaining, DBUS_TYPE_UINT32, &reason,
+                DBUS_TYPE_INVALID)) {
+        g_warning ("Invalid %s signal", SADBA_STATE_CHANGED);
+        return;
+    }
+
+    set_daemon_state (priv, state, remaining);
+    update_inhibit_gui (priv);
+
+    if (reason == INHIBIT_ENGINE_REASON_TIMEOUT) {
+        // the daemon drops all the timed inhibitions when they are over
+        forget_inhibition (&priv->inhibition, TRUE);
+        on_timed_inhibit_timeout (priv);
+    }
+    else if (reason == INHIBIT_ENGINE_REASON_BATTERY_LOW) {
+        // the daemon dropped all the inhibitions, the auto one is not
+        // requested again until the active application changes
+        forget_inhibition (&priv->inhibition, FALSE);
+        forget_inhibition (&priv->auto_inhibition, FALSE);
+        on_battery_low (priv);
+    }
+}
+
+static void
+on_daemon_owner_changed (DBusMessage *msg,
+        DisplayBlankingStatusPluginPrivate *priv)
+{
+    const gchar *name, *old_owner, *new_owner;
+    if (!dbus_message_get_args (msg, NULL, DBUS_TYPE_STRING, &name,
+                DBUS_TYPE_STRING, &old_owner, DBUS_TYPE_STRING, &new_owner,
+                DBUS_TYPE_INVALID) || strcmp (name, SADBA_SERVICE) != 0)
+        return;
+
+    // a daemon that went away doesn't inhibit anything
+    if (*new_owner == '\0') {
+        set_daemon_state (priv, INHIBIT_ENGINE_OFF, 0);
+        forget_inhibition (&priv->inhibition, FALSE);
+        forget_inhibition (&priv->auto_inhibition, FALSE);
+        priv->auto_inhibiting = FALSE;
+        update_inhibit_gui (priv);
+        // restarts the daemon if an auto inhibition is still needed
+        update_auto_inhibition (priv);
+    }
+}
+
+static DBusHandlerResult
+on_dbus_message (DBusConnection *conn, DBusMessage *msg,
+        DisplayBlankingStatusPluginPrivate *priv)
+{
+    if (dbus_message_is_signal (msg, SADBA_INTERFACE, SADBA_STATE_CHANGED))
+        on_state_changed (msg, priv);
+    else if (dbus_message_is_signal (msg, DBUS_INTERFACE_DBUS,
+                "NameOwnerChanged"))
+        on_daemon_owner_changed (msg, priv);
+
+    // other filters might be interested too
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static void
+on_inhibit_button_clicked (GtkWidget *button,
+        DisplayBlankingStatusPluginPrivate *priv)
+{
+    if (priv->inhibit_in_signal)
+        return;
+
+    GtkWidget *parent = gtk_widget_get_ancestor (button, GTK_TYPE_WINDOW);
+    gtk_widget_hide (parent);
+
+    // turns a timed inhibition into a manual one if there is one
+    if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (button))) {
+        latency_start (&priv->inhibit_latency);
+        enable_inhibition (priv, &priv->inhibition, 0);
+    }
+    else
+        disable_inhibition (priv, &priv->inhibition);
+}
+
+static GtkWidget *
+timed_inhibit_picker_new (const gchar* title, gsize current, guint max,
+        guint step)
+{
+    g_assert (max < 100);
+    static gchar buffer[3]; // 2 for the number + 1 for \0
+
+    GtkWidget *selector = hildon_touch_selector_entry_new_text ();
+    gint selected = -1;
+    for (int i = 0; i*step <= max; i++) {
+        if (i*step == current)
+            selected = i;
+        hildon_touch_selector_append_text (HILDON_TOUCH_SELECTOR (selector),
+                g_ascii_formatd (buffer, 3, "%.0f", i*step));
+    }
+    hildon_gtk_entry_set_input_mode (GTK_ENTRY (
+                hildon_touch_selector_entry_get_entry (
+                    HILDON_TOUCH_SELECTOR_ENTRY (selector))),
+            HILDON_GTK_INPUT_MODE_NUMERIC);
+
+    GtkWidget *picker = hildon_picker_button_new (HILDON_SIZE_FINGER_HEIGHT,
+            HILDON_BUTTON_ARRANGEMENT_VERTICAL);
+    hildon_button_set_title (HILDON_BUTTON (picker), title);
+    hildon_picker_button_set_selector (HILDON_PICKER_BUTTON (picker),
+            HILDON_TOUCH_SELECTOR (selector));
+    hildon_picker_button_set_active (HILDON_PICKER_BUTTON (picker),
+            selected);
+    hildon_button_set_value (HILDON_BUTTON (picker),
+                g_ascii_formatd (buffer, 3, "%.0f", current));
+
+    g_object_set_data (G_OBJECT (picker), "max", GUINT_TO_POINTER (max));
+
+    return picker;
+}
+
+static guint
+timed_inhibit_picker_get_value (GtkWidget *picker)
+{
+    guint max = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (picker), "max"));
+
+    return CLAMP (g_ascii_strtod (hildon_button_get_value (
+                    HILDON_BUTTON (picker)), NULL), 0, max);
+}
+
+static gboolean
+on_dialog_map_event (GtkWidget *dialog, GdkEvent *event,
+        DisplayBlankingStatusPluginPrivate *priv)
+{
+    latency_stop (priv, &priv->dialog_latency,
+            dialog == priv->mode_dialog ? "mode_dialog" : "timed_dialog");
+
+    return FALSE;
+}
+
+static void
+timed_inhibit_dialog_build (DisplayBlankingStatusPluginPrivate *priv)
+{
+    g_assert (priv->timed_inhibit_dialog == NULL);
+    priv->timed_inhibit_dialog = gtk_dialog_new_with_buttons (
+            _ ("Inhibit display blanking for..."), NULL, GTK_DIALOG_MODAL,
+            GTK_STOCK_OK, GTK_RESPONSE_ACCEPT,
+            GTK_STOCK_CANCEL, GTK_RESPONSE_REJECT, NULL);
+    // the dialog is reused, so just hide it when closed
+    g_signal_connect (priv->timed_inhibit_dialog, "delete-event",
+            G_CALLBACK (gtk_widget_hide_on_delete), NULL);
+    g_signal_connect (priv->timed_inhibit_dialog, "map-event",
+            G_CALLBACK (on_dialog_map_event), priv);
+
+    priv->hours_picker = timed_inhibit_picker_new (_ ("Hours"),
+            gconf_client_get_int (priv->gconf_client, HOURS_GCONF_KEY, NULL),
+            24, 1);
+    priv->minutes_picker = timed_inhibit_picker_new (_ ("Minutes"),
+            gconf_client_get_int (priv->gconf_client, MINUTES_GCONF_KEY, NULL),
+            60, 10);
+
+    GtkWidget *hbox = gtk_hbox_new (FALSE, 0);
+    g_assert (hbox != NULL);
+
+    gtk_container_add (GTK_CONTAINER (hbox), priv->hours_picker);
+    gtk_container_add (GTK_CONTAINER (hbox), priv->minutes_picker);
+
+    // filled before it's run
+    priv->quick_box = gtk_hbox_new (TRUE, 0);
+    g_assert (priv->quick_box != NULL);
+    priv->quick_box_stale = TRUE;
+
+    GtkWidget *content_area = gtk_dialog_get_content_area (
+            GTK_DIALOG (priv->timed_inhibit_dialog));
+    gtk_container_add (GTK_CONTAINER (content_area), priv->quick_box);
+    gtk_container_add (GTK_CONTAINER (content_area), hbox);
+
+    gtk_widget_show_all (content_area);
+}
+
+static gboolean
+on_dialogs_trim (DisplayBlankingStatusPluginPrivate *priv)
+{
+    // the source is removed when returning FALSE
+    priv->dialogs_trim_id = 0;
+
+    if (priv->timed_inhibit_dialog != NULL
+            && !GTK_WIDGET_VISIBLE (priv->timed_inhibit_dialog)) {
+        gtk_widget_destroy (priv->timed_inhibit_dialog);
+        priv->timed_inhibit_dialog = NULL;
+        priv->hours_picker = NULL;
+        priv->minutes_picker = NULL;
+        priv->quick_box = NULL;
+        stats_add (priv->stats, "dialog_trims", 1);
+    }
+    if (priv->mode_dialog != NULL && !GTK_WIDGET_VISIBLE (priv->mode_dialog)) {
+        gtk_widget_destroy (priv->mode_dialog);
+        priv->mode_dialog = NULL;
+        stats_add (priv->stats, "dialog_trims", 1);
+    }
+
+    return FALSE;
+}
+
+// The dialogs are kept around for a while in case they are used again
+// soon, but hildon-desktop runs for the whole session, so they are not
+// kept forever
+static void
+queue_dialogs_trim (DisplayBlankingStatusPluginPrivate *priv)
+{
+    if (priv->dialogs_trim_id != 0)
+        g_source_remove (priv->dialogs_trim_id);
+    priv->dialogs_trim_id = g_timeout_add_seconds (DIALOG_CACHE_TIMEOUT,
+            (GSourceFunc) on_dialogs_trim, priv);
+}
+
+// The returned string must be freed
+static gchar *
+format_timeout (guint timeout)
+{
+    guint hours = timeout / 3600;
+    guint mins = timeout % 3600 / 60;
+
+    if (hours == 0)
+        return g_strdup_printf (_ ("%u min"), mins);
+    if (mins == 0)
+        return g_strdup_printf (_ ("%u h"), hours);
+    return g_strdup_printf (_ ("%u h %u min"), hours, mins);
+}
+
+static void
+remember_timeout (DisplayBlankingStatusPluginPrivate *priv, guint timeout)
+{
+    // moved to the front, dropping the least recent one if it's new
+    guint i = 0;
+    while (i < RECENT_TIMEOUTS - 1 && priv->recent_timeouts[i] != timeout)
+        i++;
+    if (i == 0 && priv->recent_timeouts[0] == timeout)
+        return;
+    for (; i > 0; i--)
+        priv->recent_timeouts[i] = priv->recent_timeouts[i - 1];
+    priv->recent_timeouts[0] = timeout;
+
+    GSList *list = NULL;
+    for (i = RECENT_TIMEOUTS; i > 0; i--)
+        if (priv->recent_timeouts[i - 1] != 0)
+            list = g_slist_prepend (list,
+                    GUINT_TO_POINTER (priv->recent_timeouts[i - 1]));
+    // saved later, so gconfd is not in the way of the inhibition
+    gconf_change_set_set_list (priv->pending_changes, RECENT_GCONF_KEY,
+            GCONF_VALUE_INT, list);
+    g_slist_free (list);
+    queue_gconf_idle (priv);
+
+    // filled with the new order on next use, the dialog might be running
+    // now
+    priv->quick_box_stale = TRUE;
+}
+
+static void
+on_quick_timeout_clicked (GtkWidget *button,
+        DisplayBlankingStatusPluginPrivate *priv)
+{
+    priv->quick_timeout = GPOINTER_TO_UINT (g_object_get_data (
+                G_OBJECT (button), "timeout"));
+    gtk_dialog_response (GTK_DIALOG (priv->timed_inhibit_dialog),
+            QUICK_RESPONSE);
+}
+
+static void
+quick_box_append (DisplayBlankingStatusPluginPrivate *priv, guint timeout)
+{
+    gchar *label = format_timeout (timeout);
+    GtkWidget *button = hildon_gtk_button_new (HILDON_SIZE_FINGER_HEIGHT);
+    gtk_button_set_label (GTK_BUTTON (button), label);
+    g_free (label);
+
+    g_object_set_data (G_OBJECT (button), "timeout",
+            GUINT_TO_POINTER (timeout));
+    g_signal_connect (button, "clicked",
+            G_CALLBACK (on_quick_timeout_clicked), priv);
+    gtk_container_add (GTK_CONTAINER (priv->quick_box), button);
+}
+
+static gboolean
+is_recent_timeout (DisplayBlankingStatusPluginPrivate *priv, guint timeout)
+{
+    for (int i = 0; i < RECENT_TIMEOUTS; i++)
+        if (priv->recent_timeouts[i] == timeout)
+            return TRUE;
+
+    return FALSE;
+}
+
+static void
+quick_box_fill (DisplayBlankingStatusPluginPrivate *priv)
+{
+    gtk_container_foreach (GTK_CONTAINER (priv->quick_box),
+            (GtkCallback) gtk_widget_destroy, NULL);
+    priv->quick_box_stale = FALSE;
+
+    // the last used one goes first, so it's a single tap away
+    guint n = 0;
+    for (int i = 0; i < RECENT_TIMEOUTS && n < QUICK_TIMEOUTS; i++)
+        if (priv->recent_timeouts[i] != 0) {
+            quick_box_append (priv, priv->recent_timeouts[i]);
+            n++;
+        }
+    for (int i = 0; i < G_N_ELEMENTS (preset_timeouts) && n < QUICK_TIMEOUTS;
+            i++)
+        if (!is_recent_timeout (priv, preset_timeouts[i])) {
+            quick_box_append (priv, preset_timeouts[i]);
+            n++;
+        }
+
+    gtk_widget_show_all (priv->quick_box);
+}
+
+static guint
+timed_inhibit_get_input (DisplayBlankingStatusPluginPrivate *priv)
+{
+    // the pickers keep the last used values between runs
+    if (priv->timed_inhibit_dialog == NULL) {
+        GTimer *timer = g_timer_new ();
+        timed_inhibit_dialog_build (priv);
+        stats_add (priv->stats, "timed_dialog_builds", 1);
+        stats_set (priv->stats, "timed_dialog_build_time_us",
+                g_timer_elapsed (timer, NULL) * G_USEC_PER_SEC);
+        g_timer_destroy (timer);
+    }
+    if (priv->quick_box_stale)
+        quick_box_fill (priv);
+
+    gint result = gtk_dialog_run (GTK_DIALOG (priv->timed_inhibit_dialog));
+    gtk_widget_hide (priv->timed_inhibit_dialog);
+    queue_dialogs_trim (priv);
+
+    guint timeout = 0;
+    if (result == GTK_RESPONSE_ACCEPT) {
+        gint hours = timed_inhibit_picker_get_value (priv->hours_picker);
+        gint mins = timed_inhibit_picker_get_value (priv->minutes_picker);
+
+        // saved later, so gconfd is not in the way of the inhibition
+        gconf_change_set_set_int (priv->pending_changes, HOURS_GCONF_KEY,
+                hours);
+        gconf_change_set_set_int (priv->pending_changes, MINUTES_GCONF_KEY,
+                mins);
+        queue_gconf_idle (priv);
+
+        timeout = hours*3600 + mins*60;
+        if (timeout)
+            remember_timeout (priv, timeout);
+    }
+    else if (result == QUICK_RESPONSE) {
+        // the pickers are left alone, they are for other durations
+        timeout = priv->quick_timeout;
+        remember_timeout (priv, timeout);
+    }
+
+    return timeout;
+}
+
+// Repeats the last timed inhibition (the shortest preset if there is
+// none), without the dialog or GConf in the way
+static void
+on_timed_inhibit_tap_and_hold (GtkWidget *button,
+        DisplayBlankingStatusPluginPrivate *priv)
+{
+    GtkWidget *parent = gtk_widget_get_ancestor (GTK_WIDGET (priv->mode_button),
+            GTK_TYPE_WINDOW);
+    gtk_widget_hide (parent);
+
+    guint timeout = priv->recent_timeouts[0];
+    if (timeout == 0)
+        timeout = preset_timeouts[0];
+
+    latency_start (&priv->inhibit_latency);
+    enable_inhibition (priv, &priv->inhibition, timeout);
+    remember_timeout (priv, timeout);
+}
+
+static void
+on_timed_inhibit_button_clicked (GtkWidget *button,
+        DisplayBlankingStatusPluginPrivate *priv)
+{
+    if (priv->inhibit_in_signal)
+        return;
+
+    GtkWidget *parent = gtk_widget_get_ancestor (GTK_WIDGET (priv->mode_button),
+            GTK_TYPE_WINDOW);
+    gtk_widget_hide (parent);
+
+    if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (button))) {
+        // turns a manual inhibition into a timed one if there is one
+        latency_start (&priv->dialog_latency);
+        guint timeout = timed_inhibit_get_input (priv);
+        if (timeout) {
+            latency_start (&priv->inhibit_latency);
+            enable_inhibition (priv, &priv->inhibition, timeout);
+        }
+        else // cancelled, restore the previous state
+            update_inhibit_gui (priv);
+    }
+    else
+        disable_inhibition (priv, &priv->inhibition);
+}
+
+static void
+on_mode_dialog_button_clicked (GtkWidget *button, GtkDialog *dialog)
+{
+    gint mode = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (button),
+                "mode"));
+    g_assert (mode >= 0 && mode < BLANKING_MODES);
+
+    // modes are used directly as response IDs (they are all >= 0)
+    gtk_dialog_response (dialog, mode);
+}
+
+static void
+mode_dialog_build (DisplayBlankingStatusPluginPrivate *priv)
+{
+    g_assert (priv->mode_dialog == NULL);
+    priv->mode_dialog = gtk_dialog_new ();
+    gtk_window_set_modal (GTK_WINDOW (priv->mode_dialog), TRUE);
+    gtk_window_set_title (GTK_WINDOW (priv->mode_dialog),
+            _ ("Select display blanking mode"));
+    // the dialog is reused, so just hide it when closed
+    g_signal_connect (priv->mode_dialog, "delete-event",
+            G_CALLBACK (gtk_widget_hide_on_delete), NULL);
+    g_signal_connect (priv->mode_dialog, "map-event",
+            G_CALLBACK (on_dialog_map_event), priv);
+
+    GtkWidget *pan_area = hildon_pannable_area_new ();
+    g_assert (pan_area != NULL);
+
+    GtkWidget *vbox = gtk_vbox_new (FALSE, 0);
+    g_assert (vbox != NULL);
+
+    hildon_pannable_area_add_with_viewport (HILDON_PANNABLE_AREA (pan_area),
+            vbox);
+    GtkWidget *content_area = gtk_dialog_get_content_area (
+            GTK_DIALOG (priv->mode_dialog));
+    gtk_box_pack_start (GTK_BOX (content_area), pan_area, TRUE, TRUE, 0);
+
+    gtk_widget_set_size_request (pan_area, -1, MIN (350, BLANKING_MODES * 70));
+
+    for (int i = 0; i < BLANKING_MODES; i++) {
+        GtkWidget *button =
+                hildon_button_new_with_text (HILDON_SIZE_FINGER_HEIGHT,
+                    HILDON_BUTTON_ARRANGEMENT_VERTICAL, _ (mode_title[i]),
+                    _ (mode_desc[i]));
+        hildon_button_set_style (HILDON_BUTTON (button),
+            HILDON_BUTTON_STYLE_PICKER);
+        GtkWidget *icon = gtk_image_new_from_pixbuf (get_icon (priv, i));
+        hildon_button_set_image (HILDON_BUTTON (button), icon);
+        gtk_button_set_alignment (GTK_BUTTON (button), 0.0f, 0.5f);
+        gtk_box_pack_start (GTK_BOX (vbox), button, FALSE, FALSE, 0);
+        g_object_set_data (G_OBJECT (button), "mode", GINT_TO_POINTER (i));
+        g_signal_connect (button, "clicked",
+                G_CALLBACK (on_mode_dialog_button_clicked), priv->mode_dialog);
+    }
+
+    gtk_widget_show_all (content_area);
+}
+
+static gint
+mode_get_input (DisplayBlankingStatusPluginPrivate *priv)
+{
+    if (priv->mode_dialog == NULL) {
+        GTimer *timer = g_timer_new ();
+        mode_dialog_build (priv);
+        stats_add (priv->stats, "mode_dialog_builds", 1);
+        stats_set (priv->stats, "mode_dialog_build_time_us",
+                g_timer_elapsed (timer, NULL) * G_USEC_PER_SEC);
+        g_timer_destroy (timer);
+    }
+
+    gint result = gtk_dialog_run (GTK_DIALOG (priv->mode_dialog));
+    gtk_widget_hide (priv->mode_dialog);
+    queue_dialogs_trim (priv);
+
+    if (result < 0 || result >= BLANKING_MODES)
+        return BLANKING_MODES;
+
+    return result;
+}
+
+static void
+on_mode_button_clicked (GtkWidget *button,
+        DisplayBlankingStatusPluginPrivate *priv)
+{
+    GtkWidget *parent = gtk_widget_get_ancestor (GTK_WIDGET (priv->mode_button),
+            GTK_TYPE_WINDOW);
+    gtk_widget_hide (parent);
+
+    latency_start (&priv->dialog_latency);
+    gint mode = mode_get_input (priv);
+
+    if (mode != BLANKING_MODES) {
+        // GConf only notifies about actual changes
+        if (mode != priv->mode)
+            latency_start (&priv->mode_latency);
+        // the daemon writes it, which triggers the gconf notify signal
+        dbus_int32_t m = mode;
+        call_daemon (priv, SADBA_SET_MODE, DBUS_TYPE_INT32, &m,
+                DBUS_TYPE_INVALID);
+    }
+}
+
+static gboolean
+on_slider_write (DisplayBlankingStatusPluginPrivate *priv)
+{
+    // the source is removed when returning FALSE
+    priv->slider_write_id = 0;
+    commit_pending_changes (priv);
+
+    return FALSE;
+}
+
+static void
+queue_slider_write (DisplayBlankingStatusPluginPrivate *priv)
+{
+    if (priv->slider_write_id == 0)
+        priv->slider_write_id = g_timeout_add (SLIDER_WRITE_INTERVAL,
+                (GSourceFunc) on_slider_write, priv);
+}
+
+static gboolean
+on_slider_pressed (GtkWidget *scale, GdkEventButton *event,
+        DisplayBlankingStatusPluginPrivate *priv)
+{
+    priv->slider_dragging = TRUE;
+
+    return FALSE;
+}
+
+static gboolean
+on_slider_released (GtkWidget *scale, GdkEventButton *event,
+        DisplayBlankingStatusPluginPrivate *priv)
+{
+    priv->slider_dragging = FALSE;
+
+    // the final value is written right away
+    if (priv->slider_write_id != 0) {
+        g_source_remove (priv->slider_write_id);
+        on_slider_write (priv);
+    }
+
+    return FALSE;
+}
+
+static void
+on_brightness_changed (GtkRange *range,
+        DisplayBlankingStatusPluginPrivate *priv)
+{
+    if (priv->slider_in_signal)
+        return;
+
+    gconf_change_set_set_int (priv->pending_changes, BRIGHTNESS_GCONF_KEY,
+            gtk_range_get_value (range));
+    queue_slider_write (priv);
+}
+
+static void
+on_dim_timeout_changed (GtkRange *range,
+        DisplayBlankingStatusPluginPrivate *priv)
+{
+    if (priv->slider_in_signal)
+        return;
+
+    gint timeout = dim_timeouts[(guint) gtk_range_get_value (range)];
+    update_dim_timeout_label (priv, timeout);
+    gconf_change_set_set_int (priv->pending_changes, DIM_TIMEOUT_GCONF_KEY,
+            timeout);
+    queue_slider_write (priv);
+}
+
+static void
+on_gconf_notify (GConfClient* client, guint cnxn_id, GConfEntry* entry,
+        DisplayBlankingStatusPluginPrivate* priv)
+{
+    // registered for MODE_GCONF_KEY, BRIGHTNESS_GCONF_KEY and
+    // DIM_TIMEOUT_GCONF_KEY
+    const gchar *key = gconf_entry_get_key (entry);
+    const GConfValue* value = gconf_entry_get_value (entry);
+    if (value == NULL || value->type != GCONF_VALUE_INT) {
+        g_warning ("Invalid value for %s", key);
+        return;
+    }
+
+    // only the last of a burst of changes gets to the GUI
+    if (strcmp (key, MODE_GCONF_KEY) == 0)
+        priv->pending_mode = gconf_value_get_int (value);
+    else if (strcmp (key, BRIGHTNESS_GCONF_KEY) == 0)
+        priv->pending_brightness = gconf_value_get_int (value);
+    else
+        priv->pending_dim_timeout = gconf_value_get_int (value);
+    queue_gconf_idle (priv);
+}
+
+static void
+init_gconf (DisplayBlankingStatusPluginPrivate *priv)
+{
+    GError* error = NULL;
+
+    priv->gconf_client = gconf_client_get_default ();
+    g_assert (GCONF_IS_CLIENT (priv->gconf_client));
+
+    priv->gconf_idle_id = 0;
+    priv->pending_mode = -1;
+    priv->pending_brightness = priv->pending_dim_timeout = -1;
+    priv->pending_changes = gconf_change_set_new ();
+
+    // GConf accepts single keys here too, watching just the keys we show
+    // instead of the whole MODE_GCONF_ROOT directory means gconfd doesn't
+    // wake us up for every other display setting change
+    const gchar *keys[] = { MODE_GCONF_KEY, BRIGHTNESS_GCONF_KEY,
+            DIM_TIMEOUT_GCONF_KEY };
+    for (int i = 0; i < G_N_ELEMENTS (keys); i++) {
+        gconf_client_add_dir (priv->gconf_client, keys[i],
+                GCONF_CLIENT_PRELOAD_NONE, &error);
+        g_assert (error == NULL);
+    }
+
+    // our own keys are all fetched at once and served from the client cache
+    gconf_client_add_dir (priv->gconf_client, SADBA_GCONF_ROOT,
+            GCONF_CLIENT_PRELOAD_ONELEVEL, &error);
+    g_assert (error == NULL);
+
+    priv->gconf_notify_ids[0] = gconf_client_notify_add (priv->gconf_client,
+            MODE_GCONF_KEY, (GConfClientNotifyFunc) &on_gconf_notify, priv,
+            NULL, &error);
+    g_assert (error == NULL);
+    priv->gconf_notify_ids[2] = gconf_client_notify_add (priv->gconf_client,
+            BRIGHTNESS_GCONF_KEY, (GConfClientNotifyFunc) &on_gconf_notify,
+            priv, NULL, &error);
+    g_assert (error == NULL);
+    priv->gconf_notify_ids[3] = gconf_client_notify_add (priv->gconf_client,
+            DIM_TIMEOUT_GCONF_KEY, (GConfClientNotifyFunc) &on_gconf_notify,
+            priv, NULL, &error);
+    g_assert (error == NULL);
+}
+
+#define DAEMON_OWNER_MATCH "type='signal',sender='" DBUS_SERVICE_DBUS "'," \
+        "interface='" DBUS_INTERFACE_DBUS "',member='NameOwnerChanged'," \
+        "arg0='" SADBA_SERVICE "'"
+
+static void
+init_dbus (DisplayBlankingStatusPluginPrivate *priv)
+{
+    DBusError error;
+    dbus_error_init (&error);
+
+    priv->session_dbus_conn = dbus_bus_get (DBUS_BUS_SESSION, &error);
+    g_assert (!dbus_error_is_set (&error));
+    g_assert (priv->session_dbus_conn != NULL);
+
+    // needed to get the daemon signals, it's a no-op if hildon-desktop
+    // already did it
+    dbus_connection_setup_with_g_main (priv->session_dbus_conn, NULL);
+
+    // errors are not checked so the match rules are added without blocking
+    dbus_bus_add_match (priv->session_dbus_conn, SADBA_STATE_CHANGED_MATCH,
+            NULL);
+    dbus_bus_add_match (priv->session_dbus_conn, DAEMON_OWNER_MATCH, NULL);
+    dbus_connection_add_filter (priv->session_dbus_conn,
+            (DBusHandleMessageFunction) on_dbus_message, priv, NULL);
+
+    // starts the daemon if it's not running yet
+    sync_state (priv);
+    reclaim_inhibition (priv, &priv->inhibition);
+}
+
+// The statistics are not essential, so failures here are not fatal
+static void
+init_stats_dbus (DisplayBlankingStatusPluginPrivate *priv)
+{
+    DBusError error;
+    dbus_error_init (&error);
+
+    int r = dbus_bus_request_name (priv->session_dbus_conn, STATS_BUS_NAME,
+            DBUS_NAME_FLAG_DO_NOT_QUEUE, &error);
+    if (r != DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER) {
+        g_warning ("Can't get the %s bus name: %s", STATS_BUS_NAME,
+                dbus_error_is_set (&error) ? error.message : "name taken");
+        dbus_error_free (&error);
+        return;
+    }
+
+    priv->stats_exported = stats_export (priv->stats,
+            priv->session_dbus_conn);
+}
+
+// Needs GConf and the daemon connection
+static void
+init_auto_inhibit (DisplayBlankingStatusPluginPrivate *priv)
+{
+    GError* error = NULL;
+
+    load_auto_inhibit_apps (priv);
+    priv->gconf_notify_ids[1] = gconf_client_notify_add (priv->gconf_client,
+            AUTO_INHIBIT_GCONF_KEY,
+            (GConfClientNotifyFunc) &on_auto_inhibit_gconf_notify, priv,
+            NULL, &error);
+    g_assert (error == NULL);
+
+    priv->active_window = active_window_new (
+            (ActiveWindowNotify) on_active_window_changed, priv);
+}
+
+// Needs GConf
+static void
+init_recent_timeouts (DisplayBlankingStatusPluginPrivate *priv)
+{
+    // served from the client cache, SADBA_GCONF_ROOT is preloaded
+    GSList *list = gconf_client_get_list (priv->gconf_client,
+            RECENT_GCONF_KEY, GCONF_VALUE_INT, NULL);
+    int n = 0;
+    for (GSList *l = list; l != NULL && n < RECENT_TIMEOUTS; l = l->next)
+        if (GPOINTER_TO_INT (l->data) > 0)
+            priv->recent_timeouts[n++] = GPOINTER_TO_INT (l->data);
+    g_slist_free (list);
+
+    // the dialog values are the last used ones before the list existed
+    if (n == 0)
+        priv->recent_timeouts[0] = MAX (gconf_client_get_int (
+                    priv->gconf_client, HOURS_GCONF_KEY, NULL) * 3600
+                + gconf_client_get_int (priv->gconf_client,
+                    MINUTES_GCONF_KEY, NULL) * 60, 0);
+}
+
+static void
+init_idle_release (DisplayBlankingStatusPluginPrivate *priv)
+{
+    priv->idle_timeout = 0;
+    priv->idle_alarm = idle_alarm_new ((IdleAlarmNotify) on_idle_alarm,
+            priv);
+    if (priv->idle_alarm == NULL)
+        g_warning ("No X idle counter, manual inhibitions are never "
+                "released for inactivity");
+}
+
+static void
+init_mode_gui (DisplayBlankingStatusPluginPrivate *priv)
+{
+    priv->mode_dialog = NULL;
+    priv->mode_button = hildon_gtk_button_new (HILDON_SIZE_FINGER_HEIGHT |
                 HILDON_SIZE_AUTO_WIDTH);
+    priv->mode_image = gtk_image_new ();
+    gtk_button_set_image (GTK_BUTTON (priv->mode_button), priv->mode_image);
+    // for themes and the tests
+    gtk_widget_set_name (priv->mode_button, "mode_button");
+    priv->mode = -1;
+
+    g_signal_connect (priv->mode_button, "clicked",
+            G_CALLBACK (on_mode_button_clicked), priv);
+}
 
+static GtkWidget *
+slider_new (gdouble max, GCallback cb, DisplayBlankingStatusPluginPrivate *priv)
+{
+    GtkWidget *scale = hildon_gtk_hscale_new ();
+    g_assert (scale != NULL);
+    gtk_scale_set_draw_value (GTK_SCALE (scale), FALSE);
+    gtk_scale_set_digits (GTK_SCALE (scale), 0); // snaps to the steps
+    gtk_range_set_increments (GTK_RANGE (scale), 1, 1);
+    gtk_range_set_range (GTK_RANGE (scale), 0, max);
+    g_signal_connect (scale, "value-changed", cb, priv);
+    g_signal_connect (scale, "button-press-event",
+            G_CALLBACK (on_slider_pressed), priv);
+    g_signal_connect (scale, "button-release-event",
+            G_CALLBACK (on_slider_released), priv);
+
+    return scale;
+}
+
+static void
+init_display_gui (DisplayBlankingStatusPluginPrivate *priv)
+{
+    priv->slider_in_signal = FALSE;
+    priv->slider_dragging = FALSE;
+    priv->slider_write_id = 0;
+
+    priv->brightness_scale = slider_new (BRIGHTNESS_MAX,
+            G_CALLBACK (on_brightness_changed), priv);
+    gtk_range_set_range (GTK_RANGE (priv->brightness_scale), BRIGHTNESS_MIN,
+            BRIGHTNESS_MAX);
+    priv->dim_timeout_scale = slider_new (DIM_TIMEOUTS - 1,
+            G_CALLBACK (on_dim_timeout_changed), priv);
+    // for themes and the tests
+    gtk_widget_set_name (priv->brightness_scale, "brightness_scale");
+    gtk_widget_set_name (priv->dim_timeout_scale, "dim_timeout_scale");
+    priv->dim_timeout_label = gtk_label_new (NULL);
+}
+
+// Needs GConf
+static void
+init_display (DisplayBlankingStatusPluginPrivate *priv)
+{
+    update_brightness_gui (priv, gconf_client_get_int (priv->gconf_client,
+                BRIGHTNESS_GCONF_KEY, NULL));
+    update_dim_timeout_gui (priv, gconf_client_get_int (priv->gconf_client,
+                DIM_TIMEOUT_GCONF_KEY, NULL));
+}
+
+static void
+init_mode (DisplayBlankingStatusPluginPrivate *priv)
+{
     GError* error = NULL;
     gint mode = gconf_client_get_int (priv->gconf_client, MODE_GCONF_KEY,
             &error);
     g_assert (error == NULL);
     update_mode_gui (mode, priv);
-
-    g_signal_connect (priv->mode_button, "clicked",
-            G_CALLBACK (on_mode_button_clicked), priv);
 }
 
 static GtkWidget *
-inhibit_button_new (const gchar *icon_name,
+inhibit_button_new (GdkPixbuf *pixbuf,
         void (*cb) (GtkWidget *, DisplayBlankingStatusPluginPrivate *),
         gpointer cb_data)
 {
@@ -580,8 +1868,7 @@ inhibit_button_new (const gchar *icon_name,
     GtkWidget *b = hildon_gtk_toggle_button_new (HILDON_SIZE_FINGER_HEIGHT |
             HILDON_SIZE_AUTO_WIDTH);
     gtk_toggle_button_set_mode (GTK_TOGGLE_BUTTON (b), FALSE);
-    GtkWidget *icon = gtk_image_new_from_icon_name (icon_name,
-            GTK_ICON_SIZE_DIALOG);
+    GtkWidget *icon = gtk_image_new_from_pixbuf (pixbuf);
     gtk_button_set_image (GTK_BUTTON (b), icon);
     g_signal_connect (b, "clicked", G_CALLBACK (cb), cb_data);
 
@@ -592,15 +1879,251 @@ static void
 init_inhibit_gui (DisplayBlankingStatusPluginPrivate *priv)
 {
     priv->inhibit_in_signal = FALSE;
+    priv->timed_inhibit_dialog = NULL;
 
-    priv->inhibit_timer_id = 0;
-    priv->timed_inhibit_timer_id = 0;
-
-    priv->inhibit_button = inhibit_button_new (INHIBIT_ICON_NAME,
+    // until the daemon tells us otherwise
+    priv->state = INHIBIT_ENGINE_OFF;
+    priv->remaining = 0;
+    priv->deadline = 0;
+    priv->timed_total = 0;
+    priv->inhibition.reason = INHIBIT_REASON;
+    priv->inhibition.cookie = 0;
+    priv->inhibition.timed = FALSE;
+    priv->inhibition.generation = 0;
+    priv->inhibition.persistent = TRUE;
+    priv->auto_inhibition = priv->inhibition;
+    priv->auto_inhibition.reason = AUTO_INHIBIT_REASON;
+    // requested again when the application is found active
+    priv->auto_inhibition.persistent = FALSE;
+    priv->auto_inhibiting = FALSE;
+    priv->auto_inhibit_apps = NULL;
+    priv->active_window = NULL;
+    priv->active_name = NULL;
+    priv->active_class = NULL;
+
+    priv->inhibit_button = inhibit_button_new (get_icon (priv, INHIBIT_ICON),
             on_inhibit_button_clicked, priv);
 
     priv->timed_inhibit_button = inhibit_button_new (
-            TIMED_INHIBIT_ICON_NAME, on_timed_inhibit_button_clicked, priv);
+            get_icon (priv, TIMED_INHIBIT_ICON),
+            on_timed_inhibit_button_clicked, priv);
+    gtk_widget_set_name (priv->inhibit_button, "inhibit_button");
+    gtk_widget_set_name (priv->timed_inhibit_button, "timed_inhibit_button");
+    // the last timeout again, without going through the dialog
+    priv->quick_box = NULL;
+    priv->quick_box_stale = FALSE;
+    priv->quick_timeout = 0;
+    gtk_widget_tap_and_hold_setup (priv->timed_inhibit_button, NULL, NULL, 0);
+    g_signal_connect (priv->timed_inhibit_button, "tap-and-hold",
+            G_CALLBACK (on_timed_inhibit_tap_and_hold), priv);
+}
+
+static void
+on_icon_theme_changed (GtkIconTheme *icon_theme,
+        DisplayBlankingStatusPlugin *plugin)
+{
+    DisplayBlankingStatusPluginPrivate *priv = plugin->priv;
+
+    for (int i = 0; i < ICONS; i++) {
+        if (priv->icons[i] != NULL) {
+            g_object_unref (priv->icons[i]);
+            priv->icons[i] = NULL;
+        }
+    }
+    countdown_clear (priv);
+
+    if (priv->mode >= 0)
+        update_mode_gui (priv->mode, priv);
+    gtk_image_set_from_pixbuf (GTK_IMAGE (gtk_button_get_image (
+                    GTK_BUTTON (priv->inhibit_button))),
+            get_icon (priv, INHIBIT_ICON));
+    gtk_image_set_from_pixbuf (GTK_IMAGE (gtk_button_get_image (
+                    GTK_BUTTON (priv->timed_inhibit_button))),
+            get_icon (priv, TIMED_INHIBIT_ICON));
+    update_inhibit_gui (priv);
+
+    // the mode dialog buttons use the old icons, rebuild it on next use
+    if (priv->mode_dialog != NULL && !GTK_WIDGET_VISIBLE (priv->mode_dialog)) {
+        gtk_widget_destroy (priv->mode_dialog);
+        priv->mode_dialog = NULL;
+    }
+}
+
+static void
+init_icons (DisplayBlankingStatusPluginPrivate *priv)
+{
+    for (int i = 0; i < ICONS; i++)
+        priv->icons[i] = NULL;
+    priv->countdown_base = priv->countdown_faded = NULL;
+    priv->countdown[0] = priv->countdown[1] = NULL;
+    priv->countdown_current = 0;
+    priv->countdown_angles = NULL;
+    priv->countdown_minutes = 0;
+
+    // the handler is disconnected automatically when the plugin is destroyed
+    g_signal_connect_object (gtk_icon_theme_get_default (), "changed",
+            G_CALLBACK (on_icon_theme_changed), priv->plugin, 0);
+}
+
+static void
+log_init_phase (DisplayBlankingStatusPluginPrivate *priv, GTimer *timer,
+        const gchar *phase)
+{
+    gdouble elapsed = g_timer_elapsed (timer, NULL);
+    g_debug ("%s initialization took %.2f ms", phase, elapsed * 1000.0);
+
+    gchar *name = g_strdup_printf ("init_%s_time_us", phase);
+    stats_set (priv->stats, name, elapsed * G_USEC_PER_SEC);
+    g_free (name);
+
+    g_timer_start (timer);
+}
+
+// Does the (potentially slow) GConf and D-Bus set up once hildon-desktop is
+// idle, so the plugin doesn't delay the desktop startup
+static gboolean
+init_deferred (DisplayBlankingStatusPluginPrivate *priv)
+{
+    // the source is removed when returning FALSE
+    priv->init_id = 0;
+
+    GTimer *timer = g_timer_new ();
+
+    init_gconf (priv);
+    log_init_phase (priv, timer, "gconf");
+    init_dbus (priv);
+    log_init_phase (priv, timer, "dbus");
+    init_auto_inhibit (priv);
+    log_init_phase (priv, timer, "auto_inhibit");
+    init_idle_release (priv);
+    log_init_phase (priv, timer, "idle_release");
+    init_recent_timeouts (priv);
+    log_init_phase (priv, timer, "recent_timeouts");
+    init_mode (priv);
+    log_init_phase (priv, timer, "mode");
+    init_display (priv);
+    log_init_phase (priv, timer, "display");
+    init_stats_dbus (priv);
+    log_init_phase (priv, timer, "stats");
+
+    g_timer_destroy (timer);
+
+    gtk_widget_set_sensitive (priv->mode_button, TRUE);
+    gtk_widget_set_sensitive (priv->inhibit_button, TRUE);
+    gtk_widget_set_sensitive (priv->timed_inhibit_button, TRUE);
+    gtk_widget_set_sensitive (priv->brightness_scale, TRUE);
+    gtk_widget_set_sensitive (priv->dim_timeout_scale, TRUE);
+
+    return FALSE;
+}
+
+static void
+display_blanking_status_plugin_dispose (GObject *object)
+{
+    DisplayBlankingStatusPluginPrivate *priv =
+            DISPLAY_BLANKING_STATUS_PLUGIN (object)->priv;
+
+    // might be called more than once
+    if (priv->disposed)
+        goto chain;
+    priv->disposed = TRUE;
+
+    if (priv->init_id != 0)
+        g_source_remove (priv->init_id);
+    if (priv->dialogs_trim_id != 0)
+        g_source_remove (priv->dialogs_trim_id);
+    if (priv->slider_write_id != 0) {
+        g_source_remove (priv->slider_write_id);
+        priv->slider_write_id = 0;
+        commit_pending_changes (priv);
+    }
+    if (priv->gconf_idle_id != 0) {
+        // don't lose the settings that were not saved yet
+        g_source_remove (priv->gconf_idle_id);
+        on_gconf_idle (priv);
+    }
+
+    // they are toplevels, so they are not destroyed with the plugin
+    if (priv->mode_dialog != NULL)
+        gtk_widget_destroy (priv->mode_dialog);
+    if (priv->timed_inhibit_dialog != NULL)
+        gtk_widget_destroy (priv->timed_inhibit_dialog);
+    priv->mode_dialog = priv->timed_inhibit_dialog = NULL;
+
+    if (priv->active_window != NULL) {
+        active_window_free (priv->active_window);
+        priv->active_window = NULL;
+    }
+    if (priv->idle_alarm != NULL) {
+        idle_alarm_free (priv->idle_alarm);
+        priv->idle_alarm = NULL;
+    }
+
+    if (priv->gconf_client != NULL) {
+        for (int i = 0; i < G_N_ELEMENTS (priv->gconf_notify_ids); i++)
+            if (priv->gconf_notify_ids[i] != 0)
+                gconf_client_notify_remove (priv->gconf_client,
+                        priv->gconf_notify_ids[i]);
+        gconf_client_remove_dir (priv->gconf_client, MODE_GCONF_KEY, NULL);
+        gconf_client_remove_dir (priv->gconf_client, BRIGHTNESS_GCONF_KEY,
+                NULL);
+        gconf_client_remove_dir (priv->gconf_client, DIM_TIMEOUT_GCONF_KEY,
+                NULL);
+        gconf_client_remove_dir (priv->gconf_client, SADBA_GCONF_ROOT, NULL);
+    }
+
+    if (priv->session_dbus_conn != NULL) {
+        dbus_connection_remove_filter (priv->session_dbus_conn,
+                (DBusHandleMessageFunction) on_dbus_message, priv);
+        dbus_bus_remove_match (priv->session_dbus_conn,
+                SADBA_STATE_CHANGED_MATCH, NULL);
+        dbus_bus_remove_match (priv->session_dbus_conn, DAEMON_OWNER_MATCH,
+                NULL);
+        // hildon-desktop keeps the connection, so the daemon won't release
+        // them for us. The generations are bumped even without a cookie,
+        // so requests still in flight are undone when their replies arrive.
+        disable_inhibition (priv, &priv->inhibition);
+        disable_inhibition (priv, &priv->auto_inhibition);
+        if (priv->stats_exported)
+            dbus_bus_release_name (priv->session_dbus_conn, STATS_BUS_NAME,
+                    NULL);
+    }
+
+chain:
+    G_OBJECT_CLASS (display_blanking_status_plugin_parent_class)->dispose (
+            object);
+}
+
+static void
+display_blanking_status_plugin_finalize (GObject *object)
+{
+    DisplayBlankingStatusPluginPrivate *priv =
+            DISPLAY_BLANKING_STATUS_PLUGIN (object)->priv;
+
+    for (int i = 0; i < ICONS; i++)
+        if (priv->icons[i] != NULL)
+            g_object_unref (priv->icons[i]);
+    countdown_clear (priv);
+
+    stats_free (priv->stats);
+    g_timer_destroy (priv->dialog_latency.timer);
+    g_timer_destroy (priv->inhibit_latency.timer);
+    g_timer_destroy (priv->mode_latency.timer);
+
+    g_free (priv->active_name);
+    g_free (priv->active_class);
+    g_slist_foreach (priv->auto_inhibit_apps, (GFunc) g_free, NULL);
+    g_slist_free (priv->auto_inhibit_apps);
+
+    if (priv->gconf_client != NULL) {
+        gconf_change_set_unref (priv->pending_changes);
+        g_object_unref (priv->gconf_client);
+    }
+    if (priv->session_dbus_conn != NULL)
+        dbus_connection_unref (priv->session_dbus_conn);
+
+    G_OBJECT_CLASS (display_blanking_status_plugin_parent_class)->finalize (
+            object);
 }
 
 static void
@@ -612,10 +2135,29 @@ display_blanking_status_plugin_init (DisplayBlankingStatusPlugin *plugin)
     plugin->priv = priv;
     priv->plugin = plugin;
 
-    init_gconf (priv);
-    init_dbus (priv);
+    priv->stats = stats_new (NULL, NULL);
+    priv->dialog_latency.timer = g_timer_new ();
+    priv->inhibit_latency.timer = g_timer_new ();
+    priv->mode_latency.timer = g_timer_new ();
+
+    GTimer *timer = g_timer_new ();
+
+    init_icons (priv);
+    log_init_phase (priv, timer, "icons");
     init_mode_gui (priv);
     init_inhibit_gui (priv);
+    init_display_gui (priv);
+    log_init_phase (priv, timer, "gui");
+
+    g_timer_destroy (timer);
+
+    // not usable until init_deferred () is done
+    gtk_widget_set_sensitive (priv->mode_button, FALSE);
+    gtk_widget_set_sensitive (priv->inhibit_button, FALSE);
+    gtk_widget_set_sensitive (priv->timed_inhibit_button, FALSE);
+    gtk_widget_set_sensitive (priv->brightness_scale, FALSE);
+    gtk_widget_set_sensitive (priv->dim_timeout_scale, FALSE);
+    priv->init_id = g_idle_add ((GSourceFunc) init_deferred, priv);
 
     GtkWidget *hbbox = gtk_hbutton_box_new ();
     g_assert (hbbox != NULL);
@@ -624,7 +2166,25 @@ display_blanking_status_plugin_init (DisplayBlankingStatusPlugin *plugin)
     gtk_container_add (GTK_CONTAINER (hbbox), priv->inhibit_button);
     gtk_container_add (GTK_CONTAINER (hbbox), priv->timed_inhibit_button);
 
-    gtk_container_add (GTK_CONTAINER (plugin), hbbox);
+    GtkWidget *display_hbox = gtk_hbox_new (FALSE, HILDON_MARGIN_DEFAULT);
+    g_assert (display_hbox != NULL);
+
+    gtk_box_pack_start (GTK_BOX (display_hbox),
+            gtk_label_new (_ ("Brightness")), FALSE, FALSE, 0);
+    gtk_box_pack_start (GTK_BOX (display_hbox), priv->brightness_scale,
+            TRUE, TRUE, 0);
+    gtk_box_pack_start (GTK_BOX (display_hbox), priv->dim_timeout_label,
+            FALSE, FALSE, 0);
+    gtk_box_pack_start (GTK_BOX (display_hbox), priv->dim_timeout_scale,
+            TRUE, TRUE, 0);
+
+    GtkWidget *vbox = gtk_vbox_new (FALSE, 0);
+    g_assert (vbox != NULL);
+
+    gtk_box_pack_start (GTK_BOX (vbox), hbbox, FALSE, FALSE, 0);
+    gtk_box_pack_start (GTK_BOX (vbox), display_hbox, FALSE, FALSE, 0);
+
+    gtk_container_add (GTK_CONTAINER (plugin), vbox);
 
     gtk_widget_show_all (GTK_WIDGET (plugin));
 }
@@ -0,0 +1,41 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Seconds from an arbitrary point, not affected by system clock changes.
+// The engine deadlines and the remaining times it reports are based on it,
+// the daemon and the plugin use it too to keep track of them. It's inline
+// so the plugin doesn't need the engine objects just for this.
+
+#ifndef MONOTONIC_TIME_H
+#define MONOTONIC_TIME_H
+
+#include <time.h>
+#include <glib.h>
+
+static inline time_t
+monotonic_time (void)
+{
+    struct timespec ts;
+    int r = clock_gettime (CLOCK_MONOTONIC, &ts);
+    g_assert (r == 0);
+    return ts.tv_sec;
+}
+
+#endif // MONOTONIC_TIME_H
@@ -0,0 +1,157 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+#include <stdio.h>
+
+#include "orientation.h"
+
+// the interval is doubled after each sample without motion, and reset
+// to the minimum when the device moves
+#define MIN_INTERVAL 1  // in seconds
+#define MAX_INTERVAL 16 // in seconds
+// while face down the display is let to blank, picking the device up has to
+// be noticed before the user waits on a dark screen
+#define FACE_DOWN_MAX_INTERVAL 2 // in seconds
+#define MOTION_THRESHOLD 150 // in mG, sum of the change in the 3 axes
+
+// gravity is +1000 mG on the z axis when face down, the gap between the
+// thresholds avoids flapping while the device is tilted
+#define FACE_DOWN_Z 700 // in mG
+#define FACE_UP_Z   400 // in mG
+
+struct _Orientation
+{
+    gchar *path;
+    OrientationNotify notify;
+    gpointer notify_data;
+    guint timer_id;
+    guint interval; // in seconds
+    gboolean face_down;
+    gboolean valid; // x, y and z have a sample
+    gint x, y, z;
+    guint samples;
+};
+
+static gboolean
+read_sample (Orientation *orientation, gint *x, gint *y, gint *z)
+{
+    gchar *contents = NULL;
+    GError *error = NULL;
+
+    if (!g_file_get_contents (orientation->path, &contents, NULL, &error)) {
+        g_warning ("Can't read the accelerometer: %s", error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    gboolean ok = sscanf (contents, "%d %d %d", x, y, z) == 3;
+    if (!ok)
+        g_warning ("Invalid accelerometer reading in %s", orientation->path);
+    g_free (contents);
+
+    return ok;
+}
+
+static gboolean on_sample_timeout (Orientation *orientation);
+
+static void
+sample (Orientation *orientation)
+{
+    gint x, y, z;
+    if (!read_sample (orientation, &x, &y, &z)) {
+        // it won't get any better, stay face up
+        orientation->timer_id = 0;
+        return;
+    }
+    orientation->samples++;
+
+    gboolean face_down = orientation->face_down ? z > FACE_UP_Z :
+            z > FACE_DOWN_Z;
+
+    guint motion = ABS (x - orientation->x) + ABS (y - orientation->y)
+            + ABS (z - orientation->z);
+    if (!orientation->valid || motion > MOTION_THRESHOLD)
+        orientation->interval = MIN_INTERVAL;
+    else
+        orientation->interval = MIN (orientation->interval * 2,
+                face_down ? FACE_DOWN_MAX_INTERVAL : MAX_INTERVAL);
+    orientation->valid = TRUE;
+    orientation->x = x;
+    orientation->y = y;
+    orientation->z = z;
+
+    orientation->timer_id = g_timeout_add_seconds (orientation->interval,
+            (GSourceFunc) on_sample_timeout, orientation);
+
+    if (face_down != orientation->face_down) {
+        orientation->face_down = face_down;
+        g_debug ("Device turned face %s", face_down ? "down" : "up");
+        orientation->notify (orientation, face_down,
+                orientation->notify_data);
+    }
+}
+
+static gboolean
+on_sample_timeout (Orientation *orientation)
+{
+    // the source is removed when returning FALSE
+    sample (orientation);
+
+    return FALSE;
+}
+
+Orientation *
+orientation_new (const gchar *path, OrientationNotify notify,
+        gpointer notify_data)
+{
+    Orientation *orientation = g_slice_new0 (Orientation);
+
+    orientation->path = g_strdup (path != NULL ? path :
+            ORIENTATION_SYSFS_PATH);
+    orientation->notify = notify;
+    orientation->notify_data = notify_data;
+    orientation->interval = MIN_INTERVAL;
+
+    sample (orientation);
+
+    return orientation;
+}
+
+void
+orientation_free (Orientation *orientation)
+{
+    if (orientation->timer_id != 0)
+        g_source_remove (orientation->timer_id);
+    g_free (orientation->path);
+
+    g_slice_free (Orientation, orientation);
+}
+
+gboolean
+orientation_is_face_down (Orientation *orientation)
+{
+    return orientation->face_down;
+}
+
+guint
+orientation_get_samples (Orientation *orientation)
+{
+    return orientation->samples;
+}
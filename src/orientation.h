@@ -0,0 +1,51 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Face down detection from the accelerometer, read through its sysfs
+// interface. It's sampled slowly while the device is still, and faster
+// after it moves or while it's face down.
+
+#ifndef ORIENTATION_H
+#define ORIENTATION_H
+
+#include <glib.h>
+
+// N900 (lis302dl) accelerometer, "x y z" in mG
+#define ORIENTATION_SYSFS_PATH "/sys/class/i2c-adapter/i2c-3/3-001d/coord"
+
+typedef struct _Orientation Orientation;
+
+// Called when the device is turned face down or back up
+typedef void (*OrientationNotify) (Orientation *orientation,
+        gboolean face_down, gpointer data);
+
+// Samples path (ORIENTATION_SYSFS_PATH if NULL, any file with the same
+// format can be used instead) until freed. The first sample is taken right
+// away, the device is considered face up before that.
+Orientation *orientation_new (const gchar *path, OrientationNotify notify,
+        gpointer notify_data);
+
+void orientation_free (Orientation *orientation);
+
+gboolean orientation_is_face_down (Orientation *orientation);
+
+guint orientation_get_samples (Orientation *orientation);
+
+#endif // ORIENTATION_H
@@ -0,0 +1,127 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+#include "power.h"
+
+#define BME_REQUEST_PATH    "/com/nokia/bme/request"
+#define BME_REQUEST_IF      "com.nokia.bme.request"
+#define BME_SIGNAL_IF       "com.nokia.bme.signal"
+// makes BME emit the signals with its current state
+#define BME_STATUS_INFO_REQ "status_info_req"
+
+#define BME_CHARGER_CONNECTED     "charger_connected"
+#define BME_CHARGER_DISCONNECTED  "charger_disconnected"
+// (u now, u max) in "bars"
+#define BME_BATTERY_STATE_CHANGED "battery_state_changed"
+
+#define BME_MATCH "type='signal',interface='" BME_SIGNAL_IF "'"
+
+struct _Power
+{
+    DBusConnection *dbus_conn;
+    PowerNotify notify;
+    gpointer notify_data;
+    gboolean charger;
+    gint battery; // in percent, < 0 if unknown
+};
+
+static DBusHandlerResult
+on_dbus_message (DBusConnection *conn, DBusMessage *msg, Power *power)
+{
+    if (dbus_message_get_type (msg) != DBUS_MESSAGE_TYPE_SIGNAL
+            || !dbus_message_has_interface (msg, BME_SIGNAL_IF))
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    gboolean charger = power->charger;
+    gint battery = power->battery;
+    dbus_uint32_t now, max;
+
+    if (dbus_message_has_member (msg, BME_CHARGER_CONNECTED))
+        charger = TRUE;
+    else if (dbus_message_has_member (msg, BME_CHARGER_DISCONNECTED))
+        charger = FALSE;
+    else if (dbus_message_has_member (msg, BME_BATTERY_STATE_CHANGED)
+            && dbus_message_get_args (msg, NULL, DBUS_TYPE_UINT32, &now,
+                DBUS_TYPE_UINT32, &max, DBUS_TYPE_INVALID) && max > 0)
+        battery = MIN (now, max) * 100 / max;
+
+    // BME repeats itself a lot, only changes are reported
+    if (charger != power->charger || battery != power->battery) {
+        power->charger = charger;
+        power->battery = battery;
+        g_debug ("Charger %s, battery at %d%%",
+                charger ? "connected" : "disconnected", battery);
+        power->notify (power, power->notify_data);
+    }
+
+    // other filters might be interested too
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+Power *
+power_new (DBusConnection *dbus_conn, PowerNotify notify, gpointer notify_data)
+{
+    g_assert (dbus_conn != NULL);
+
+    Power *power = g_slice_new (Power);
+
+    power->dbus_conn = dbus_connection_ref (dbus_conn);
+    power->notify = notify;
+    power->notify_data = notify_data;
+    power->charger = FALSE;
+    power->battery = -1;
+
+    dbus_bus_add_match (dbus_conn, BME_MATCH, NULL);
+    dbus_connection_add_filter (dbus_conn,
+            (DBusHandleMessageFunction) on_dbus_message, power, NULL);
+
+    // the answer comes as the regular signals
+    DBusMessage *msg = dbus_message_new_signal (BME_REQUEST_PATH,
+            BME_REQUEST_IF, BME_STATUS_INFO_REQ);
+    g_assert (msg != NULL);
+    if (!dbus_connection_send (dbus_conn, msg, NULL))
+        g_warning ("Can't ask BME for its status");
+    dbus_message_unref (msg);
+
+    return power;
+}
+
+void
+power_free (Power *power)
+{
+    dbus_connection_remove_filter (power->dbus_conn,
+            (DBusHandleMessageFunction) on_dbus_message, power);
+    dbus_bus_remove_match (power->dbus_conn, BME_MATCH, NULL);
+    dbus_connection_unref (power->dbus_conn);
+
+    g_slice_free (Power, power);
+}
+
+gboolean
+power_get_charger (Power *power)
+{
+    return power->charger;
+}
+
+gint
+power_get_battery (Power *power)
+{
+    return power->battery;
+}
@@ -0,0 +1,49 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Power source and battery level tracking, from the BME (battery management
+// entity) signals. Only the signals are used, nothing is sampled.
+
+#ifndef POWER_H
+#define POWER_H
+
+#include <glib.h>
+#include <dbus/dbus.h>
+
+typedef struct _Power Power;
+
+// Called when the charger is connected or disconnected, or the battery
+// level changes
+typedef void (*PowerNotify) (Power *power, gpointer data);
+
+// The connection (to the system bus) must be integrated with the GLib main
+// loop. BME is asked to report its current state, so notify is called soon
+// after (if BME is running).
+Power *power_new (DBusConnection *dbus_conn, PowerNotify notify,
+        gpointer notify_data);
+
+void power_free (Power *power);
+
+gboolean power_get_charger (Power *power);
+
+// In percent, < 0 if still unknown
+gint power_get_battery (Power *power);
+
+#endif // POWER_H
@@ -0,0 +1,109 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Session bus interface of the inhibition daemon (sadbad). States and
+// reasons are sent as the InhibitEngineState and InhibitEngineReason values.
+// Each Inhibit () call gets its own cookie, display blanking is inhibited
+// while any cookie is held, and the cookies of clients that leave the bus
+// are released automatically (unless they are persistent). The state is the
+// aggregate of all clients: MANUAL if any of them inhibits without a
+// timeout, TIMED (up to the latest deadline) otherwise.
+
+#ifndef SADBA_DBUS_H
+#define SADBA_DBUS_H
+
+#define SADBA_SERVICE   "ar.com.llucax.Sadba"
+#define SADBA_PATH      "/ar/com/llucax/Sadba"
+#define SADBA_INTERFACE "ar.com.llucax.Sadba"
+
+// Inhibit (s reason, u timeout) -> (u cookie), timeout in seconds, 0 means
+// until released, reason is a human readable description
+#define SADBA_INHIBIT "Inhibit"
+// InhibitPersistent (s reason, u timeout) -> (u cookie), like Inhibit, but
+// the cookie is kept when the client leaves the bus (so the status menu
+// inhibition survives a desktop restart) and any client can release it
+#define SADBA_INHIBIT_PERSISTENT "InhibitPersistent"
+// Reclaim (s reason) -> (u cookie, u timeout), the newest persistent cookie
+// with that reason (0 if none) and its remaining timeout (0 if held until
+// released), the older ones with the same reason are released, they were
+// left behind by a client that went away while replacing them
+#define SADBA_RECLAIM "Reclaim"
+// Release (u cookie), only the client that got the cookie can release it
+#define SADBA_RELEASE "Release"
+// SetMode (i mode)
+#define SADBA_SET_MODE "SetMode"
+// GetState () -> (u state, u remaining)
+#define SADBA_GET_STATE "GetState"
+// signal StateChanged (u state, u remaining, u reason), while a timed
+// inhibition lasts it's also sent with the KEEPALIVE reason, as the
+// keepalives go by, when the started minutes left change
+#define SADBA_STATE_CHANGED "StateChanged"
+
+#define SADBA_ERROR_FAILED SADBA_INTERFACE ".Error.Failed"
+#define SADBA_ERROR_UNKNOWN_COOKIE SADBA_INTERFACE ".Error.UnknownCookie"
+// Inhibit and InhibitPersistent fail with it while the battery is below the
+// threshold and the charger is not connected
+#define SADBA_ERROR_BATTERY_LOW SADBA_INTERFACE ".Error.BatteryLow"
+
+#define SADBA_STATE_CHANGED_MATCH "type='signal',sender='" SADBA_SERVICE "'," \
+        "interface='" SADBA_INTERFACE "',member='" SADBA_STATE_CHANGED "'"
+
+#define SADBA_INTROSPECTION DBUS_INTROSPECT_1_0_XML_DOCTYPE_DECL_NODE \
+    "<node>\n" \
+    "  <interface name=\"" DBUS_INTERFACE_INTROSPECTABLE "\">\n" \
+    "    <method name=\"Introspect\">\n" \
+    "      <arg name=\"data\" direction=\"out\" type=\"s\"/>\n" \
+    "    </method>\n" \
+    "  </interface>\n" \
+    "  <interface name=\"" SADBA_INTERFACE "\">\n" \
+    "    <method name=\"" SADBA_INHIBIT "\">\n" \
+    "      <arg name=\"reason\" direction=\"in\" type=\"s\"/>\n" \
+    "      <arg name=\"timeout\" direction=\"in\" type=\"u\"/>\n" \
+    "      <arg name=\"cookie\" direction=\"out\" type=\"u\"/>\n" \
+    "    </method>\n" \
+    "    <method name=\"" SADBA_INHIBIT_PERSISTENT "\">\n" \
+    "      <arg name=\"reason\" direction=\"in\" type=\"s\"/>\n" \
+    "      <arg name=\"timeout\" direction=\"in\" type=\"u\"/>\n" \
+    "      <arg name=\"cookie\" direction=\"out\" type=\"u\"/>\n" \
+    "    </method>\n" \
+    "    <method name=\"" SADBA_RECLAIM "\">\n" \
+    "      <arg name=\"reason\" direction=\"in\" type=\"s\"/>\n" \
+    "      <arg name=\"cookie\" direction=\"out\" type=\"u\"/>\n" \
+    "      <arg name=\"timeout\" direction=\"out\" type=\"u\"/>\n" \
+    "    </method>\n" \
+    "    <method name=\"" SADBA_RELEASE "\">\n" \
+    "      <arg name=\"cookie\" direction=\"in\" type=\"u\"/>\n" \
+    "    </method>\n" \
+    "    <method name=\"" SADBA_SET_MODE "\">\n" \
+    "      <arg name=\"mode\" direction=\"in\" type=\"i\"/>\n" \
+    "    </method>\n" \
+    "    <method name=\"" SADBA_GET_STATE "\">\n" \
+    "      <arg name=\"state\" direction=\"out\" type=\"u\"/>\n" \
+    "      <arg name=\"remaining\" direction=\"out\" type=\"u\"/>\n" \
+    "    </method>\n" \
+    "    <signal name=\"" SADBA_STATE_CHANGED "\">\n" \
+    "      <arg name=\"state\" type=\"u\"/>\n" \
+    "      <arg name=\"remaining\" type=\"u\"/>\n" \
+    "      <arg name=\"reason\" type=\"u\"/>\n" \
+    "    </signal>\n" \
+    "  </interface>\n" \
+    "</node>\n"
+
+#endif // SADBA_DBUS_H
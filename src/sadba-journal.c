@@ -0,0 +1,154 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Summarizes the inhibition journal written by sadbad, one line per day
+// with the estimated energy used by the display while it was kept on.
+// Sessions are accounted to the day they started. Sessions can overlap (an
+// inhibition while the mode never blanks), the time already covered by
+// earlier sessions is counted once, and their display time and keepalives
+// are reduced in the same proportion.
+
+#define _POSIX_C_SOURCE 200112L // for localtime_r ()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <glib.h>
+
+#include "journal.h"
+
+// N900 display at the default brightness, roughly
+#define DEFAULT_DISPLAY_POWER 400 // in mW
+
+typedef struct
+{
+    gchar date[11]; // YYYY-MM-DD
+    guint sessions[JOURNAL_TRIGGER_MODE + 1];
+    guint unfinished;
+    guint64 duration; // in seconds
+    guint64 display_on; // in seconds
+    guint64 keepalives;
+} Day;
+
+typedef struct
+{
+    GArray *days;
+    gint64 covered; // end of the time covered by the sessions so far
+} Summary;
+
+static void
+add_record (const JournalRecord *record, Summary *summary)
+{
+    GArray *days = summary->days;
+    time_t start = record->start;
+    struct tm tm;
+    gchar date[sizeof (((Day *) NULL)->date)];
+    strftime (date, sizeof (date), "%Y-%m-%d", localtime_r (&start, &tm));
+
+    // the records are in chronological order
+    Day *day = NULL;
+    if (days->len > 0)
+        day = &g_array_index (days, Day, days->len - 1);
+    if (day == NULL || strcmp (day->date, date) != 0) {
+        g_array_set_size (days, days->len + 1);
+        day = &g_array_index (days, Day, days->len - 1);
+        memcpy (day->date, date, sizeof (date));
+    }
+
+    if (record->trigger <= JOURNAL_TRIGGER_MODE)
+        day->sessions[record->trigger]++;
+    if (record->end == 0) {
+        day->unfinished++; // still going on, or sadbad crashed
+        return;
+    }
+    if (record->end <= record->start)
+        return;
+
+    // the records are appended when the sessions start, so only the
+    // beginning of a session can overlap the previous ones
+    gint64 from = MAX (record->start, summary->covered);
+    if (from >= record->end)
+        return;
+    gdouble share = (gdouble) (record->end - from)
+            / (record->end - record->start);
+    summary->covered = record->end;
+
+    day->duration += record->end - from;
+    day->display_on += record->display_on * share + 0.5;
+    day->keepalives += record->keepalives * share + 0.5;
+}
+
+int
+main (int argc, char *argv[])
+{
+    gint power = DEFAULT_DISPLAY_POWER;
+    GOptionEntry entries[] =
+    {
+        { "display-power", 'p', 0, G_OPTION_ARG_INT, &power,
+            "Display power while on, in mW", "MW" },
+        { NULL }
+    };
+
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new ("[JOURNAL]");
+    g_option_context_set_summary (context,
+            "Summarizes the display blanking inhibition journal per day.");
+    g_option_context_add_main_entries (context, entries, NULL);
+    gboolean ok = g_option_context_parse (context, &argc, &argv, &error);
+    g_option_context_free (context);
+    if (!ok || argc > 2) {
+        fprintf (stderr, "%s\n", ok ? "Too many arguments" : error->message);
+        if (error != NULL)
+            g_error_free (error);
+        return EXIT_FAILURE;
+    }
+
+    gchar *path = argc > 1 ? g_strdup (argv[1]) : journal_default_path ();
+    Journal *journal = journal_open (path, FALSE, &error);
+    g_free (path);
+    if (journal == NULL) {
+        fprintf (stderr, "%s\n", error->message);
+        g_error_free (error);
+        return EXIT_FAILURE;
+    }
+
+    Summary summary = { g_array_new (FALSE, TRUE, sizeof (Day)), 0 };
+    journal_foreach (journal, (JournalFunc) add_record, &summary);
+    journal_close (journal);
+    GArray *days = summary.days;
+
+    printf ("%-10s %6s %5s %4s %4s %9s %9s %10s %9s\n", "date", "manual",
+            "timed", "mode", "open", "inhibit_s", "display_s", "keepalives",
+            "energy_mWh");
+    for (guint i = 0; i < days->len; i++) {
+        Day *day = &g_array_index (days, Day, i);
+        printf ("%-10s %6u %5u %4u %4u %9" G_GUINT64_FORMAT " %9"
+                G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT " %9.1f\n",
+                day->date, day->sessions[JOURNAL_TRIGGER_MANUAL],
+                day->sessions[JOURNAL_TRIGGER_TIMED],
+                day->sessions[JOURNAL_TRIGGER_MODE], day->unfinished,
+                day->duration, day->display_on, day->keepalives,
+                day->display_on * power / 3600.0);
+    }
+    g_array_free (days, TRUE);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,900 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Headless daemon owning the display blanking inhibition. It runs the
+// inhibition engine and serves the SADBA_INTERFACE on the session bus, so
+// the status menu plugin only has to render the state and forward requests.
+// It's started on demand by D-Bus activation.
+
+#define _POSIX_C_SOURCE 199309L // for clock_gettime ()
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <glib.h>
+#include <gconf/gconf-client.h>
+#include <dbus/dbus.h>
+#include <dbus/dbus-glib-lowlevel.h>
+
+#include "inhibit-engine.h"
+#include "journal.h"
+#include "monotonic-time.h"
+#include "orientation.h"
+#include "power.h"
+#include "sadba-dbus.h"
+#include "schedule.h"
+#include "stats.h"
+
+// power policy, inhibit while the charger is connected (if TRUE) and
+// cancel all inhibitions when the battery gets below the threshold (in
+// percent, 0 disables it) and the charger is not connected, new ones are
+// refused until it's connected or the battery is above the threshold
+#define CHARGER_GCONF_KEY   "/apps/Maemo/sadba/inhibit_on_charger"
+#define THRESHOLD_GCONF_KEY "/apps/Maemo/sadba/battery_threshold"
+#define CHARGER_REASON      "Charger connected"
+
+// inhibitions are suspended while the device is face down (if TRUE), the
+// accelerometer is only sampled while inhibiting
+#define UPRIGHT_GCONF_KEY "/apps/Maemo/sadba/inhibit_only_upright"
+// file to read the accelerometer from instead of the sysfs one, useful for
+// testing
+#define ACCELEROMETER_ENV "SADBA_ACCELEROMETER"
+
+// blanking modes that never blank the display, see mode_desc in the plugin
+#define MODE_BOTH_DISABLED 3
+#define MODE_ONLY_DIMMING  4
+
+#define OWNER_MATCH "type='signal',sender='" DBUS_SERVICE_DBUS "'," \
+        "interface='" DBUS_INTERFACE_DBUS "',member='NameOwnerChanged'," \
+        "arg0='%s'"
+
+// A journal record being written
+typedef struct
+{
+    gboolean active; // there is a session going on
+    JournalRef ref; // its record, which can be overwritten meanwhile
+    // engine totals when the session started
+    guint keepalives;
+    guint64 display_on_time;
+} JournalSession;
+
+// An Inhibit () call
+typedef struct
+{
+    guint cookie;
+    gchar *owner; // unique bus name of the caller, NULL for our own
+    gchar *reason;
+    time_t deadline; // monotonic, 0 if held until released
+    // not owned by the caller, so it's kept when it leaves the bus and any
+    // client can release it
+    gboolean persistent;
+} Client;
+
+typedef struct
+{
+    GMainLoop *loop;
+    GConfClient *gconf_client;
+    DBusConnection *dbus_conn; // system bus, to talk to MCE
+    DBusConnection *session_dbus_conn; // where we serve our clients
+    InhibitEngine *engine;
+    Schedule *schedule;
+    Stats *stats;
+    GHashTable *clients; // cookie -> Client *
+    GHashTable *owners;  // unique bus name -> number of clients it has
+    guint last_cookie;
+    Power *power;
+    guint charger_cookie; // our own client while charging, 0 if none
+    gboolean battery_low;
+    Orientation *orientation; // NULL if not sampling
+    guint orientation_samples; // taken by the previous ones
+    Journal *journal; // NULL if it can't be written
+    JournalSession inhibit_session; // while the engine inhibits
+    JournalSession mode_session; // while the mode never blanks
+    guint signalled_minutes; // started ones left in the last StateChanged
+} Daemon;
+
+static void
+client_free (Client *client)
+{
+    g_free (client->owner);
+    g_free (client->reason);
+    g_slice_free (Client, client);
+}
+
+// Owners are watched so their clients are released if they leave the bus
+static void
+watch_owner (Daemon *daemon, const gchar *owner)
+{
+    if (owner == NULL)
+        return;
+
+    guint n = GPOINTER_TO_UINT (g_hash_table_lookup (daemon->owners, owner));
+
+    if (n == 0) {
+        gchar *rule = g_strdup_printf (OWNER_MATCH, owner);
+        dbus_bus_add_match (daemon->session_dbus_conn, rule, NULL);
+        g_free (rule);
+    }
+    g_hash_table_insert (daemon->owners, g_strdup (owner),
+            GUINT_TO_POINTER (n + 1));
+}
+
+static void
+unwatch_owner (Daemon *daemon, const gchar *owner)
+{
+    if (owner == NULL)
+        return;
+
+    guint n = GPOINTER_TO_UINT (g_hash_table_lookup (daemon->owners, owner));
+    g_assert (n > 0);
+
+    if (n > 1) {
+        g_hash_table_insert (daemon->owners, g_strdup (owner),
+                GUINT_TO_POINTER (n - 1));
+        return;
+    }
+
+    g_hash_table_remove (daemon->owners, owner);
+    gchar *rule = g_strdup_printf (OWNER_MATCH, owner);
+    dbus_bus_remove_match (daemon->session_dbus_conn, rule, NULL);
+    g_free (rule);
+}
+
+// Drives the engine from the aggregate of all the clients, reason is
+// reported if this ends the inhibition
+static void
+apply_clients (Daemon *daemon, InhibitEngineReason reason)
+{
+    time_t now = monotonic_time ();
+    gboolean manual = FALSE;
+    time_t deadline = 0;
+
+    GHashTableIter i;
+    gpointer cookie;
+    Client *client;
+    g_hash_table_iter_init (&i, daemon->clients);
+    while (g_hash_table_iter_next (&i, &cookie, (gpointer *) &client)) {
+        if (client->deadline == 0)
+            manual = TRUE;
+        else if (client->deadline <= now) {
+            g_debug ("Inhibition %u (%s) expired", client->cookie,
+                    client->reason);
+            unwatch_owner (daemon, client->owner);
+            g_hash_table_iter_remove (&i);
+        }
+        else
+            deadline = MAX (deadline, client->deadline);
+    }
+
+    InhibitEngineState state = inhibit_engine_get_state (daemon->engine);
+    if (manual) {
+        if (state != INHIBIT_ENGINE_MANUAL)
+            inhibit_engine_inhibit (daemon->engine, 0);
+    }
+    else if (deadline != 0) {
+        guint timeout = deadline - now;
+        if (state != INHIBIT_ENGINE_TIMED
+                || inhibit_engine_get_remaining (daemon->engine) != timeout)
+            inhibit_engine_inhibit (daemon->engine, timeout);
+    }
+    else if (state != INHIBIT_ENGINE_OFF)
+        inhibit_engine_release (daemon->engine, reason, NULL);
+}
+
+// owner is NULL for our own clients
+static Client *
+add_client (Daemon *daemon, const gchar *owner, const gchar *reason,
+        guint timeout, gboolean persistent)
+{
+    Client *client = g_slice_new (Client);
+
+    // 0 is never used, so clients can use it as "no cookie"
+    do
+        client->cookie = ++daemon->last_cookie;
+    while (client->cookie == 0
+            || g_hash_table_lookup (daemon->clients,
+                GUINT_TO_POINTER (client->cookie)) != NULL);
+    client->owner = persistent ? NULL : g_strdup (owner);
+    client->reason = g_strdup (reason);
+    client->deadline = timeout ? monotonic_time () + timeout : 0;
+    client->persistent = persistent;
+    g_hash_table_insert (daemon->clients, GUINT_TO_POINTER (client->cookie),
+            client);
+    watch_owner (daemon, client->owner);
+    g_debug ("%s inhibition %u requested by %s (%s) for %us",
+            persistent ? "Persistent" : "Owned", client->cookie,
+            owner != NULL ? owner : "us", client->reason, timeout);
+
+    return client;
+}
+
+static void
+remove_client (Daemon *daemon, guint cookie)
+{
+    Client *client = g_hash_table_lookup (daemon->clients,
+            GUINT_TO_POINTER (cookie));
+    g_assert (client != NULL);
+
+    unwatch_owner (daemon, client->owner);
+    g_hash_table_remove (daemon->clients, GUINT_TO_POINTER (cookie));
+}
+
+typedef enum
+{
+    CLIENTS_OF_OWNER,
+    CLIENTS_TIMED,
+    CLIENTS_ALL
+} ClientsFilter;
+
+static void
+remove_clients (Daemon *daemon, ClientsFilter filter, const gchar *owner)
+{
+    GHashTableIter i;
+    gpointer cookie;
+    Client *client;
+    g_hash_table_iter_init (&i, daemon->clients);
+    while (g_hash_table_iter_next (&i, &cookie, (gpointer *) &client)) {
+        if ((filter == CLIENTS_OF_OWNER
+                    && g_strcmp0 (client->owner, owner) == 0)
+                || (filter == CLIENTS_TIMED && client->deadline != 0)
+                || filter == CLIENTS_ALL) {
+            if (client->cookie == daemon->charger_cookie)
+                daemon->charger_cookie = 0;
+            unwatch_owner (daemon, client->owner);
+            g_hash_table_iter_remove (&i);
+        }
+    }
+}
+
+static void
+emit_state_changed (Daemon *daemon, InhibitEngineState state,
+        InhibitEngineReason reason)
+{
+    dbus_uint32_t s = state;
+    dbus_uint32_t remaining = inhibit_engine_get_remaining (daemon->engine);
+    dbus_uint32_t r = reason;
+    daemon->signalled_minutes = (remaining + 59) / 60;
+
+    DBusMessage *msg = dbus_message_new_signal (SADBA_PATH, SADBA_INTERFACE,
+            SADBA_STATE_CHANGED);
+    g_assert (msg != NULL);
+    dbus_message_append_args (msg, DBUS_TYPE_UINT32, &s,
+            DBUS_TYPE_UINT32, &remaining, DBUS_TYPE_UINT32, &r,
+            DBUS_TYPE_INVALID);
+    if (!dbus_connection_send (daemon->session_dbus_conn, msg, NULL))
+        g_warning ("Can't send the %s signal", SADBA_STATE_CHANGED);
+    dbus_message_unref (msg);
+}
+
+static void
+on_orientation_notify (Orientation *orientation, gboolean face_down,
+        Daemon *daemon)
+{
+    // face down the blank pause is cancelled too, so the display dims and
+    // blanks after the regular MCE timeouts (on an MCE that ignores the
+    // cancel, up to 60 seconds later). It's picked up again within a
+    // couple of seconds.
+    g_message ("Device face %s, inhibition %s", face_down ? "down" : "up",
+            face_down ? "suspended" : "resumed");
+    inhibit_engine_suspend (daemon->engine, face_down);
+}
+
+static void
+update_orientation (Daemon *daemon)
+{
+    gboolean needed = inhibit_engine_get_state (daemon->engine)
+            != INHIBIT_ENGINE_OFF && gconf_client_get_bool (
+                daemon->gconf_client, UPRIGHT_GCONF_KEY, NULL);
+
+    if (needed && daemon->orientation == NULL)
+        daemon->orientation = orientation_new (g_getenv (ACCELEROMETER_ENV),
+                (OrientationNotify) on_orientation_notify, daemon);
+    else if (!needed && daemon->orientation != NULL) {
+        daemon->orientation_samples += orientation_get_samples (
+                daemon->orientation);
+        orientation_free (daemon->orientation);
+        daemon->orientation = NULL;
+        inhibit_engine_suspend (daemon->engine, FALSE);
+    }
+}
+
+static void
+on_orientation_gconf_notify (GConfClient *client, guint cnxn_id,
+        GConfEntry *entry, Daemon *daemon)
+{
+    update_orientation (daemon);
+}
+
+static void
+init_orientation (Daemon *daemon)
+{
+    // watching the key makes the client cache it
+    gconf_client_add_dir (daemon->gconf_client, UPRIGHT_GCONF_KEY,
+            GCONF_CLIENT_PRELOAD_NONE, NULL);
+    gconf_client_notify_add (daemon->gconf_client, UPRIGHT_GCONF_KEY,
+            (GConfClientNotifyFunc) on_orientation_gconf_notify, daemon,
+            NULL, NULL);
+}
+
+static void
+journal_session_start (Daemon *daemon, JournalSession *session,
+        JournalTrigger trigger)
+{
+    InhibitEngineStats s;
+    inhibit_engine_get_stats (daemon->engine, &s);
+
+    JournalRecord *record = journal_append (daemon->journal, &session->ref);
+    record->start = time (NULL);
+    record->trigger = trigger;
+    session->active = TRUE;
+    session->keepalives = s.keepalives_sent;
+    session->display_on_time = s.display_on_time;
+}
+
+static void
+journal_session_end (Daemon *daemon, JournalSession *session)
+{
+    InhibitEngineStats s;
+    inhibit_engine_get_stats (daemon->engine, &s);
+
+    session->active = FALSE;
+    // a long session might outlive its record, if JOURNAL_CAPACITY shorter
+    // ones were recorded meanwhile
+    JournalRecord *record = journal_get (daemon->journal, &session->ref);
+    if (record == NULL)
+        return;
+
+    record->end = time (NULL);
+    record->keepalives = s.keepalives_sent - session->keepalives;
+    record->display_on = s.display_on_time - session->display_on_time;
+}
+
+// Starts or ends the journal sessions as needed, all of them are ended if
+// finish is TRUE
+static void
+update_journal (Daemon *daemon, gboolean finish)
+{
+    if (daemon->journal == NULL)
+        return;
+
+    InhibitEngineState state = inhibit_engine_get_state (daemon->engine);
+    gboolean inhibiting = !finish && state != INHIBIT_ENGINE_OFF;
+    if (inhibiting && !daemon->inhibit_session.active)
+        journal_session_start (daemon, &daemon->inhibit_session,
+                state == INHIBIT_ENGINE_TIMED ? JOURNAL_TRIGGER_TIMED :
+                    JOURNAL_TRIGGER_MANUAL);
+    else if (!inhibiting && daemon->inhibit_session.active)
+        journal_session_end (daemon, &daemon->inhibit_session);
+
+    gint mode = gconf_client_get_int (daemon->gconf_client, MODE_GCONF_KEY,
+            NULL);
+    gboolean never_blanks = !finish && (mode == MODE_BOTH_DISABLED
+            || mode == MODE_ONLY_DIMMING);
+    if (never_blanks && !daemon->mode_session.active)
+        journal_session_start (daemon, &daemon->mode_session,
+                JOURNAL_TRIGGER_MODE);
+    else if (!never_blanks && daemon->mode_session.active)
+        journal_session_end (daemon, &daemon->mode_session);
+}
+
+static void
+on_mode_gconf_notify (GConfClient *client, guint cnxn_id, GConfEntry *entry,
+        Daemon *daemon)
+{
+    update_journal (daemon, FALSE);
+}
+
+static void
+init_journal (Daemon *daemon)
+{
+    GError *error = NULL;
+    gchar *path = journal_default_path ();
+
+    // the journal is not essential
+    daemon->journal = journal_open (path, TRUE, &error);
+    g_free (path);
+    if (daemon->journal == NULL) {
+        g_warning ("%s", error->message);
+        g_error_free (error);
+        return;
+    }
+
+    // watching the key makes the client cache it
+    gconf_client_add_dir (daemon->gconf_client, MODE_GCONF_KEY,
+            GCONF_CLIENT_PRELOAD_NONE, NULL);
+    gconf_client_notify_add (daemon->gconf_client, MODE_GCONF_KEY,
+            (GConfClientNotifyFunc) on_mode_gconf_notify, daemon, NULL,
+            NULL);
+    update_journal (daemon, FALSE);
+}
+
+static void
+on_inhibit_engine_notify (InhibitEngine *engine, InhibitEngineState state,
+        InhibitEngineReason reason, Daemon *daemon)
+{
+    // the plugin countdown shows the started minutes, it only needs the
+    // keepalives that change them, and redraws without timers of its own
+    if (reason == INHIBIT_ENGINE_REASON_KEEPALIVE) {
+        guint remaining = inhibit_engine_get_remaining (engine);
+        if ((remaining + 59) / 60 != daemon->signalled_minutes)
+            emit_state_changed (daemon, state, reason);
+        return;
+    }
+
+    // the latest deadline was reached, so all the timed clients are done
+    // (there are no manual ones or the engine wouldn't have a deadline)
+    if (reason == INHIBIT_ENGINE_REASON_TIMEOUT)
+        remove_clients (daemon, CLIENTS_TIMED, NULL);
+
+    update_orientation (daemon);
+    update_journal (daemon, FALSE);
+    emit_state_changed (daemon, state, reason);
+}
+
+static void
+on_schedule_notify (Schedule *schedule, gint mode, Daemon *daemon)
+{
+    GError *error = NULL;
+
+    // the plugin picks the change up from its GConf notification
+    g_debug ("Scheduled display blanking mode %d", mode);
+    if (!inhibit_engine_set_mode (daemon->engine, mode, &error)) {
+        g_warning ("%s", error->message);
+        g_error_free (error);
+    }
+}
+
+static void
+apply_power_policy (Daemon *daemon)
+{
+    gboolean charger = power_get_charger (daemon->power);
+    gint battery = power_get_battery (daemon->power);
+
+    gboolean on_charger = charger && gconf_client_get_bool (
+            daemon->gconf_client, CHARGER_GCONF_KEY, NULL);
+    if (on_charger && daemon->charger_cookie == 0) {
+        daemon->charger_cookie = add_client (daemon, NULL, CHARGER_REASON,
+                0, FALSE)->cookie;
+        apply_clients (daemon, INHIBIT_ENGINE_REASON_REQUEST);
+    }
+    else if (!on_charger && daemon->charger_cookie != 0) {
+        remove_client (daemon, daemon->charger_cookie);
+        daemon->charger_cookie = 0;
+        apply_clients (daemon, INHIBIT_ENGINE_REASON_REQUEST);
+    }
+
+    // crossing the threshold cancels everything, and while the battery
+    // stays low new inhibitions are refused (see handle_inhibit ())
+    gint threshold = gconf_client_get_int (daemon->gconf_client,
+            THRESHOLD_GCONF_KEY, NULL);
+    gboolean low = !charger && battery >= 0 && battery < threshold;
+    if (low && !daemon->battery_low
+            && g_hash_table_size (daemon->clients) > 0) {
+        g_message ("Battery at %d%%, cancelling all inhibitions", battery);
+        remove_clients (daemon, CLIENTS_ALL, NULL);
+        apply_clients (daemon, INHIBIT_ENGINE_REASON_BATTERY_LOW);
+    }
+    daemon->battery_low = low;
+}
+
+static void
+on_power_notify (Power *power, Daemon *daemon)
+{
+    apply_power_policy (daemon);
+}
+
+static void
+on_power_gconf_notify (GConfClient *client, guint cnxn_id, GConfEntry *entry,
+        Daemon *daemon)
+{
+    apply_power_policy (daemon);
+}
+
+static void
+init_power_policy (Daemon *daemon)
+{
+    // watching the keys makes the client cache them
+    gconf_client_add_dir (daemon->gconf_client, CHARGER_GCONF_KEY,
+            GCONF_CLIENT_PRELOAD_NONE, NULL);
+    gconf_client_add_dir (daemon->gconf_client, THRESHOLD_GCONF_KEY,
+            GCONF_CLIENT_PRELOAD_NONE, NULL);
+    gconf_client_notify_add (daemon->gconf_client, CHARGER_GCONF_KEY,
+            (GConfClientNotifyFunc) on_power_gconf_notify, daemon, NULL,
+            NULL);
+    gconf_client_notify_add (daemon->gconf_client, THRESHOLD_GCONF_KEY,
+            (GConfClientNotifyFunc) on_power_gconf_notify, daemon, NULL,
+            NULL);
+
+    daemon->power = power_new (daemon->dbus_conn,
+            (PowerNotify) on_power_notify, daemon);
+}
+
+static DBusMessage *
+error_reply (DBusMessage *msg, GError *error)
+{
+    DBusMessage *reply = dbus_message_new_error (msg, SADBA_ERROR_FAILED,
+            error->message);
+    g_error_free (error);
+    return reply;
+}
+
+static DBusMessage *
+handle_inhibit (Daemon *daemon, DBusMessage *msg, gboolean persistent)
+{
+    const gchar *reason;
+    dbus_uint32_t timeout;
+
+    if (!dbus_message_get_args (msg, NULL, DBUS_TYPE_STRING, &reason,
+                DBUS_TYPE_UINT32, &timeout, DBUS_TYPE_INVALID))
+        return dbus_message_new_error (msg, DBUS_ERROR_INVALID_ARGS,
+                "Expected a reason and a timeout");
+    if (daemon->battery_low)
+        return dbus_message_new_error_printf (msg, SADBA_ERROR_BATTERY_LOW,
+                "Battery at %d%%, display blanking can't be inhibited",
+                power_get_battery (daemon->power));
+
+    Client *client = add_client (daemon, dbus_message_get_sender (msg),
+            reason, timeout, persistent);
+    apply_clients (daemon, INHIBIT_ENGINE_REASON_REQUEST);
+
+    dbus_uint32_t cookie = client->cookie;
+    DBusMessage *reply = dbus_message_new_method_return (msg);
+    dbus_message_append_args (reply, DBUS_TYPE_UINT32, &cookie,
+            DBUS_TYPE_INVALID);
+
+    return reply;
+}
+
+static DBusMessage *
+handle_reclaim (Daemon *daemon, DBusMessage *msg)
+{
+    const gchar *reason;
+
+    if (!dbus_message_get_args (msg, NULL, DBUS_TYPE_STRING, &reason,
+                DBUS_TYPE_INVALID))
+        return dbus_message_new_error (msg, DBUS_ERROR_INVALID_ARGS,
+                "Expected a reason");
+
+    // cookies only wrap after 2^32 requests, so the newest is the highest
+    Client *newest = NULL;
+    GHashTableIter i;
+    gpointer cookie;
+    Client *client;
+    g_hash_table_iter_init (&i, daemon->clients);
+    while (g_hash_table_iter_next (&i, &cookie, (gpointer *) &client))
+        if (client->persistent && strcmp (client->reason, reason) == 0
+                && (newest == NULL || client->cookie > newest->cookie))
+            newest = client;
+
+    dbus_uint32_t c = 0, timeout = 0;
+    if (newest != NULL) {
+        c = newest->cookie;
+        if (newest->deadline != 0)
+            timeout = MAX (newest->deadline
+                    - monotonic_time (), 1);
+
+        g_hash_table_iter_init (&i, daemon->clients);
+        while (g_hash_table_iter_next (&i, &cookie, (gpointer *) &client))
+            if (client->persistent && client != newest
+                    && strcmp (client->reason, reason) == 0) {
+                g_debug ("Inhibition %u (%s) superseded by %u",
+                        client->cookie, client->reason, c);
+                g_hash_table_iter_remove (&i);
+            }
+        apply_clients (daemon, INHIBIT_ENGINE_REASON_REQUEST);
+        g_debug ("Inhibition %u reclaimed by %s", c,
+                dbus_message_get_sender (msg));
+    }
+
+    DBusMessage *reply = dbus_message_new_method_return (msg);
+    dbus_message_append_args (reply, DBUS_TYPE_UINT32, &c,
+            DBUS_TYPE_UINT32, &timeout, DBUS_TYPE_INVALID);
+
+    return reply;
+}
+
+static DBusMessage *
+handle_release (Daemon *daemon, DBusMessage *msg)
+{
+    dbus_uint32_t cookie;
+
+    if (!dbus_message_get_args (msg, NULL, DBUS_TYPE_UINT32, &cookie,
+                DBUS_TYPE_INVALID))
+        return dbus_message_new_error (msg, DBUS_ERROR_INVALID_ARGS,
+                "Expected a cookie");
+
+    Client *client = g_hash_table_lookup (daemon->clients,
+            GUINT_TO_POINTER (cookie));
+    if (client == NULL || (!client->persistent && g_strcmp0 (client->owner,
+                    dbus_message_get_sender (msg)) != 0))
+        return dbus_message_new_error_printf (msg,
+                SADBA_ERROR_UNKNOWN_COOKIE, "Unknown inhibition cookie %u",
+                cookie);
+
+    remove_client (daemon, cookie);
+    apply_clients (daemon, INHIBIT_ENGINE_REASON_REQUEST);
+
+    return dbus_message_new_method_return (msg);
+}
+
+static DBusMessage *
+handle_set_mode (Daemon *daemon, DBusMessage *msg)
+{
+    dbus_int32_t mode;
+    GError *error = NULL;
+
+    if (!dbus_message_get_args (msg, NULL, DBUS_TYPE_INT32, &mode,
+                DBUS_TYPE_INVALID))
+        return dbus_message_new_error (msg, DBUS_ERROR_INVALID_ARGS,
+                "Expected a mode");
+
+    if (!inhibit_engine_set_mode (daemon->engine, mode, &error))
+        return error_reply (msg, error);
+
+    return dbus_message_new_method_return (msg);
+}
+
+static DBusMessage *
+handle_get_state (Daemon *daemon, DBusMessage *msg)
+{
+    dbus_uint32_t state = inhibit_engine_get_state (daemon->engine);
+    dbus_uint32_t remaining = inhibit_engine_get_remaining (daemon->engine);
+
+    DBusMessage *reply = dbus_message_new_method_return (msg);
+    dbus_message_append_args (reply, DBUS_TYPE_UINT32, &state,
+            DBUS_TYPE_UINT32, &remaining, DBUS_TYPE_INVALID);
+
+    return reply;
+}
+
+static DBusHandlerResult
+on_sadba_message (DBusConnection *conn, DBusMessage *msg, Daemon *daemon)
+{
+    DBusMessage *reply = NULL;
+
+    if (dbus_message_is_method_call (msg, DBUS_INTERFACE_INTROSPECTABLE,
+                "Introspect")) {
+        const gchar *xml = SADBA_INTROSPECTION;
+        reply = dbus_message_new_method_return (msg);
+        dbus_message_append_args (reply, DBUS_TYPE_STRING, &xml,
+                DBUS_TYPE_INVALID);
+    }
+    else if (dbus_message_is_method_call (msg, SADBA_INTERFACE, SADBA_INHIBIT))
+        reply = handle_inhibit (daemon, msg, FALSE);
+    else if (dbus_message_is_method_call (msg, SADBA_INTERFACE,
+                SADBA_INHIBIT_PERSISTENT))
+        reply = handle_inhibit (daemon, msg, TRUE);
+    else if (dbus_message_is_method_call (msg, SADBA_INTERFACE, SADBA_RECLAIM))
+        reply = handle_reclaim (daemon, msg);
+    else if (dbus_message_is_method_call (msg, SADBA_INTERFACE, SADBA_RELEASE))
+        reply = handle_release (daemon, msg);
+    else if (dbus_message_is_method_call (msg, SADBA_INTERFACE,
+                SADBA_SET_MODE))
+        reply = handle_set_mode (daemon, msg);
+    else if (dbus_message_is_method_call (msg, SADBA_INTERFACE,
+                SADBA_GET_STATE))
+        reply = handle_get_state (daemon, msg);
+    else
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    if (!dbus_message_get_no_reply (msg)
+            && !dbus_connection_send (conn, reply, NULL))
+        g_warning ("Can't send the reply to %s",
+                dbus_message_get_member (msg));
+    dbus_message_unref (reply);
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static void
+on_stats_update (Stats *stats, Daemon *daemon)
+{
+    InhibitEngineStats s;
+    inhibit_engine_get_stats (daemon->engine, &s);
+
+    stats_set (stats, "clients", g_hash_table_size (daemon->clients));
+    stats_set (stats, "client_owners", g_hash_table_size (daemon->owners));
+    stats_set (stats, "keepalives_sent", s.keepalives_sent);
+    stats_set (stats, "wakeups", s.wakeups);
+    stats_set (stats, "wakeups_saved", s.wakeups_saved);
+    stats_set (stats, "mode_changes", s.mode_changes);
+    stats_set (stats, "inhibited_time_s", s.inhibited_time);
+    stats_set (stats, "current_inhibited_time_s", s.current_inhibited_time);
+    stats_set (stats, "keepalive_latency_us", s.last_latency);
+    stats_set (stats, "max_keepalive_latency_us", s.max_latency);
+    stats_set (stats, "display_on_time_s", s.display_on_time);
+    stats_set (stats, "mce_restarts", s.mce_restarts);
+    stats_set (stats, "keepalive_interval_s", s.keepalive_interval);
+    stats_set (stats, "orientation_samples", daemon->orientation_samples
+            + (daemon->orientation != NULL ?
+                orientation_get_samples (daemon->orientation) : 0));
+}
+
+static void
+on_name_owner_changed (Daemon *daemon, DBusMessage *msg)
+{
+    const gchar *name, *old_owner, *new_owner;
+
+    if (!dbus_message_get_args (msg, NULL, DBUS_TYPE_STRING, &name,
+                DBUS_TYPE_STRING, &old_owner, DBUS_TYPE_STRING, &new_owner,
+                DBUS_TYPE_INVALID))
+        return;
+
+    if (*new_owner != '\0'
+            || g_hash_table_lookup (daemon->owners, name) == NULL)
+        return;
+
+    g_debug ("%s left the bus, releasing its inhibitions", name);
+    remove_clients (daemon, CLIENTS_OF_OWNER, name);
+    apply_clients (daemon, INHIBIT_ENGINE_REASON_REQUEST);
+}
+
+static DBusHandlerResult
+on_bus_message (DBusConnection *conn, DBusMessage *msg, Daemon *daemon)
+{
+    if (dbus_message_is_signal (msg, DBUS_INTERFACE_DBUS,
+                "NameOwnerChanged")) {
+        on_name_owner_changed (daemon, msg);
+        // other filters might be interested too
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
+    if (!dbus_message_is_signal (msg, DBUS_INTERFACE_LOCAL, "Disconnected"))
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    g_message ("Disconnected from the bus, exiting");
+    g_main_loop_quit (daemon->loop);
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static DBusConnection *
+get_bus (Daemon *daemon, DBusBusType type)
+{
+    DBusError error;
+    dbus_error_init (&error);
+
+    DBusConnection *conn = dbus_bus_get (type, &error);
+    if (conn == NULL) {
+        g_critical ("Can't connect to the %s bus: %s",
+                type == DBUS_BUS_SYSTEM ? "system" : "session",
+                error.message);
+        dbus_error_free (&error);
+        return NULL;
+    }
+    dbus_connection_setup_with_g_main (conn, NULL);
+    // we want to clean up (and stop the keepalives) if the bus goes away
+    dbus_connection_set_exit_on_disconnect (conn, FALSE);
+    dbus_connection_add_filter (conn,
+            (DBusHandleMessageFunction) on_bus_message, daemon, NULL);
+
+    return conn;
+}
+
+static gboolean
+init_service (Daemon *daemon)
+{
+    static const DBusObjectPathVTable vtable = {
+        .message_function = (DBusObjectPathMessageFunction) on_sadba_message
+    };
+    DBusError error;
+    dbus_error_init (&error);
+
+    if (!dbus_connection_register_object_path (daemon->session_dbus_conn,
+                SADBA_PATH, &vtable, daemon)) {
+        g_critical ("Can't export %s", SADBA_PATH);
+        return FALSE;
+    }
+
+    // only one daemon can own the inhibition
+    int r = dbus_bus_request_name (daemon->session_dbus_conn, SADBA_SERVICE,
+            DBUS_NAME_FLAG_DO_NOT_QUEUE, &error);
+    if (r != DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER) {
+        g_critical ("Can't get the %s bus name: %s", SADBA_SERVICE,
+                dbus_error_is_set (&error) ? error.message : "name taken");
+        dbus_error_free (&error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+int
+main (int argc, char *argv[])
+{
+    Daemon daemon = { NULL };
+    int status = EXIT_FAILURE;
+
+#if !GLIB_CHECK_VERSION (2, 36, 0)
+    g_type_init ();
+#endif
+
+    daemon.loop = g_main_loop_new (NULL, FALSE);
+
+    daemon.dbus_conn = get_bus (&daemon, DBUS_BUS_SYSTEM);
+    if (daemon.dbus_conn == NULL)
+        goto out;
+    daemon.session_dbus_conn = get_bus (&daemon, DBUS_BUS_SESSION);
+    if (daemon.session_dbus_conn == NULL)
+        goto out;
+
+    daemon.clients = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+            NULL, (GDestroyNotify) client_free);
+    daemon.owners = g_hash_table_new_full (g_str_hash, g_str_equal,
+            g_free, NULL);
+
+    daemon.gconf_client = gconf_client_get_default ();
+    g_assert (GCONF_IS_CLIENT (daemon.gconf_client));
+
+    daemon.engine = inhibit_engine_new (daemon.dbus_conn, daemon.gconf_client,
+            (InhibitEngineNotify) on_inhibit_engine_notify, &daemon);
+
+    if (!init_service (&daemon))
+        goto out;
+
+    daemon.schedule = schedule_new (daemon.dbus_conn, daemon.gconf_client,
+            (ScheduleNotify) on_schedule_notify, &daemon);
+    init_power_policy (&daemon);
+    init_orientation (&daemon);
+    init_journal (&daemon);
+
+    // the statistics are not essential
+    daemon.stats = stats_new ((StatsUpdateFunc) on_stats_update, &daemon);
+    stats_export (daemon.stats, daemon.session_dbus_conn);
+
+    g_main_loop_run (daemon.loop);
+    status = EXIT_SUCCESS;
+
+out:
+    if (daemon.stats != NULL)
+        stats_free (daemon.stats);
+    if (daemon.schedule != NULL)
+        schedule_free (daemon.schedule);
+    if (daemon.power != NULL)
+        power_free (daemon.power);
+    if (daemon.orientation != NULL)
+        orientation_free (daemon.orientation);
+    if (daemon.journal != NULL) {
+        update_journal (&daemon, TRUE);
+        journal_close (daemon.journal);
+    }
+    // stops the keepalives
+    if (daemon.engine != NULL)
+        inhibit_engine_free (daemon.engine);
+    if (daemon.clients != NULL) {
+        g_hash_table_destroy (daemon.clients);
+        g_hash_table_destroy (daemon.owners);
+    }
+    if (daemon.gconf_client != NULL)
+        g_object_unref (daemon.gconf_client);
+    if (daemon.session_dbus_conn != NULL) {
+        dbus_connection_remove_filter (daemon.session_dbus_conn,
+                (DBusHandleMessageFunction) on_bus_message, &daemon);
+        dbus_connection_unref (daemon.session_dbus_conn);
+    }
+    if (daemon.dbus_conn != NULL) {
+        dbus_connection_remove_filter (daemon.dbus_conn,
+                (DBusHandleMessageFunction) on_bus_message, &daemon);
+        dbus_connection_unref (daemon.dbus_conn);
+    }
+    g_main_loop_unref (daemon.loop);
+
+    return status;
+}
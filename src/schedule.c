@@ -0,0 +1,341 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+#define _POSIX_C_SOURCE 199506L // for localtime_r ()
+
+#include <stdio.h>
+#include <time.h>
+
+#include "inhibit-engine.h"
+#include "schedule.h"
+
+// clockd signals wall clock and timezone changes on the system bus
+#define CLOCKD_INTERFACE    "com.nokia.clockd"
+#define CLOCKD_TIME_CHANGED "time_changed"
+#define CLOCKD_MATCH "type='signal',interface='" CLOCKD_INTERFACE "'," \
+        "member='" CLOCKD_TIME_CHANGED "'"
+
+#define DAY  SCHEDULE_DAY
+#define WEEK SCHEDULE_WEEK
+
+struct _Schedule
+{
+    DBusConnection *dbus_conn;
+    GConfClient *gconf_client;
+    ScheduleNotify notify;
+    gpointer notify_data;
+    guint gconf_notify_ids[2];
+    GArray *rules;      // ScheduleRule, in priority order
+    GArray *boundaries; // guint, minutes since Monday 00:00, sorted
+    gint default_mode;  // < 0 if the mode is left alone outside the rules
+    gint applied_mode;  // last mode the schedule asked for, < 0 if none
+    guint timer_id;     // next boundary, 0 if there is none
+};
+
+gboolean
+schedule_rule_parse (const gchar *str, ScheduleRule *rule)
+{
+    gchar days[8];
+    guint sh, sm, eh, em;
+    gint mode;
+    gchar extra;
+
+    if (sscanf (str, "%7s %u:%u-%u:%u %d %c", days, &sh, &sm, &eh, &em,
+                &mode, &extra) != 6)
+        return FALSE;
+    if (sh > 23 || sm > 59 || eh > 24 || em > 59 || (eh == 24 && em != 0)
+            || mode < 0 || mode >= BLANKING_MODES)
+        return FALSE;
+
+    rule->days = 0;
+    if (g_str_equal (days, "*"))
+        rule->days = (1 << 7) - 1;
+    else {
+        for (const gchar *d = days; *d != '\0'; d++) {
+            if (*d < '1' || *d > '7')
+                return FALSE;
+            rule->days |= 1 << (*d - '1');
+        }
+    }
+
+    rule->start = sh * 60 + sm;
+    rule->length = ((eh * 60 + em) % DAY + DAY - rule->start) % DAY;
+    if (rule->length == 0) // same start and end, the whole day
+        rule->length = DAY;
+    rule->mode = mode;
+
+    return TRUE;
+}
+
+static gint
+compare_minutes (gconstpointer a, gconstpointer b)
+{
+    guint x = *(const guint *) a, y = *(const guint *) b;
+    return x < y ? -1 : x > y;
+}
+
+static void
+add_boundary (GArray *boundaries, guint minute)
+{
+    minute %= WEEK;
+    g_array_append_val (boundaries, minute);
+}
+
+void
+schedule_rules_boundaries (const GArray *rules, GArray *boundaries)
+{
+    g_array_set_size (boundaries, 0);
+    for (guint i = 0; i < rules->len; i++) {
+        const ScheduleRule *rule = &g_array_index (rules, ScheduleRule, i);
+        for (guint day = 0; day < 7; day++) {
+            if (!(rule->days & (1 << day)))
+                continue;
+            add_boundary (boundaries, day * DAY + rule->start);
+            add_boundary (boundaries, day * DAY + rule->start + rule->length);
+        }
+    }
+
+    // sorted and without duplicates, so the next one is easy to find
+    g_array_sort (boundaries, compare_minutes);
+    guint n = 0;
+    for (guint i = 0; i < boundaries->len; i++) {
+        guint minute = g_array_index (boundaries, guint, i);
+        if (n == 0 || g_array_index (boundaries, guint, n - 1) != minute)
+            g_array_index (boundaries, guint, n++) = minute;
+    }
+    g_array_set_size (boundaries, n);
+}
+
+static void
+load_rules (Schedule *schedule)
+{
+    g_array_set_size (schedule->rules, 0);
+
+    GSList *list = gconf_client_get_list (schedule->gconf_client,
+            SCHEDULE_GCONF_KEY, GCONF_VALUE_STRING, NULL);
+    for (GSList *l = list; l != NULL; l = l->next) {
+        ScheduleRule rule;
+        if (!schedule_rule_parse (l->data, &rule)) {
+            g_warning ("Ignoring invalid schedule rule '%s'",
+                    (gchar *) l->data);
+            continue;
+        }
+        g_array_append_val (schedule->rules, rule);
+    }
+    g_slist_foreach (list, (GFunc) g_free, NULL);
+    g_slist_free (list);
+
+    schedule_rules_boundaries (schedule->rules, schedule->boundaries);
+
+    // gconf_client_get_int () can't tell an unset key from 0
+    schedule->default_mode = -1;
+    GConfValue *value = gconf_client_get (schedule->gconf_client,
+            SCHEDULE_DEFAULT_MODE_GCONF_KEY, NULL);
+    if (value != NULL) {
+        if (value->type == GCONF_VALUE_INT
+                && gconf_value_get_int (value) < BLANKING_MODES)
+            schedule->default_mode = gconf_value_get_int (value);
+        gconf_value_free (value);
+    }
+}
+
+gint
+schedule_rules_mode_at (const GArray *rules, guint minute)
+{
+    for (guint i = 0; i < rules->len; i++) {
+        const ScheduleRule *rule = &g_array_index (rules, ScheduleRule, i);
+        for (guint day = 0; day < 7; day++) {
+            if (!(rule->days & (1 << day)))
+                continue;
+            guint start = day * DAY + rule->start;
+            if ((minute + WEEK - start) % WEEK < rule->length)
+                return rule->mode;
+        }
+    }
+
+    return -1;
+}
+
+static guint
+minute_of_week (const struct tm *tm)
+{
+    return ((tm->tm_wday + 6) % 7) * DAY + tm->tm_hour * 60 + tm->tm_min;
+}
+
+// Uses mktime () so daylight saving time changes in between are accounted
+guint
+schedule_seconds_until (time_t now, guint minute)
+{
+    struct tm now_tm;
+    localtime_r (&now, &now_tm);
+    guint delta = (minute + WEEK - minute_of_week (&now_tm)) % WEEK;
+    if (delta == 0)
+        delta = WEEK;
+
+    struct tm tm = now_tm;
+    tm.tm_mday += (now_tm.tm_hour * 60 + now_tm.tm_min + delta) / DAY;
+    tm.tm_hour = (minute % DAY) / 60;
+    tm.tm_min = minute % 60;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    time_t deadline = mktime (&tm);
+
+    return deadline > now ? deadline - now : 1;
+}
+
+static gboolean on_timeout (Schedule *schedule);
+
+// Applies the current mode and arms the timer for the next boundary
+static void
+update (Schedule *schedule)
+{
+    if (schedule->timer_id != 0) {
+        g_source_remove (schedule->timer_id);
+        schedule->timer_id = 0;
+    }
+
+    if (schedule->rules->len == 0) {
+        schedule->applied_mode = -1;
+        return;
+    }
+
+    // the timezone might have changed too
+    tzset ();
+    time_t now = time (NULL);
+    struct tm now_tm;
+    localtime_r (&now, &now_tm);
+    guint minute = minute_of_week (&now_tm);
+
+    // only changes are applied, so the user can still pick another mode
+    // until the next boundary
+    gint mode = schedule_rules_mode_at (schedule->rules, minute);
+    if (mode < 0)
+        mode = schedule->default_mode;
+    if (mode >= 0 && mode != schedule->applied_mode)
+        schedule->notify (schedule, mode, schedule->notify_data);
+    schedule->applied_mode = mode;
+
+    guint next = g_array_index (schedule->boundaries, guint, 0);
+    for (guint i = 0; i < schedule->boundaries->len; i++) {
+        guint b = g_array_index (schedule->boundaries, guint, i);
+        if (b > minute) {
+            next = b;
+            break;
+        }
+    }
+
+    guint timeout = schedule_seconds_until (now, next);
+    g_debug ("Next schedule boundary in %us", timeout);
+    schedule->timer_id = g_timeout_add_seconds (timeout,
+            (GSourceFunc) on_timeout, schedule);
+}
+
+static gboolean
+on_timeout (Schedule *schedule)
+{
+    // the source is removed when returning FALSE
+    schedule->timer_id = 0;
+    update (schedule);
+
+    return FALSE;
+}
+
+static void
+on_gconf_notify (GConfClient *client, guint cnxn_id, GConfEntry *entry,
+        Schedule *schedule)
+{
+    load_rules (schedule);
+    update (schedule);
+}
+
+static DBusHandlerResult
+on_dbus_message (DBusConnection *conn, DBusMessage *msg, Schedule *schedule)
+{
+    if (dbus_message_is_signal (msg, CLOCKD_INTERFACE, CLOCKD_TIME_CHANGED))
+        update (schedule);
+
+    // other filters might be interested too
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+Schedule *
+schedule_new (DBusConnection *dbus_conn, GConfClient *gconf_client,
+        ScheduleNotify notify, gpointer notify_data)
+{
+    g_assert (dbus_conn != NULL);
+    g_assert (GCONF_IS_CLIENT (gconf_client));
+
+    Schedule *schedule = g_slice_new0 (Schedule);
+
+    schedule->dbus_conn = dbus_connection_ref (dbus_conn);
+    schedule->gconf_client = g_object_ref (gconf_client);
+    schedule->notify = notify;
+    schedule->notify_data = notify_data;
+    schedule->rules = g_array_new (FALSE, FALSE, sizeof (ScheduleRule));
+    schedule->boundaries = g_array_new (FALSE, FALSE, sizeof (guint));
+    schedule->applied_mode = -1;
+
+    // watching the keys makes the client cache them
+    gconf_client_add_dir (gconf_client, SCHEDULE_GCONF_KEY,
+            GCONF_CLIENT_PRELOAD_NONE, NULL);
+    gconf_client_add_dir (gconf_client, SCHEDULE_DEFAULT_MODE_GCONF_KEY,
+            GCONF_CLIENT_PRELOAD_NONE, NULL);
+    schedule->gconf_notify_ids[0] = gconf_client_notify_add (gconf_client,
+            SCHEDULE_GCONF_KEY, (GConfClientNotifyFunc) on_gconf_notify,
+            schedule, NULL, NULL);
+    schedule->gconf_notify_ids[1] = gconf_client_notify_add (gconf_client,
+            SCHEDULE_DEFAULT_MODE_GCONF_KEY,
+            (GConfClientNotifyFunc) on_gconf_notify, schedule, NULL, NULL);
+
+    dbus_bus_add_match (dbus_conn, CLOCKD_MATCH, NULL);
+    dbus_connection_add_filter (dbus_conn,
+            (DBusHandleMessageFunction) on_dbus_message, schedule, NULL);
+
+    load_rules (schedule);
+    update (schedule);
+
+    return schedule;
+}
+
+void
+schedule_free (Schedule *schedule)
+{
+    if (schedule->timer_id != 0)
+        g_source_remove (schedule->timer_id);
+
+    dbus_connection_remove_filter (schedule->dbus_conn,
+            (DBusHandleMessageFunction) on_dbus_message, schedule);
+    dbus_bus_remove_match (schedule->dbus_conn, CLOCKD_MATCH, NULL);
+    dbus_connection_unref (schedule->dbus_conn);
+
+    for (int i = 0; i < 2; i++)
+        gconf_client_notify_remove (schedule->gconf_client,
+                schedule->gconf_notify_ids[i]);
+    gconf_client_remove_dir (schedule->gconf_client, SCHEDULE_GCONF_KEY,
+            NULL);
+    gconf_client_remove_dir (schedule->gconf_client,
+            SCHEDULE_DEFAULT_MODE_GCONF_KEY, NULL);
+    g_object_unref (schedule->gconf_client);
+
+    g_array_free (schedule->rules, TRUE);
+    g_array_free (schedule->boundaries, TRUE);
+
+    g_slice_free (Schedule, schedule);
+}
@@ -0,0 +1,82 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Time of day blanking mode schedules. The rules are a GConf list of
+// strings with the form "DAYS HH:MM-HH:MM MODE", where DAYS are the week
+// days as digits (1 is Monday, 7 is Sunday) or "*" for every day, and the
+// end can be before the start to span midnight. For example "12345
+// 08:00-18:00 3". The first matching rule wins, outside all the rules the
+// default mode is used (if it's < 0 the mode is left alone).
+//
+// A single timer is armed for the next rule boundary, and it's recomputed
+// when the rules change or clockd reports a wall clock change.
+
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <time.h>
+#include <glib.h>
+#include <gconf/gconf-client.h>
+#include <dbus/dbus.h>
+
+#define SCHEDULE_GCONF_KEY              "/apps/Maemo/sadba/schedule"
+#define SCHEDULE_DEFAULT_MODE_GCONF_KEY "/apps/Maemo/sadba/schedule_default_mode"
+
+// Minutes in a day and in a week, the rules and their boundaries are
+// expressed in minutes since midnight and since Monday 00:00
+#define SCHEDULE_DAY  (24 * 60)
+#define SCHEDULE_WEEK (7 * SCHEDULE_DAY)
+
+typedef struct
+{
+    guint days;   // bit mask, bit 0 is Monday
+    guint start;  // minutes since midnight
+    guint length; // in minutes, up to a whole day
+    gint mode;
+} ScheduleRule;
+
+typedef struct _Schedule Schedule;
+
+// Parses a "DAYS HH:MM-HH:MM MODE" rule, returns FALSE if it's invalid
+gboolean schedule_rule_parse (const gchar *str, ScheduleRule *rule);
+
+// Mode of the first rule (of an array of ScheduleRule) covering the minute
+// of the week, or -1 if none does
+gint schedule_rules_mode_at (const GArray *rules, guint minute);
+
+// Fills boundaries (guint) with the minutes of the week where the rules
+// start or end, sorted and without duplicates
+void schedule_rules_boundaries (const GArray *rules, GArray *boundaries);
+
+// Seconds from now until the next time the local time is the minute of the
+// week (a whole week if it's now), daylight saving time changes included
+guint schedule_seconds_until (time_t now, guint minute);
+
+// Called when a rule boundary is reached and the mode has to change
+typedef void (*ScheduleNotify) (Schedule *schedule, gint mode, gpointer data);
+
+// The connection (to the system bus, where clockd lives) must be integrated
+// with the GLib main loop. The current mode is applied right away.
+Schedule *schedule_new (DBusConnection *dbus_conn, GConfClient *gconf_client,
+        ScheduleNotify notify, gpointer notify_data);
+
+void schedule_free (Schedule *schedule);
+
+#endif // SCHEDULE_H
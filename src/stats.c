@@ -0,0 +1,167 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+#include "stats.h"
+
+#define STATS_INTROSPECTION DBUS_INTROSPECT_1_0_XML_DOCTYPE_DECL_NODE \
+    "<node>\n" \
+    "  <interface name=\"" DBUS_INTERFACE_INTROSPECTABLE "\">\n" \
+    "    <method name=\"Introspect\">\n" \
+    "      <arg name=\"data\" direction=\"out\" type=\"s\"/>\n" \
+    "    </method>\n" \
+    "  </interface>\n" \
+    "  <interface name=\"" STATS_INTERFACE "\">\n" \
+    "    <method name=\"GetStats\">\n" \
+    "      <arg name=\"stats\" direction=\"out\" type=\"a{st}\"/>\n" \
+    "    </method>\n" \
+    "  </interface>\n" \
+    "</node>\n"
+
+struct _Stats
+{
+    GHashTable *counters; // gchar * -> guint64 *
+    StatsUpdateFunc update;
+    gpointer update_data;
+    DBusConnection *dbus_conn; // NULL if not exported
+};
+
+static guint64 *
+get_counter (Stats *stats, const gchar *name)
+{
+    guint64 *counter = g_hash_table_lookup (stats->counters, name);
+
+    if (counter == NULL) {
+        counter = g_new0 (guint64, 1);
+        g_hash_table_insert (stats->counters, g_strdup (name), counter);
+    }
+
+    return counter;
+}
+
+Stats *
+stats_new (StatsUpdateFunc update, gpointer update_data)
+{
+    Stats *stats = g_slice_new0 (Stats);
+
+    stats->counters = g_hash_table_new_full (g_str_hash, g_str_equal,
+            g_free, g_free);
+    stats->update = update;
+    stats->update_data = update_data;
+
+    return stats;
+}
+
+void
+stats_free (Stats *stats)
+{
+    if (stats->dbus_conn != NULL) {
+        dbus_connection_unregister_object_path (stats->dbus_conn, STATS_PATH);
+        dbus_connection_unref (stats->dbus_conn);
+    }
+
+    g_hash_table_destroy (stats->counters);
+
+    g_slice_free (Stats, stats);
+}
+
+void
+stats_set (Stats *stats, const gchar *name, guint64 value)
+{
+    *get_counter (stats, name) = value;
+}
+
+void
+stats_add (Stats *stats, const gchar *name, guint64 value)
+{
+    *get_counter (stats, name) += value;
+}
+
+static void
+append_counters (Stats *stats, DBusMessage *reply)
+{
+    DBusMessageIter iter, dict, entry;
+
+    dbus_message_iter_init_append (reply, &iter);
+    dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY,
+            DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+            DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_UINT64_AS_STRING
+            DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &dict);
+
+    GHashTableIter i;
+    gpointer name, counter;
+    g_hash_table_iter_init (&i, stats->counters);
+    while (g_hash_table_iter_next (&i, &name, &counter)) {
+        dbus_message_iter_open_container (&dict, DBUS_TYPE_DICT_ENTRY, NULL,
+                &entry);
+        dbus_message_iter_append_basic (&entry, DBUS_TYPE_STRING, &name);
+        dbus_message_iter_append_basic (&entry, DBUS_TYPE_UINT64, counter);
+        dbus_message_iter_close_container (&dict, &entry);
+    }
+
+    dbus_message_iter_close_container (&iter, &dict);
+}
+
+static DBusHandlerResult
+on_stats_message (DBusConnection *conn, DBusMessage *msg, Stats *stats)
+{
+    DBusMessage *reply = NULL;
+
+    if (dbus_message_is_method_call (msg, DBUS_INTERFACE_INTROSPECTABLE,
+                "Introspect")) {
+        const gchar *xml = STATS_INTROSPECTION;
+        reply = dbus_message_new_method_return (msg);
+        dbus_message_append_args (reply, DBUS_TYPE_STRING, &xml,
+                DBUS_TYPE_INVALID);
+    }
+    else if (dbus_message_is_method_call (msg, STATS_INTERFACE,
+                "GetStats")) {
+        if (stats->update != NULL)
+            stats->update (stats, stats->update_data);
+        reply = dbus_message_new_method_return (msg);
+        append_counters (stats, reply);
+    }
+    else
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    if (!dbus_connection_send (conn, reply, NULL))
+        g_warning ("Can't send the statistics reply");
+    dbus_message_unref (reply);
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+gboolean
+stats_export (Stats *stats, DBusConnection *dbus_conn)
+{
+    static const DBusObjectPathVTable vtable = {
+        .message_function = (DBusObjectPathMessageFunction) on_stats_message
+    };
+
+    g_assert (stats->dbus_conn == NULL);
+
+    if (!dbus_connection_register_object_path (dbus_conn, STATS_PATH,
+                &vtable, stats)) {
+        g_warning ("Can't export the statistics at %s", STATS_PATH);
+        return FALSE;
+    }
+    stats->dbus_conn = dbus_connection_ref (dbus_conn);
+
+    return TRUE;
+}
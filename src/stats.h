@@ -0,0 +1,52 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Runtime statistics, a set of named counters that can be exported as a
+// D-Bus object. Counter names carry their unit as a suffix (_us, _s, etc.).
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#define STATS_INTERFACE "ar.com.llucax.Sadba.Stats"
+#define STATS_PATH      "/ar/com/llucax/Sadba/Stats"
+
+typedef struct _Stats Stats;
+
+// Called before the counters are reported, to refresh the ones that are
+// not updated as they change
+typedef void (*StatsUpdateFunc) (Stats *stats, gpointer data);
+
+Stats *stats_new (StatsUpdateFunc update, gpointer update_data);
+
+void stats_free (Stats *stats);
+
+void stats_set (Stats *stats, const gchar *name, guint64 value);
+
+void stats_add (Stats *stats, const gchar *name, guint64 value);
+
+// Makes the counters available through the STATS_INTERFACE GetStats ()
+// method at STATS_PATH, the connection must be integrated with the GLib
+// main loop
+gboolean stats_export (Stats *stats, DBusConnection *dbus_conn);
+
+#endif // STATS_H
@@ -0,0 +1,212 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// End to end UI latencies, tapping the real plugin under X (run-tests
+// starts Xvfb) against the fake MCE and the daemon. The results are
+// printed one per line, tab separated, so they can be compared between
+// releases:
+//
+//   <name> <samples> <min_us> <avg_us> <max_us>
+//
+// The plugin_* lines are the plugin's own measurements, from its
+// statistics, only their average is known.
+
+#include <stdio.h>
+#include <gconf/gconf-client.h>
+
+#include "inhibit-engine.h"
+#include "test-plugin-util.h"
+
+#define SAMPLES 20
+
+typedef struct
+{
+    const gchar *name;
+    guint samples;
+    gint64 min;
+    gint64 total;
+    gint64 max;
+} Result;
+
+static void
+result_add (Result *r, gint64 latency)
+{
+    g_assert (latency >= 0);
+    if (r->samples == 0 || latency < r->min)
+        r->min = latency;
+    r->max = MAX (r->max, latency);
+    r->total += latency;
+    r->samples++;
+}
+
+static void
+result_print (const Result *r)
+{
+    printf ("%s\t%u\t%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\t%"
+            G_GINT64_FORMAT "\n", r->name, r->samples, r->min,
+            r->total / r->samples, r->max);
+}
+
+// The plugin only knows the total and the number of samples
+static void
+plugin_result_print (const gchar *name)
+{
+    gchar *counter = g_strdup_printf ("%s_latency_total_us", name);
+    guint64 total = test_plugin_get_stat (counter);
+    g_free (counter);
+    counter = g_strdup_printf ("%s_latency_samples", name);
+    guint64 samples = test_plugin_get_stat (counter);
+    g_free (counter);
+
+    if (samples == 0)
+        return;
+    printf ("plugin_%s\t%" G_GUINT64_FORMAT "\t-\t%" G_GUINT64_FORMAT "\t-\n",
+            name, samples, total / samples);
+}
+
+static gboolean
+got_dialog (gpointer before)
+{
+    return test_plugin_get_dialogs (NULL) > GPOINTER_TO_UINT (before);
+}
+
+static gboolean
+got_keepalive (gpointer data)
+{
+    return fake_mce_get_keepalives (NULL) > 0;
+}
+
+static gboolean
+is_off (gpointer data)
+{
+    return test_daemon_get_state () == INHIBIT_ENGINE_OFF;
+}
+
+static void
+bench_dialog (TestPlugin *plugin, const gchar *button, Result *r)
+{
+    for (int i = 0; i < SAMPLES; i++) {
+        guint dialogs = test_plugin_get_dialogs (NULL);
+        gint64 tap = test_plugin_tap (plugin, button);
+        g_assert (test_wait_for (got_dialog, GUINT_TO_POINTER (dialogs),
+                    TEST_TIMEOUT));
+        gint64 mapped;
+        test_plugin_get_dialogs (&mapped);
+        result_add (r, mapped - tap);
+        // the answer is given from an idle
+        test_run_for (20);
+    }
+}
+
+static void
+bench_inhibit (TestPlugin *plugin, Result *r)
+{
+    for (int i = 0; i < SAMPLES; i++) {
+        fake_mce_reset ();
+        gint64 tap = test_plugin_tap (plugin, "inhibit_button");
+        g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+        gint64 received;
+        fake_mce_get_keepalives (&received);
+        result_add (r, received - tap);
+
+        test_plugin_tap (plugin, "inhibit_button");
+        g_assert (test_wait_for (is_off, NULL, TEST_TIMEOUT));
+    }
+}
+
+static void
+on_mode_icon_changed (GObject *image, GParamSpec *pspec, gint64 *changed)
+{
+    *changed = test_monotonic_time ();
+}
+
+static gboolean
+is_set (gint64 *changed)
+{
+    return *changed != 0;
+}
+
+static void
+bench_mode_icon (TestPlugin *plugin, Result *r)
+{
+    GConfClient *gconf_client = gconf_client_get_default ();
+    gint mode = gconf_client_get_int (gconf_client, MODE_GCONF_KEY, NULL);
+    GtkWidget *image = gtk_button_get_image (GTK_BUTTON (
+                test_plugin_find (plugin, "mode_button")));
+    gint64 changed;
+    gulong id = g_signal_connect (image, "notify::pixbuf",
+            G_CALLBACK (on_mode_icon_changed), &changed);
+
+    for (int i = 0; i < SAMPLES; i++) {
+        // GConf only notifies about actual changes
+        mode = (mode + 1) % BLANKING_MODES;
+        changed = 0;
+        gint64 write = test_monotonic_time ();
+        gconf_client_set_int (gconf_client, MODE_GCONF_KEY, mode, NULL);
+        g_assert (test_wait_for ((TestCondition) is_set, &changed,
+                    TEST_TIMEOUT));
+        result_add (r, changed - write);
+    }
+
+    g_signal_handler_disconnect (image, id);
+    g_object_unref (gconf_client);
+}
+
+int
+main (int argc, char *argv[])
+{
+#if !GLIB_CHECK_VERSION (2, 36, 0)
+    g_type_init ();
+#endif
+    if (!test_plugin_init (&argc, &argv)) {
+        g_message ("No X display, can't run the UI benchmark");
+        return 0;
+    }
+    // dialogs are just looked at
+    test_plugin_set_dialog_response (GTK_RESPONSE_CANCEL);
+
+    fake_mce_start ();
+    GPid daemon = test_daemon_start ();
+    TestPlugin *plugin = test_plugin_new ();
+
+    Result results[] = {
+        { "tap_to_mode_dialog_mapped" },
+        { "tap_to_timed_dialog_mapped" },
+        { "tap_to_blank_pause_request" },
+        { "gconf_mode_to_icon_updated" },
+    };
+    bench_dialog (plugin, "mode_button", &results[0]);
+    bench_dialog (plugin, "timed_inhibit_button", &results[1]);
+    bench_inhibit (plugin, &results[2]);
+    bench_mode_icon (plugin, &results[3]);
+
+    printf ("# name\tsamples\tmin_us\tavg_us\tmax_us\n");
+    for (int i = 0; i < G_N_ELEMENTS (results); i++)
+        result_print (&results[i]);
+    plugin_result_print ("mode_dialog");
+    plugin_result_print ("timed_dialog");
+    plugin_result_print ("inhibit");
+
+    test_plugin_free (plugin);
+    test_daemon_stop (daemon);
+    fake_mce_stop ();
+
+    return 0;
+}
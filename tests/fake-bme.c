@@ -0,0 +1,171 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Stand-in for BME on the system bus, see fake-bme.h. Like the fake MCE it
+// only needs libdbus, and it's meant to run on a private bus.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dbus/dbus.h>
+
+#include "fake-bme.h"
+
+// there is no BME header, the names are the ones power.c uses
+#define BME_SIGNAL_PATH     "/com/nokia/bme/signal"
+#define BME_SIGNAL_IF       "com.nokia.bme.signal"
+#define BME_REQUEST_IF      "com.nokia.bme.request"
+#define BME_STATUS_INFO_REQ "status_info_req"
+
+#define BME_CHARGER_CONNECTED     "charger_connected"
+#define BME_CHARGER_DISCONNECTED  "charger_disconnected"
+#define BME_BATTERY_STATE_CHANGED "battery_state_changed"
+
+#define BME_REQUEST_MATCH "type='signal',interface='" BME_REQUEST_IF "'," \
+        "member='" BME_STATUS_INFO_REQ "'"
+
+// a full battery, not charging
+#define DEFAULT_BARS 8
+
+typedef struct
+{
+    DBusConnection *conn;
+    dbus_bool_t charger;
+    dbus_uint32_t now;
+    dbus_uint32_t max;
+    int quit;
+} FakeBme;
+
+static void
+emit (FakeBme *bme, const char *member, int first_arg_type, ...)
+{
+    DBusMessage *msg = dbus_message_new_signal (BME_SIGNAL_PATH,
+            BME_SIGNAL_IF, member);
+    va_list args;
+    va_start (args, first_arg_type);
+    dbus_message_append_args_valist (msg, first_arg_type, args);
+    va_end (args);
+    dbus_connection_send (bme->conn, msg, NULL);
+    dbus_message_unref (msg);
+}
+
+static void
+emit_charger (FakeBme *bme)
+{
+    emit (bme, bme->charger ? BME_CHARGER_CONNECTED
+            : BME_CHARGER_DISCONNECTED, DBUS_TYPE_INVALID);
+}
+
+static void
+emit_battery (FakeBme *bme)
+{
+    emit (bme, BME_BATTERY_STATE_CHANGED, DBUS_TYPE_UINT32, &bme->now,
+            DBUS_TYPE_UINT32, &bme->max, DBUS_TYPE_INVALID);
+}
+
+static DBusMessage *
+handle_control (FakeBme *bme, DBusMessage *msg)
+{
+    DBusMessage *reply = dbus_message_new_method_return (msg);
+
+    if (dbus_message_is_method_call (msg, FAKE_BME_INTERFACE,
+                FAKE_BME_SET_CHARGER)
+            && dbus_message_get_args (msg, NULL, DBUS_TYPE_BOOLEAN,
+                &bme->charger, DBUS_TYPE_INVALID))
+        emit_charger (bme);
+    else if (dbus_message_is_method_call (msg, FAKE_BME_INTERFACE,
+                FAKE_BME_SET_BATTERY)
+            && dbus_message_get_args (msg, NULL, DBUS_TYPE_UINT32, &bme->now,
+                DBUS_TYPE_UINT32, &bme->max, DBUS_TYPE_INVALID))
+        emit_battery (bme);
+    else if (dbus_message_is_method_call (msg, FAKE_BME_INTERFACE,
+                FAKE_BME_QUIT))
+        bme->quit = TRUE;
+    else {
+        dbus_message_unref (reply);
+        return dbus_message_new_error (msg, DBUS_ERROR_INVALID_ARGS,
+                dbus_message_get_member (msg));
+    }
+
+    return reply;
+}
+
+static DBusHandlerResult
+on_message (DBusConnection *conn, DBusMessage *msg, FakeBme *bme)
+{
+    // like the real BME, the status is reported with the usual signals
+    if (dbus_message_is_signal (msg, BME_REQUEST_IF, BME_STATUS_INFO_REQ)) {
+        emit_charger (bme);
+        emit_battery (bme);
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    if (dbus_message_get_type (msg) != DBUS_MESSAGE_TYPE_METHOD_CALL
+            || strcmp (dbus_message_get_path (msg), FAKE_BME_PATH) != 0)
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    DBusMessage *reply = handle_control (bme, msg);
+    if (!dbus_message_get_no_reply (msg))
+        dbus_connection_send (conn, reply, NULL);
+    dbus_message_unref (reply);
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+int
+main (int argc, char *argv[])
+{
+    FakeBme bme = { NULL, FALSE, DEFAULT_BARS, DEFAULT_BARS, FALSE };
+    DBusError error;
+    dbus_error_init (&error);
+
+    bme.conn = dbus_bus_get (DBUS_BUS_SYSTEM, &error);
+    if (bme.conn == NULL) {
+        fprintf (stderr, "fake-bme: %s\n", error.message);
+        return EXIT_FAILURE;
+    }
+    dbus_connection_add_filter (bme.conn,
+            (DBusHandleMessageFunction) on_message, &bme, NULL);
+    dbus_bus_add_match (bme.conn, BME_REQUEST_MATCH, &error);
+    if (dbus_error_is_set (&error)) {
+        fprintf (stderr, "fake-bme: %s\n", error.message);
+        return EXIT_FAILURE;
+    }
+
+    // the tests wait for the name, so it goes last
+    int r = dbus_bus_request_name (bme.conn, FAKE_BME_SERVICE,
+            DBUS_NAME_FLAG_DO_NOT_QUEUE, &error);
+    if (r != DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER) {
+        fprintf (stderr, "fake-bme: can't get %s: %s\n", FAKE_BME_SERVICE,
+                dbus_error_is_set (&error) ? error.message : "name taken");
+        return EXIT_FAILURE;
+    }
+
+    while (!bme.quit && dbus_connection_read_write_dispatch (bme.conn, -1))
+        ;
+
+    // the reply to Quit () is sent before the name goes away
+    dbus_connection_flush (bme.conn);
+    dbus_bus_release_name (bme.conn, FAKE_BME_SERVICE, NULL);
+    dbus_connection_unref (bme.conn);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,41 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Control interface of the fake BME (battery management entity) used by
+// the tests. The fake BME owns the real BME name on the (private) system
+// bus, and emits the charger and battery signals the daemon listens to,
+// also when asked for its status. The tests drive it through these
+// methods.
+
+#ifndef FAKE_BME_H
+#define FAKE_BME_H
+
+#define FAKE_BME_SERVICE   "com.nokia.bme" // the real BME name
+#define FAKE_BME_PATH      "/ar/com/llucax/Sadba/FakeBme"
+#define FAKE_BME_INTERFACE "ar.com.llucax.Sadba.FakeBme"
+
+// SetCharger (b connected), emits the charger (dis)connected signal
+#define FAKE_BME_SET_CHARGER "SetCharger"
+// SetBattery (u now, u max), emits the battery state signal, in "bars"
+#define FAKE_BME_SET_BATTERY "SetBattery"
+// Quit (), replies and releases the BME name
+#define FAKE_BME_QUIT "Quit"
+
+#endif // FAKE_BME_H
@@ -0,0 +1,209 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Stand-in for MCE on the system bus, see fake-mce.h. It only needs
+// libdbus, and it's meant to run on a private bus (run-tests starts one).
+
+#define _POSIX_C_SOURCE 199309L // for clock_gettime ()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dbus/dbus.h>
+#include <mce/dbus-names.h>
+#include <mce/mode-names.h>
+
+#include "fake-mce.h"
+
+// as in inhibit-engine.c, the Fremantle headers don't have it
+#ifndef MCE_CANCEL_PREVENT_BLANK_REQ
+#define MCE_CANCEL_PREVENT_BLANK_REQ "req_display_cancel_blanking_pause"
+#endif
+
+typedef struct
+{
+    DBusConnection *conn;
+    char display[16];
+    char tklock[16];
+    dbus_uint32_t keepalives;
+    dbus_int64_t last_keepalive; // monotonic, in microseconds
+    dbus_uint32_t cancels;
+    int quit;
+} FakeMce;
+
+static dbus_int64_t
+monotonic_time_usec (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (dbus_int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+emit (FakeMce *mce, const char *member, const char *value)
+{
+    DBusMessage *msg = dbus_message_new_signal (MCE_SIGNAL_PATH,
+            MCE_SIGNAL_IF, member);
+    dbus_message_append_args (msg, DBUS_TYPE_STRING, &value,
+            DBUS_TYPE_INVALID);
+    dbus_connection_send (mce->conn, msg, NULL);
+    dbus_message_unref (msg);
+}
+
+// Stores the string argument of msg in value, returns FALSE if there is none
+static int
+get_string_arg (DBusMessage *msg, char *value, size_t size)
+{
+    const char *str;
+    if (!dbus_message_get_args (msg, NULL, DBUS_TYPE_STRING, &str,
+                DBUS_TYPE_INVALID) || strlen (str) >= size)
+        return FALSE;
+    strcpy (value, str);
+    return TRUE;
+}
+
+static DBusMessage *
+handle_request (FakeMce *mce, DBusMessage *msg)
+{
+    DBusMessage *reply = dbus_message_new_method_return (msg);
+    const char *value = NULL;
+
+    if (dbus_message_is_method_call (msg, MCE_REQUEST_IF,
+                MCE_PREVENT_BLANK_REQ)) {
+        mce->last_keepalive = monotonic_time_usec ();
+        mce->keepalives++;
+    }
+    else if (dbus_message_is_method_call (msg, MCE_REQUEST_IF,
+                MCE_CANCEL_PREVENT_BLANK_REQ))
+        mce->cancels++;
+    else if (dbus_message_is_method_call (msg, MCE_REQUEST_IF,
+                MCE_DISPLAY_STATUS_GET))
+        value = mce->display;
+    else if (dbus_message_is_method_call (msg, MCE_REQUEST_IF,
+                MCE_TKLOCK_MODE_GET))
+        value = mce->tklock;
+    else {
+        dbus_message_unref (reply);
+        return dbus_message_new_error (msg, DBUS_ERROR_UNKNOWN_METHOD,
+                dbus_message_get_member (msg));
+    }
+
+    if (value != NULL)
+        dbus_message_append_args (reply, DBUS_TYPE_STRING, &value,
+                DBUS_TYPE_INVALID);
+
+    return reply;
+}
+
+static DBusMessage *
+handle_control (FakeMce *mce, DBusMessage *msg)
+{
+    DBusMessage *reply = dbus_message_new_method_return (msg);
+
+    if (dbus_message_is_method_call (msg, FAKE_MCE_INTERFACE,
+                FAKE_MCE_SET_DISPLAY)
+            && get_string_arg (msg, mce->display, sizeof (mce->display)))
+        emit (mce, MCE_DISPLAY_SIG, mce->display);
+    else if (dbus_message_is_method_call (msg, FAKE_MCE_INTERFACE,
+                FAKE_MCE_SET_TKLOCK)
+            && get_string_arg (msg, mce->tklock, sizeof (mce->tklock)))
+        emit (mce, MCE_TKLOCK_MODE_SIG, mce->tklock);
+    else if (dbus_message_is_method_call (msg, FAKE_MCE_INTERFACE,
+                FAKE_MCE_GET_KEEPALIVES))
+        dbus_message_append_args (reply, DBUS_TYPE_UINT32, &mce->keepalives,
+                DBUS_TYPE_INT64, &mce->last_keepalive, DBUS_TYPE_INVALID);
+    else if (dbus_message_is_method_call (msg, FAKE_MCE_INTERFACE,
+                FAKE_MCE_GET_CANCELS))
+        dbus_message_append_args (reply, DBUS_TYPE_UINT32, &mce->cancels,
+                DBUS_TYPE_INVALID);
+    else if (dbus_message_is_method_call (msg, FAKE_MCE_INTERFACE,
+                FAKE_MCE_RESET))
+        mce->keepalives = mce->last_keepalive = mce->cancels = 0;
+    else if (dbus_message_is_method_call (msg, FAKE_MCE_INTERFACE,
+                FAKE_MCE_QUIT))
+        mce->quit = TRUE;
+    else {
+        dbus_message_unref (reply);
+        return dbus_message_new_error (msg, DBUS_ERROR_INVALID_ARGS,
+                dbus_message_get_member (msg));
+    }
+
+    return reply;
+}
+
+static DBusHandlerResult
+on_message (DBusConnection *conn, DBusMessage *msg, FakeMce *mce)
+{
+    if (dbus_message_get_type (msg) != DBUS_MESSAGE_TYPE_METHOD_CALL)
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    DBusMessage *reply;
+    if (strcmp (dbus_message_get_path (msg), MCE_REQUEST_PATH) == 0)
+        reply = handle_request (mce, msg);
+    else if (strcmp (dbus_message_get_path (msg), FAKE_MCE_PATH) == 0)
+        reply = handle_control (mce, msg);
+    else
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    if (!dbus_message_get_no_reply (msg))
+        dbus_connection_send (conn, reply, NULL);
+    dbus_message_unref (reply);
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+int
+main (int argc, char *argv[])
+{
+    FakeMce mce = { NULL };
+    DBusError error;
+    dbus_error_init (&error);
+
+    strcpy (mce.display, MCE_DISPLAY_ON_STRING);
+    strcpy (mce.tklock, MCE_TK_UNLOCKED);
+
+    mce.conn = dbus_bus_get (DBUS_BUS_SYSTEM, &error);
+    if (mce.conn == NULL) {
+        fprintf (stderr, "fake-mce: %s\n", error.message);
+        return EXIT_FAILURE;
+    }
+    dbus_connection_add_filter (mce.conn,
+            (DBusHandleMessageFunction) on_message, &mce, NULL);
+
+    // the tests wait for the name, so it goes last
+    int r = dbus_bus_request_name (mce.conn, MCE_SERVICE,
+            DBUS_NAME_FLAG_DO_NOT_QUEUE, &error);
+    if (r != DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER) {
+        fprintf (stderr, "fake-mce: can't get %s: %s\n", MCE_SERVICE,
+                dbus_error_is_set (&error) ? error.message : "name taken");
+        return EXIT_FAILURE;
+    }
+
+    while (!mce.quit && dbus_connection_read_write_dispatch (mce.conn, -1))
+        ;
+
+    // the reply to Quit () is sent before the name goes away
+    dbus_connection_flush (mce.conn);
+    dbus_bus_release_name (mce.conn, MCE_SERVICE, NULL);
+    dbus_connection_unref (mce.conn);
+
+    return EXIT_SUCCESS;
+}
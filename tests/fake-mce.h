@@ -0,0 +1,46 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Control interface of the fake MCE used by the tests. The fake MCE owns
+// the real MCE_SERVICE name on the (private) system bus, answers the
+// requests the engine makes and records when the blank pause requests
+// arrive. The tests drive it through these methods.
+
+#ifndef FAKE_MCE_H
+#define FAKE_MCE_H
+
+#define FAKE_MCE_PATH      "/ar/com/llucax/Sadba/FakeMce"
+#define FAKE_MCE_INTERFACE "ar.com.llucax.Sadba.FakeMce"
+
+// SetDisplay (s status), emits the MCE display status signal
+#define FAKE_MCE_SET_DISPLAY "SetDisplay"
+// SetTklock (s mode), emits the MCE touchscreen lock mode signal
+#define FAKE_MCE_SET_TKLOCK "SetTklock"
+// GetKeepalives () -> (u count, x last), last is when the last blank pause
+// request arrived, in CLOCK_MONOTONIC microseconds (0 if none did)
+#define FAKE_MCE_GET_KEEPALIVES "GetKeepalives"
+// GetCancels () -> (u count), blank pause cancel requests received
+#define FAKE_MCE_GET_CANCELS "GetCancels"
+// Reset (), forgets about the received blank pause (and cancel) requests
+#define FAKE_MCE_RESET "Reset"
+// Quit (), replies and releases the MCE name, like a stopped MCE would
+#define FAKE_MCE_QUIT "Quit"
+
+#endif // FAKE_MCE_H
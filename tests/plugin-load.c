@@ -0,0 +1,95 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Measures how long the dynamic linker takes to load the plugin (used by
+// "make measure" in ../src). It's linked with the libraries hildon-desktop
+// already has loaded, so only the plugin itself is measured. The plugin is
+// not initialized, nothing else than the dlopen () happens.
+//
+// Usage: plugin-load [PLUGIN]
+
+#define _POSIX_C_SOURCE 199309L // for clock_gettime ()
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <libhildondesktop/libhildondesktop.h>
+
+#define PLUGIN_PATH "../src/lib-displayblanking-status-menu.so"
+#define LOADS 200
+
+static gint64
+now (void)
+{
+    struct timespec ts;
+    int r = clock_gettime (CLOCK_MONOTONIC, &ts);
+    g_assert (r == 0);
+    return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+// Loads and unloads the plugin LOADS times, the first load is reported
+// apart since the file pages might not be cached yet
+static void
+measure (const char *path, int mode, const char *mode_name)
+{
+    gint64 first = 0, min = G_MAXINT64, total = 0;
+
+    for (int i = 0; i <= LOADS; i++) {
+        gint64 start = now ();
+        void *handle = dlopen (path, mode | RTLD_LOCAL);
+        gint64 elapsed = now () - start;
+        if (handle == NULL) {
+            fprintf (stderr, "Can't load %s: %s\n", path, dlerror ());
+            exit (EXIT_FAILURE);
+        }
+        dlclose (handle);
+
+        if (i == 0) {
+            first = elapsed;
+            continue;
+        }
+        min = MIN (min, elapsed);
+        total += elapsed;
+    }
+
+    printf ("dlopen %s: first %" G_GINT64_FORMAT " us, min %" G_GINT64_FORMAT
+            " us, avg %" G_GINT64_FORMAT " us\n", mode_name, first, min,
+            total / LOADS);
+}
+
+int
+main (int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : PLUGIN_PATH;
+
+#if !GLIB_CHECK_VERSION (2, 36, 0)
+    g_type_init ();
+#endif
+    // makes sure the libraries are really loaded (not only linked)
+    g_assert (hd_status_menu_item_get_type () != 0);
+
+    // GModule binds all the symbols at load time unless
+    // G_MODULE_BIND_LAZY is used, both ways are measured
+    measure (path, RTLD_NOW, "RTLD_NOW");
+    measure (path, RTLD_LAZY, "RTLD_LAZY");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,203 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Active window tracking tests, they need an X server (run-tests starts
+// Xvfb). A second X connection plays the window manager, setting
+// _NET_ACTIVE_WINDOW and the WM_CLASS of the windows it creates, while the
+// GDK connection selects SubstructureRedirectMask on the root window like
+// hildon-desktop (which is the window manager too) does.
+
+#include <string.h>
+#include <gdk/gdk.h>
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+
+#include "active-window.h"
+#include "test-util.h"
+
+#define WM_MASK (SubstructureRedirectMask | SubstructureNotifyMask)
+
+typedef struct
+{
+    Display *wm; // the fake window manager connection
+    Display *display; // the GDK one
+    Window root;
+    Atom active_atom;
+    ActiveWindow *active;
+    guint notifications;
+    gchar *res_name;
+    gchar *res_class;
+} Fixture;
+
+static void
+on_notify (const gchar *res_name, const gchar *res_class, Fixture *f)
+{
+    f->notifications++;
+    g_free (f->res_name);
+    g_free (f->res_class);
+    f->res_name = g_strdup (res_name);
+    f->res_class = g_strdup (res_class);
+}
+
+static long
+get_root_mask (Fixture *f)
+{
+    XWindowAttributes attrs;
+    XGetWindowAttributes (f->display, f->root, &attrs);
+    return attrs.your_event_mask;
+}
+
+static void
+setup (Fixture *f, gconstpointer data)
+{
+    f->display = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+    f->root = GDK_ROOT_WINDOW ();
+    f->wm = XOpenDisplay (gdk_display_get_name (gdk_display_get_default ()));
+    g_assert (f->wm != NULL);
+    f->active_atom = XInternAtom (f->wm, "_NET_ACTIVE_WINDOW", False);
+    XDeleteProperty (f->wm, f->root, f->active_atom);
+    XSync (f->wm, False);
+
+    XSelectInput (f->display, f->root, get_root_mask (f) | WM_MASK);
+    f->notifications = 0;
+    f->res_name = f->res_class = NULL;
+    f->active = active_window_new ((ActiveWindowNotify) on_notify, f);
+    gdk_flush ();
+}
+
+static void
+teardown (Fixture *f, gconstpointer data)
+{
+    if (f->active != NULL)
+        active_window_free (f->active);
+    XSelectInput (f->display, f->root, get_root_mask (f) & ~WM_MASK);
+    gdk_flush ();
+    XCloseDisplay (f->wm);
+    g_free (f->res_name);
+    g_free (f->res_class);
+}
+
+static Window
+create_window (Fixture *f, const gchar *res_name, const gchar *res_class)
+{
+    Window window = XCreateSimpleWindow (f->wm, f->root, 0, 0, 10, 10, 0,
+            0, 0);
+    XClassHint hint = { (char *) res_name, (char *) res_class };
+    XSetClassHint (f->wm, window, &hint);
+    XSync (f->wm, False);
+
+    return window;
+}
+
+static void
+set_active (Fixture *f, Window window)
+{
+    XChangeProperty (f->wm, f->root, f->active_atom, XA_WINDOW, 32,
+            PropModeReplace, (unsigned char *) &window, 1);
+    XSync (f->wm, False);
+}
+
+static gboolean
+got_notifications (Fixture *f)
+{
+    return f->notifications >= 2;
+}
+
+static void
+wait_notification (Fixture *f)
+{
+    f->notifications = 1;
+    g_assert (test_wait_for ((TestCondition) got_notifications, f,
+                TEST_TIMEOUT));
+    // the events of the new active window are selected by now
+    gdk_flush ();
+}
+
+static void
+test_root_mask (Fixture *f, gconstpointer data)
+{
+    // the window manager events are still selected
+    long mask = get_root_mask (f);
+    g_assert_cmpint (mask & WM_MASK, ==, WM_MASK);
+    g_assert_cmpint (mask & PropertyChangeMask, ==, PropertyChangeMask);
+
+    // and only what was added is removed
+    active_window_free (f->active);
+    f->active = NULL;
+    mask = get_root_mask (f);
+    g_assert_cmpint (mask & WM_MASK, ==, WM_MASK);
+    g_assert_cmpint (mask & PropertyChangeMask, ==, 0);
+}
+
+static void
+test_changes (Fixture *f, gconstpointer data)
+{
+    // called once from active_window_new ()
+    g_assert_cmpuint (f->notifications, ==, 1);
+    g_assert (f->res_name == NULL && f->res_class == NULL);
+
+    Window foo = create_window (f, "foo", "Foo");
+    set_active (f, foo);
+    wait_notification (f);
+    g_assert_cmpstr (f->res_name, ==, "foo");
+    g_assert_cmpstr (f->res_class, ==, "Foo");
+
+    // the class is watched too, some toolkits set it late
+    XClassHint hint = { "bar", "Bar" };
+    XSetClassHint (f->wm, foo, &hint);
+    XSync (f->wm, False);
+    wait_notification (f);
+    g_assert_cmpstr (f->res_name, ==, "bar");
+
+    Window baz = create_window (f, "baz", "Baz");
+    set_active (f, baz);
+    wait_notification (f);
+    g_assert_cmpstr (f->res_class, ==, "Baz");
+
+    set_active (f, None);
+    wait_notification (f);
+    g_assert (f->res_name == NULL && f->res_class == NULL);
+
+    XDestroyWindow (f->wm, foo);
+    XDestroyWindow (f->wm, baz);
+}
+
+static void
+add (const gchar *path, void (*test) (Fixture *, gconstpointer))
+{
+    g_test_add (path, Fixture, NULL, setup, test, teardown);
+}
+
+int
+main (int argc, char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+    if (!gdk_init_check (&argc, &argv)) {
+        g_message ("No X display, skipping the active window tests");
+        return 0;
+    }
+
+    add ("/active-window/root-mask", test_root_mask);
+    add ("/active-window/changes", test_changes);
+
+    return g_test_run ();
+}
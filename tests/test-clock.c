@@ -0,0 +1,135 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+#define _GNU_SOURCE // for syscall ()
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+
+#include "test-clock.h"
+
+typedef struct
+{
+    int64_t offset; // both clocks, in seconds
+    int64_t wall_offset; // only the wall clock, in seconds
+} Offsets;
+
+static Offsets own = { 0, 0 };
+// in the shared file once test_clock_share () is called
+static Offsets *offsets = &own;
+
+static int64_t
+get_offset (clockid_t id)
+{
+    if (id == CLOCK_MONOTONIC)
+        return offsets->offset;
+    if (id == CLOCK_REALTIME)
+        return offsets->offset + offsets->wall_offset;
+
+    // CPU time and such are left alone
+    return 0;
+}
+
+int
+clock_gettime (clockid_t id, struct timespec *ts)
+{
+    // the real one can't be called by name, it's this one
+    int r = syscall (SYS_clock_gettime, id, ts);
+    if (r == 0)
+        ts->tv_sec += get_offset (id);
+
+    return r;
+}
+
+#if defined (__GLIBC__) \
+        && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 31))
+int
+gettimeofday (struct timeval *tv, void *tz)
+#else
+int
+gettimeofday (struct timeval *tv, __timezone_ptr_t tz)
+#endif
+{
+    int r = syscall (SYS_gettimeofday, tv, tz);
+    if (r == 0)
+        tv->tv_sec += get_offset (CLOCK_REALTIME);
+
+    return r;
+}
+
+time_t
+time (time_t *t)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_REALTIME, &ts);
+    if (t != NULL)
+        *t = ts.tv_sec;
+
+    return ts.tv_sec;
+}
+
+void
+test_clock_advance (unsigned int seconds)
+{
+    offsets->offset += seconds;
+}
+
+void
+test_clock_jump_wall (int seconds)
+{
+    offsets->wall_offset += seconds;
+}
+
+int
+test_clock_share (const char *path)
+{
+    int fd = open (path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+        return -1;
+
+    // a new file is all zeros, the clocks are the real ones
+    void *map = MAP_FAILED;
+    if (ftruncate (fd, sizeof (Offsets)) == 0)
+        map = mmap (NULL, sizeof (Offsets), PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED)
+        return -1;
+
+    offsets = map;
+
+    return 0;
+}
+
+// When preloaded (libtest-clock.so) into a program that knows nothing
+// about it
+static void __attribute__ ((constructor))
+share_from_env (void)
+{
+    const char *path = getenv (TEST_CLOCK_ENV);
+    if (path != NULL)
+        test_clock_share (path);
+}
@@ -0,0 +1,54 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Virtual clock for the tests. test-clock.o replaces the C library
+// clock_gettime (), gettimeofday () and time (), adding an offset the tests
+// move forward, so timers of minutes can be tested in no time. The
+// programs must be linked with -rdynamic, so GLib (and its main loop
+// timeouts) use it too. It only knows about plain C types, since it's
+// below GLib.
+//
+// The main loop has to run after moving the clock for the timers that
+// expired to be dispatched. Pending D-Bus calls time out too if the clock
+// is moved past their timeout, so it should only be moved when idle.
+//
+// Other processes, like the daemon, can share the clock: they are started
+// with libtest-clock.so in LD_PRELOAD and the file the test shares in
+// $TEST_CLOCK. Their main loops only see the clock moved once they wake
+// up, a D-Bus call does it.
+
+#ifndef TEST_CLOCK_H
+#define TEST_CLOCK_H
+
+// The file of the shared clock, for the preloaded programs
+#define TEST_CLOCK_ENV "TEST_CLOCK"
+
+// Moves the monotonic and the wall clocks forward, as if time passed
+void test_clock_advance (unsigned int seconds);
+
+// Moves only the wall clock, as if the user or the network changed it
+void test_clock_jump_wall (int seconds);
+
+// Keeps the clock in the file at path from now on, so every process
+// sharing it sees the same time. A new file starts at the real time.
+// Returns -1 (and sets errno) if the file can't be used.
+int test_clock_share (const char *path);
+
+#endif // TEST_CLOCK_H
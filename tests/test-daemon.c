@@ -0,0 +1,610 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Inhibition daemon tests, through its session bus interface. Clients are
+// private connections, so closing one is like its process going away (as
+// when hildon-desktop is restarted). The soak test checks the daemon
+// doesn't leak over many inhibitions and keeps its journal consistent. The
+// power policy is tested against the fake BME, and the face down
+// suspension with a file standing in for the accelerometer.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "inhibit-engine.h"
+#include "journal.h"
+#include "sadba-dbus.h"
+#include "test-util.h"
+
+// enough to wrap the journal around
+#define SOAK_CYCLES (JOURNAL_CAPACITY + 100)
+#define SOAK_WARMUP 100
+// allocator noise, in KiB
+#define MAX_RSS_GROWTH 256
+// a mode that never blanks the display, it's recorded in the journal
+#define MODE_ONLY_DIMMING 4
+
+// the power policy keys, as in sadbad.c
+#define CHARGER_GCONF_KEY   "/apps/Maemo/sadba/inhibit_on_charger"
+#define THRESHOLD_GCONF_KEY "/apps/Maemo/sadba/battery_threshold"
+#define THRESHOLD 10 // in percent
+// in BME "bars", 1 is above the threshold and 0 below
+#define BARS 8
+
+// the orientation keys, as in sadbad.c
+#define UPRIGHT_GCONF_KEY "/apps/Maemo/sadba/inhibit_only_upright"
+#define ACCELEROMETER_ENV "SADBA_ACCELEROMETER"
+// gravity on the z axis, in mG
+#define FACE_UP   -1000
+#define FACE_DOWN 1000
+// the longest sampling interval while face down, in seconds
+#define FACE_DOWN_INTERVAL 2
+
+typedef struct
+{
+    GPid daemon;
+    GConfClient *gconf_client; // only for the power and orientation tests
+    gchar *accelerometer; // only for the orientation tests
+} Fixture;
+
+static void
+setup (Fixture *f, gconstpointer data)
+{
+    fake_mce_start ();
+    f->daemon = test_daemon_start ();
+}
+
+static void
+teardown (Fixture *f, gconstpointer data)
+{
+    test_daemon_stop (f->daemon);
+    fake_mce_stop ();
+}
+
+// BME is there before the daemon, so its status request is answered
+static void
+setup_power (Fixture *f, gconstpointer data)
+{
+    f->gconf_client = gconf_client_get_default ();
+    gconf_client_set_bool (f->gconf_client, CHARGER_GCONF_KEY, TRUE, NULL);
+    gconf_client_set_int (f->gconf_client, THRESHOLD_GCONF_KEY, THRESHOLD,
+            NULL);
+    fake_bme_start ();
+    setup (f, data);
+}
+
+static void
+teardown_power (Fixture *f, gconstpointer data)
+{
+    teardown (f, data);
+    fake_bme_stop ();
+    gconf_client_unset (f->gconf_client, CHARGER_GCONF_KEY, NULL);
+    gconf_client_unset (f->gconf_client, THRESHOLD_GCONF_KEY, NULL);
+    g_object_unref (f->gconf_client);
+}
+
+static DBusConnection *
+client_new (void)
+{
+    DBusError error;
+    dbus_error_init (&error);
+
+    DBusConnection *conn = dbus_bus_get_private (DBUS_BUS_SESSION, &error);
+    if (conn == NULL)
+        g_error ("Can't connect to the test session bus: %s", error.message);
+    dbus_connection_set_exit_on_disconnect (conn, FALSE);
+
+    return conn;
+}
+
+static gboolean
+name_gone (const gchar *name)
+{
+    return !dbus_bus_name_has_owner (test_system_bus (), name, NULL);
+}
+
+// Once the name is gone the daemon got its NameOwnerChanged signal, before
+// any later call
+static void
+client_free (DBusConnection *conn)
+{
+    gchar *name = g_strdup (dbus_bus_get_unique_name (conn));
+
+    dbus_connection_close (conn);
+    dbus_connection_unref (conn);
+    g_assert (test_wait_for ((TestCondition) name_gone, name, TEST_TIMEOUT));
+    g_free (name);
+}
+
+// Blocking call to the daemon, the arguments are like in
+// dbus_message_append_args (), returns the error name or NULL on success
+static gchar *
+sadba_call (DBusConnection *conn, DBusMessage **reply, const gchar *method,
+        int first_arg_type, ...)
+{
+    DBusMessage *msg = dbus_message_new_method_call (SADBA_SERVICE,
+            SADBA_PATH, SADBA_INTERFACE, method);
+    g_assert (msg != NULL);
+
+    va_list args;
+    va_start (args, first_arg_type);
+    dbus_message_append_args_valist (msg, first_arg_type, args);
+    va_end (args);
+
+    DBusError error;
+    dbus_error_init (&error);
+    DBusMessage *r = dbus_connection_send_with_reply_and_block (conn, msg,
+            TEST_TIMEOUT, &error);
+    dbus_message_unref (msg);
+
+    if (r == NULL) {
+        gchar *name = g_strdup (error.name);
+        dbus_error_free (&error);
+        return name;
+    }
+
+    if (reply != NULL)
+        *reply = r;
+    else
+        dbus_message_unref (r);
+
+    return NULL;
+}
+
+static guint
+inhibit (DBusConnection *conn, const gchar *method, const gchar *reason,
+        guint timeout)
+{
+    DBusMessage *reply;
+    dbus_uint32_t t = timeout, cookie = 0;
+
+    g_assert (sadba_call (conn, &reply, method, DBUS_TYPE_STRING, &reason,
+                DBUS_TYPE_UINT32, &t, DBUS_TYPE_INVALID) == NULL);
+    g_assert (dbus_message_get_args (reply, NULL, DBUS_TYPE_UINT32, &cookie,
+                DBUS_TYPE_INVALID));
+    dbus_message_unref (reply);
+    g_assert_cmpuint (cookie, !=, 0);
+
+    return cookie;
+}
+
+static gchar *
+release (DBusConnection *conn, guint cookie)
+{
+    dbus_uint32_t c = cookie;
+    return sadba_call (conn, NULL, SADBA_RELEASE, DBUS_TYPE_UINT32, &c,
+            DBUS_TYPE_INVALID);
+}
+
+static guint
+reclaim (DBusConnection *conn, const gchar *reason, guint *timeout)
+{
+    DBusMessage *reply;
+    dbus_uint32_t cookie, t;
+
+    g_assert (sadba_call (conn, &reply, SADBA_RECLAIM, DBUS_TYPE_STRING,
+                &reason, DBUS_TYPE_INVALID) == NULL);
+    g_assert (dbus_message_get_args (reply, NULL, DBUS_TYPE_UINT32, &cookie,
+                DBUS_TYPE_UINT32, &t, DBUS_TYPE_INVALID));
+    dbus_message_unref (reply);
+    if (timeout != NULL)
+        *timeout = t;
+
+    return cookie;
+}
+
+static InhibitEngineState
+get_state (void)
+{
+    DBusConnection *conn = client_new ();
+    DBusMessage *reply;
+    dbus_uint32_t state, remaining;
+
+    g_assert (sadba_call (conn, &reply, SADBA_GET_STATE,
+                DBUS_TYPE_INVALID) == NULL);
+    g_assert (dbus_message_get_args (reply, NULL, DBUS_TYPE_UINT32, &state,
+                DBUS_TYPE_UINT32, &remaining, DBUS_TYPE_INVALID));
+    dbus_message_unref (reply);
+    client_free (conn);
+
+    return state;
+}
+
+static void
+test_owned (Fixture *f, gconstpointer data)
+{
+    DBusConnection *a = client_new ();
+    DBusConnection *b = client_new ();
+
+    guint cookie = inhibit (a, SADBA_INHIBIT, "test", 0);
+    g_assert_cmpint (get_state (), ==, INHIBIT_ENGINE_MANUAL);
+
+    // only the owner can release it
+    gchar *error = release (b, cookie);
+    g_assert_cmpstr (error, ==, SADBA_ERROR_UNKNOWN_COOKIE);
+    g_free (error);
+
+    // or leaving the bus
+    client_free (a);
+    g_assert_cmpint (get_state (), ==, INHIBIT_ENGINE_OFF);
+    client_free (b);
+}
+
+// The status menu inhibition survives a desktop restart, and the restarted
+// plugin can take it back
+static void
+test_persistent (Fixture *f, gconstpointer data)
+{
+    DBusConnection *desktop = client_new ();
+    guint cookie = inhibit (desktop, SADBA_INHIBIT_PERSISTENT, "menu", 0);
+    client_free (desktop);
+    g_assert_cmpint (get_state (), ==, INHIBIT_ENGINE_MANUAL);
+
+    desktop = client_new ();
+    guint timeout;
+    g_assert_cmpuint (reclaim (desktop, "other", NULL), ==, 0);
+    g_assert_cmpuint (reclaim (desktop, "menu", &timeout), ==, cookie);
+    g_assert_cmpuint (timeout, ==, 0);
+
+    g_assert (release (desktop, cookie) == NULL);
+    g_assert_cmpint (get_state (), ==, INHIBIT_ENGINE_OFF);
+    g_assert_cmpuint (reclaim (desktop, "menu", NULL), ==, 0);
+    client_free (desktop);
+}
+
+// A desktop restart while a timed inhibition was replacing a manual one
+// leaves both behind, the newest wins
+static void
+test_persistent_superseded (Fixture *f, gconstpointer data)
+{
+    DBusConnection *desktop = client_new ();
+    guint old = inhibit (desktop, SADBA_INHIBIT_PERSISTENT, "menu", 0);
+    guint new = inhibit (desktop, SADBA_INHIBIT_PERSISTENT, "menu", 600);
+    client_free (desktop);
+    g_assert_cmpint (get_state (), ==, INHIBIT_ENGINE_MANUAL);
+
+    desktop = client_new ();
+    guint timeout;
+    g_assert_cmpuint (reclaim (desktop, "menu", &timeout), ==, new);
+    g_assert_cmpuint (timeout, >, 590);
+    g_assert_cmpuint (timeout, <=, 600);
+    g_assert_cmpint (get_state (), ==, INHIBIT_ENGINE_TIMED);
+
+    gchar *error = release (desktop, old);
+    g_assert_cmpstr (error, ==, SADBA_ERROR_UNKNOWN_COOKIE);
+    g_free (error);
+    g_assert (release (desktop, new) == NULL);
+    g_assert_cmpint (get_state (), ==, INHIBIT_ENGINE_OFF);
+    client_free (desktop);
+}
+
+// The accelerometer is a scratch file, "x y z" in mG
+static void
+set_accelerometer (Fixture *f, gint z)
+{
+    gchar *sample = g_strdup_printf ("0 0 %d\n", z);
+    g_assert (g_file_set_contents (f->accelerometer, sample, -1, NULL));
+    g_free (sample);
+}
+
+static void
+setup_orientation (Fixture *f, gconstpointer data)
+{
+    f->gconf_client = gconf_client_get_default ();
+    gconf_client_set_bool (f->gconf_client, UPRIGHT_GCONF_KEY, TRUE, NULL);
+    f->accelerometer = g_build_filename (g_get_tmp_dir (),
+            "sadba-test-accelerometer", NULL);
+    set_accelerometer (f, FACE_UP);
+    // the daemon inherits it
+    g_setenv (ACCELEROMETER_ENV, f->accelerometer, TRUE);
+    setup (f, data);
+}
+
+static void
+teardown_orientation (Fixture *f, gconstpointer data)
+{
+    teardown (f, data);
+    g_unsetenv (ACCELEROMETER_ENV);
+    g_unlink (f->accelerometer);
+    g_free (f->accelerometer);
+    gconf_client_unset (f->gconf_client, UPRIGHT_GCONF_KEY, NULL);
+    g_object_unref (f->gconf_client);
+}
+
+static gboolean
+got_cancel (gpointer data)
+{
+    return fake_mce_get_cancels () > 0;
+}
+
+static gboolean
+got_keepalive (gpointer data)
+{
+    return fake_mce_get_keepalives (NULL) > 0;
+}
+
+// Face down the keepalives stop and the blank pause is cancelled, so the
+// display blanks on its own timeouts, picking the device up brings them
+// back. The daemon samples every second after it moves, and at least
+// every FACE_DOWN_INTERVAL seconds while face down.
+static void
+test_face_down (Fixture *f, gconstpointer data)
+{
+    DBusConnection *client = client_new ();
+    guint cookie = inhibit (client, SADBA_INHIBIT, "test", 0);
+    g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+
+    set_accelerometer (f, FACE_DOWN);
+    g_assert (test_wait_for (got_cancel, NULL, TEST_TIMEOUT));
+    fake_mce_reset ();
+    g_assert_cmpint (get_state (), ==, INHIBIT_ENGINE_MANUAL);
+
+    // still face down, it keeps sampling but doesn't send anything
+    test_run_for (FACE_DOWN_INTERVAL * 1000 + 500);
+    g_assert_cmpuint (fake_mce_get_keepalives (NULL), ==, 0);
+    g_assert_cmpuint (fake_mce_get_cancels (), ==, 0);
+
+    gint64 start = test_monotonic_time ();
+    set_accelerometer (f, FACE_UP);
+    g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+    // timers of whole seconds can fire up to a second late
+    g_assert_cmpint (test_monotonic_time () - start, <,
+            (FACE_DOWN_INTERVAL + 2) * G_USEC_PER_SEC);
+    g_assert_cmpuint (fake_mce_get_cancels (), ==, 0);
+
+    g_assert (release (client, cookie) == NULL);
+    client_free (client);
+}
+
+// The daemon sees the BME signals before a later call, since they were
+// sent before the fake BME replied, but the state is polled anyway
+static gboolean
+state_is (gpointer state)
+{
+    return get_state () == GPOINTER_TO_UINT (state);
+}
+
+// Plugged in, the daemon inhibits on its own, along with the clients
+static void
+test_charger (Fixture *f, gconstpointer data)
+{
+    g_assert_cmpint (get_state (), ==, INHIBIT_ENGINE_OFF);
+
+    fake_bme_set_charger (TRUE);
+    g_assert (test_wait_for (state_is,
+                GUINT_TO_POINTER (INHIBIT_ENGINE_MANUAL), TEST_TIMEOUT));
+
+    // a client coming and going doesn't take the charger one away
+    DBusConnection *client = client_new ();
+    guint cookie = inhibit (client, SADBA_INHIBIT, "test", 0);
+    g_assert (release (client, cookie) == NULL);
+    g_assert_cmpint (get_state (), ==, INHIBIT_ENGINE_MANUAL);
+    client_free (client);
+
+    fake_bme_set_charger (FALSE);
+    g_assert (test_wait_for (state_is, GUINT_TO_POINTER (INHIBIT_ENGINE_OFF),
+                TEST_TIMEOUT));
+}
+
+// Getting below the threshold cancels everything, and no new inhibitions
+// are taken until the charger is connected
+static void
+test_battery_low (Fixture *f, gconstpointer data)
+{
+    DBusConnection *client = client_new ();
+    inhibit (client, SADBA_INHIBIT, "test", 0);
+
+    // 12% is still fine
+    fake_bme_set_battery (1, BARS);
+    g_assert_cmpint (get_state (), ==, INHIBIT_ENGINE_MANUAL);
+
+    fake_bme_set_battery (0, BARS);
+    g_assert (test_wait_for (state_is, GUINT_TO_POINTER (INHIBIT_ENGINE_OFF),
+                TEST_TIMEOUT));
+
+    const gchar *reason = "test";
+    dbus_uint32_t timeout = 0;
+    gchar *error = sadba_call (client, NULL, SADBA_INHIBIT, DBUS_TYPE_STRING,
+            &reason, DBUS_TYPE_UINT32, &timeout, DBUS_TYPE_INVALID);
+    g_assert_cmpstr (error, ==, SADBA_ERROR_BATTERY_LOW);
+    g_free (error);
+    g_assert_cmpint (get_state (), ==, INHIBIT_ENGINE_OFF);
+
+    // plugged in the battery is no longer low, and the charger inhibits
+    fake_bme_set_charger (TRUE);
+    g_assert (test_wait_for (state_is,
+                GUINT_TO_POINTER (INHIBIT_ENGINE_MANUAL), TEST_TIMEOUT));
+    inhibit (client, SADBA_INHIBIT, "test", 0);
+
+    // unplugged it's crossed again, the client inhibition goes too
+    fake_bme_set_charger (FALSE);
+    g_assert (test_wait_for (state_is, GUINT_TO_POINTER (INHIBIT_ENGINE_OFF),
+                TEST_TIMEOUT));
+    client_free (client);
+}
+
+static void
+set_mode (DBusConnection *conn, gint mode)
+{
+    dbus_int32_t m = mode;
+    g_assert (sadba_call (conn, NULL, SADBA_SET_MODE, DBUS_TYPE_INT32, &m,
+                DBUS_TYPE_INVALID) == NULL);
+}
+
+typedef struct
+{
+    guint records;
+    guint modes; // mode records
+    guint unfinished; // inhibition records
+    guint32 max_keepalives; // in an inhibition record
+} JournalSummary;
+
+static void
+summarize_record (const JournalRecord *record, JournalSummary *s)
+{
+    s->records++;
+    if (record->trigger == JOURNAL_TRIGGER_MODE) {
+        s->modes++;
+        return;
+    }
+    if (record->end == 0)
+        s->unfinished++;
+    s->max_keepalives = MAX (s->max_keepalives, record->keepalives);
+}
+
+static void
+summarize_journal (JournalSummary *s)
+{
+    GError *error = NULL;
+    gchar *path = journal_default_path ();
+    Journal *journal = journal_open (path, FALSE, &error);
+    g_free (path);
+    g_assert_no_error (error);
+
+    memset (s, 0, sizeof (JournalSummary));
+    journal_foreach (journal, (JournalFunc) summarize_record, s);
+    journal_close (journal);
+}
+
+static gboolean
+got_mode_record (gpointer modes)
+{
+    JournalSummary s;
+    summarize_journal (&s);
+
+    return s.modes > GPOINTER_TO_UINT (modes);
+}
+
+// The daemon gets the mode from GConf, so it notices the changes later,
+// and only sees the last one if they come together. The end of a session
+// is not always recorded, the daemon is given some time to see it.
+static void
+start_mode_session (DBusConnection *conn)
+{
+    JournalSummary s;
+    summarize_journal (&s);
+
+    set_mode (conn, 0);
+    test_run_for (200);
+    set_mode (conn, MODE_ONLY_DIMMING);
+    g_assert (test_wait_for (got_mode_record, GUINT_TO_POINTER (s.modes),
+                TEST_TIMEOUT));
+}
+
+typedef struct
+{
+    guint fds;
+    glong rss; // in KiB
+} Usage;
+
+static void
+get_daemon_usage (GPid pid, Usage *u)
+{
+    gchar *path = g_strdup_printf ("/proc/%d/fd", (int) pid);
+    GDir *dir = g_dir_open (path, 0, NULL);
+    g_free (path);
+    g_assert (dir != NULL);
+    u->fds = 0;
+    while (g_dir_read_name (dir) != NULL)
+        u->fds++;
+    g_dir_close (dir);
+
+    u->rss = 0;
+    gchar *status;
+    path = g_strdup_printf ("/proc/%d/status", (int) pid);
+    g_assert (g_file_get_contents (path, &status, NULL, NULL));
+    g_free (path);
+    const gchar *rss = strstr (status, "VmRSS:");
+    if (rss != NULL)
+        sscanf (rss, "VmRSS: %ld kB", &u->rss);
+    g_free (status);
+}
+
+static void
+soak_cycle (DBusConnection *conn)
+{
+    guint cookie = inhibit (conn, SADBA_INHIBIT, "soak", 0);
+    g_assert (release (conn, cookie) == NULL);
+}
+
+// A blanking mode session lasts while many inhibitions come and go, its
+// record is overwritten by them before it ends
+static void
+test_soak (Fixture *f, gconstpointer data)
+{
+    DBusConnection *client = client_new ();
+    Usage warm, after;
+
+    start_mode_session (client);
+    for (int i = 0; i < SOAK_WARMUP; i++)
+        soak_cycle (client);
+    get_daemon_usage (f->daemon, &warm);
+
+    for (int i = 0; i < SOAK_CYCLES; i++)
+        soak_cycle (client);
+    get_daemon_usage (f->daemon, &after);
+    g_test_message ("%d cycles: %+d descriptors, %+ld KiB RSS", SOAK_CYCLES,
+            (gint) (after.fds - warm.fds), after.rss - warm.rss);
+    g_assert_cmpuint (after.fds, ==, warm.fds);
+    g_assert_cmpint (after.rss - warm.rss, <, MAX_RSS_GROWTH);
+
+    // ends the old mode session, which must not touch the inhibition
+    // record that took its place
+    start_mode_session (client);
+    JournalSummary s;
+    summarize_journal (&s);
+    g_assert_cmpuint (s.records, ==, JOURNAL_CAPACITY);
+    g_assert_cmpuint (s.modes, ==, 1);
+    g_assert_cmpuint (s.unfinished, ==, 0);
+    g_assert_cmpuint (s.max_keepalives, <=, 2);
+
+    set_mode (client, 0);
+    client_free (client);
+}
+
+static void
+add (const gchar *path, void (*test) (Fixture *, gconstpointer))
+{
+    g_test_add (path, Fixture, NULL, setup, test, teardown);
+}
+
+int
+main (int argc, char *argv[])
+{
+#if !GLIB_CHECK_VERSION (2, 36, 0)
+    g_type_init ();
+#endif
+    g_test_init (&argc, &argv, NULL);
+
+    add ("/daemon/owned", test_owned);
+    add ("/daemon/persistent", test_persistent);
+    add ("/daemon/persistent-superseded", test_persistent_superseded);
+    add ("/daemon/soak", test_soak);
+    g_test_add ("/daemon/face-down", Fixture, NULL, setup_orientation,
+            test_face_down, teardown_orientation);
+    g_test_add ("/daemon/charger", Fixture, NULL, setup_power, test_charger,
+            teardown_power);
+    g_test_add ("/daemon/battery-low", Fixture, NULL, setup_power,
+            test_battery_low, teardown_power);
+
+    return g_test_run ();
+}
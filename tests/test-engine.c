@@ -0,0 +1,502 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Inhibition engine tests, against the fake MCE. The keepalive spacing is
+// checked on the virtual clock. The performance tests (run with -m perf)
+// measure what a state transition costs.
+
+#include <mce/mode-names.h>
+
+#include "inhibit-engine.h"
+#include "test-clock.h"
+#include "test-util.h"
+
+#define PERF_TRANSITIONS 10000
+#define LATENCY_SAMPLES 20
+// from a new MCE to its first keepalive, in seconds, spawning it included.
+// The engine must not wait for its next keepalive (30 s at least).
+#define MAX_RESTART_LATENCY 0.5
+
+typedef struct
+{
+    GConfClient *gconf_client;
+    InhibitEngine *engine;
+    guint notifications;
+    InhibitEngineState state; // last notified
+    InhibitEngineReason reason;
+    // the dim and blank timeouts before the test changed them, < 0 if it
+    // didn't
+    gint dim_timeout;
+    gint blank_timeout;
+    guint interval; // what set_timeouts () waits for
+} Fixture;
+
+static void
+on_notify (InhibitEngine *engine, InhibitEngineState state,
+        InhibitEngineReason reason, Fixture *f)
+{
+    f->notifications++;
+    f->state = state;
+    f->reason = reason;
+}
+
+static void
+setup (Fixture *f, gconstpointer data)
+{
+    fake_mce_start ();
+    f->gconf_client = gconf_client_get_default ();
+    f->engine = inhibit_engine_new (test_system_bus (), f->gconf_client,
+            (InhibitEngineNotify) on_notify, f);
+    f->notifications = 0;
+    f->dim_timeout = f->blank_timeout = -1;
+    // the initial MCE state queries
+    test_run_for (50);
+}
+
+static void
+teardown (Fixture *f, gconstpointer data)
+{
+    inhibit_engine_free (f->engine);
+    if (f->dim_timeout >= 0) {
+        gconf_client_set_int (f->gconf_client, DIM_TIMEOUT_GCONF_KEY,
+                f->dim_timeout, NULL);
+        gconf_client_set_int (f->gconf_client, BLANK_TIMEOUT_GCONF_KEY,
+                f->blank_timeout, NULL);
+    }
+    g_object_unref (f->gconf_client);
+    fake_mce_stop ();
+}
+
+static gboolean
+got_keepalive (gpointer data)
+{
+    return fake_mce_get_keepalives (NULL) > 0;
+}
+
+static gboolean
+got_notification (Fixture *f)
+{
+    return f->notifications > 0;
+}
+
+static void
+test_manual (Fixture *f, gconstpointer data)
+{
+    inhibit_engine_inhibit (f->engine, 0);
+    g_assert_cmpuint (f->notifications, ==, 1);
+    g_assert_cmpint (f->state, ==, INHIBIT_ENGINE_MANUAL);
+    g_assert_cmpint (f->reason, ==, INHIBIT_ENGINE_REASON_REQUEST);
+    g_assert_cmpuint (inhibit_engine_get_remaining (f->engine), ==, 0);
+    g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+
+    g_assert (inhibit_engine_release (f->engine,
+                INHIBIT_ENGINE_REASON_REQUEST, NULL));
+    g_assert_cmpuint (f->notifications, ==, 2);
+    g_assert_cmpint (f->state, ==, INHIBIT_ENGINE_OFF);
+    g_assert_cmpint (inhibit_engine_get_state (f->engine), ==,
+            INHIBIT_ENGINE_OFF);
+}
+
+static void
+test_timed (Fixture *f, gconstpointer data)
+{
+    inhibit_engine_inhibit (f->engine, 1);
+    g_assert_cmpint (f->state, ==, INHIBIT_ENGINE_TIMED);
+    g_assert_cmpuint (inhibit_engine_get_remaining (f->engine), <=, 1);
+    g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+
+    f->notifications = 0;
+    g_assert (test_wait_for ((TestCondition) got_notification, f,
+                TEST_TIMEOUT));
+    g_assert_cmpint (f->state, ==, INHIBIT_ENGINE_OFF);
+    g_assert_cmpint (f->reason, ==, INHIBIT_ENGINE_REASON_TIMEOUT);
+    g_assert_cmpuint (inhibit_engine_get_remaining (f->engine), ==, 0);
+}
+
+// Changing the timeout of an inhibition doesn't send a new keepalive
+static void
+test_retime (Fixture *f, gconstpointer data)
+{
+    inhibit_engine_inhibit (f->engine, 0);
+    inhibit_engine_inhibit (f->engine, 100);
+    g_assert_cmpint (f->state, ==, INHIBIT_ENGINE_TIMED);
+    g_assert_cmpuint (inhibit_engine_get_remaining (f->engine), >, 90);
+    inhibit_engine_inhibit (f->engine, 0);
+    g_assert_cmpint (f->state, ==, INHIBIT_ENGINE_MANUAL);
+
+    test_run_for (100);
+    g_assert_cmpuint (fake_mce_get_keepalives (NULL), ==, 1);
+}
+
+// From the inhibit request to MCE getting the blank pause request, which
+// must not wait for the MCE reply
+static void
+test_keepalive_latency (Fixture *f, gconstpointer data)
+{
+    gint64 delivery_total = 0, delivery_max = 0, call_max = 0;
+    InhibitEngineStats stats;
+
+    for (guint i = 1; i <= LATENCY_SAMPLES; i++) {
+        gint64 start = test_monotonic_time ();
+        inhibit_engine_inhibit (f->engine, 0);
+        call_max = MAX (call_max, test_monotonic_time () - start);
+
+        gint64 last;
+        g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+        g_assert_cmpuint (fake_mce_get_keepalives (&last), ==, 1);
+        g_assert_cmpint (last, >=, start);
+        delivery_total += last - start;
+        delivery_max = MAX (delivery_max, last - start);
+
+        // MCE replied before answering us, so the reply is queued already
+        test_flush ();
+        inhibit_engine_get_stats (f->engine, &stats);
+        g_assert_cmpint (stats.last_latency, >, 0);
+        g_assert_cmpuint (stats.keepalives_sent, ==, i);
+
+        inhibit_engine_release (f->engine, INHIBIT_ENGINE_REASON_REQUEST,
+                NULL);
+        fake_mce_reset ();
+    }
+
+    g_test_message ("request to delivery: %.2f ms average, %.2f ms max; "
+            "inhibit call: %.2f ms max; keepalive round trip: %.2f ms max",
+            delivery_total / 1000.0 / LATENCY_SAMPLES, delivery_max / 1000.0,
+            call_max / 1000.0, stats.max_latency / 1000.0);
+    if (g_test_perf ())
+        g_test_minimized_result (delivery_total / 1000.0 / LATENCY_SAMPLES,
+                "request to delivery: %.2f ms",
+                delivery_total / 1000.0 / LATENCY_SAMPLES);
+}
+
+static void
+test_errors (Fixture *f, gconstpointer data)
+{
+    GError *error = NULL;
+
+    g_assert (!inhibit_engine_release (f->engine,
+                INHIBIT_ENGINE_REASON_REQUEST, &error));
+    g_assert_error (error, INHIBIT_ENGINE_ERROR,
+            INHIBIT_ENGINE_ERROR_NOT_INHIBITED);
+    g_clear_error (&error);
+
+    g_assert (!inhibit_engine_set_mode (f->engine, BLANKING_MODES, &error));
+    g_assert_error (error, INHIBIT_ENGINE_ERROR,
+            INHIBIT_ENGINE_ERROR_INVALID_MODE);
+    g_clear_error (&error);
+
+    g_assert_cmpuint (f->notifications, ==, 0);
+}
+
+// No keepalives while the display is off, one as soon as it's on again
+static void
+test_display_off (Fixture *f, gconstpointer data)
+{
+    fake_mce_set_display (MCE_DISPLAY_OFF_STRING);
+    inhibit_engine_inhibit (f->engine, 0);
+    test_run_for (100);
+    g_assert_cmpuint (fake_mce_get_keepalives (NULL), ==, 0);
+
+    // a dimmed display is still on
+    fake_mce_set_display (MCE_DISPLAY_DIM_STRING);
+    g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+}
+
+static void
+test_tklock (Fixture *f, gconstpointer data)
+{
+    fake_mce_set_tklock (MCE_TK_LOCKED);
+    inhibit_engine_inhibit (f->engine, 0);
+    test_run_for (100);
+    g_assert_cmpuint (fake_mce_get_keepalives (NULL), ==, 0);
+
+    fake_mce_set_tklock (MCE_TK_UNLOCKED);
+    g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+}
+
+static gboolean
+got_cancel (gpointer data)
+{
+    return fake_mce_get_cancels () > 0;
+}
+
+// The blank pause of the last keepalive is cancelled too, so the display
+// doesn't stay on for it
+static void
+test_suspend (Fixture *f, gconstpointer data)
+{
+    // nothing to cancel
+    inhibit_engine_suspend (f->engine, TRUE);
+    inhibit_engine_suspend (f->engine, FALSE);
+
+    inhibit_engine_inhibit (f->engine, 0);
+    g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+    g_assert_cmpuint (fake_mce_get_cancels (), ==, 0);
+    fake_mce_reset ();
+
+    inhibit_engine_suspend (f->engine, TRUE);
+    g_assert (test_wait_for (got_cancel, NULL, TEST_TIMEOUT));
+    test_run_for (100);
+    g_assert_cmpuint (fake_mce_get_keepalives (NULL), ==, 0);
+    g_assert_cmpuint (fake_mce_get_cancels (), ==, 1);
+    g_assert_cmpint (inhibit_engine_get_state (f->engine), ==,
+            INHIBIT_ENGINE_MANUAL);
+
+    inhibit_engine_suspend (f->engine, FALSE);
+    g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+    g_assert_cmpuint (fake_mce_get_cancels (), ==, 1);
+}
+
+// MCE forgets about the blank pause when it restarts, and it can't get
+// keepalives while it's gone
+static void
+test_mce_restart (Fixture *f, gconstpointer data)
+{
+    InhibitEngineStats before, after;
+
+    inhibit_engine_inhibit (f->engine, 0);
+    g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+    inhibit_engine_get_stats (f->engine, &before);
+
+    fake_mce_stop ();
+    test_run_for (100);
+    inhibit_engine_get_stats (f->engine, &after);
+    g_assert_cmpuint (after.keepalives_sent, ==, before.keepalives_sent);
+    g_assert_cmpint (inhibit_engine_get_state (f->engine), ==,
+            INHIBIT_ENGINE_MANUAL);
+
+    // a new fake MCE, with no keepalives yet
+    g_test_timer_start ();
+    fake_mce_start ();
+    g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+    gdouble elapsed = g_test_timer_elapsed ();
+    g_test_message ("restart to keepalive: %.2f ms", elapsed * 1000);
+    if (g_test_perf ())
+        g_test_minimized_result (elapsed * 1000,
+                "restart to keepalive: %.2f ms", elapsed * 1000);
+    g_assert_cmpfloat (elapsed, <, MAX_RESTART_LATENCY);
+    inhibit_engine_get_stats (f->engine, &after);
+    g_assert_cmpuint (after.mce_restarts, ==, before.mce_restarts + 1);
+    g_assert_cmpuint (after.keepalives_sent, >, before.keepalives_sent);
+}
+
+static gboolean
+got_interval (Fixture *f)
+{
+    InhibitEngineStats stats;
+    inhibit_engine_get_stats (f->engine, &stats);
+
+    return stats.keepalive_interval == f->interval;
+}
+
+// Sets the MCE timeouts and waits until the engine has the interval they
+// give, GConf notifies the engine later
+static void
+set_timeouts (Fixture *f, gint dim, gint blank, guint interval)
+{
+    if (f->dim_timeout < 0) {
+        f->dim_timeout = gconf_client_get_int (f->gconf_client,
+                DIM_TIMEOUT_GCONF_KEY, NULL);
+        f->blank_timeout = gconf_client_get_int (f->gconf_client,
+                BLANK_TIMEOUT_GCONF_KEY, NULL);
+    }
+
+    gconf_client_set_int (f->gconf_client, DIM_TIMEOUT_GCONF_KEY, dim, NULL);
+    gconf_client_set_int (f->gconf_client, BLANK_TIMEOUT_GCONF_KEY, blank,
+            NULL);
+    f->interval = interval;
+    g_assert (test_wait_for ((TestCondition) got_interval, f,
+                TEST_TIMEOUT));
+}
+
+static gboolean
+got_keepalives (gpointer n)
+{
+    return fake_mce_get_keepalives (NULL) >= GPOINTER_TO_UINT (n);
+}
+
+// Moves the clock and checks how many keepalives MCE got by then. The
+// timers of whole seconds can fire up to a second late.
+static void
+advance (guint seconds, guint keepalives)
+{
+    // the last keepalive reply would time out otherwise
+    test_flush ();
+    test_clock_advance (seconds);
+    if (keepalives > 0)
+        g_assert (test_wait_for (got_keepalives,
+                    GUINT_TO_POINTER (keepalives), TEST_TIMEOUT));
+    test_run_for (50);
+    g_assert_cmpuint (fake_mce_get_keepalives (NULL), ==, keepalives);
+}
+
+// The keepalives are as far apart as the dim/blank timeouts allow, MCE
+// keeps the display on for 60 seconds after each one, and 10 seconds are
+// left as a margin
+static void
+test_interval (Fixture *f, gconstpointer data)
+{
+    static const struct {
+        gint dim, blank;
+        guint interval;
+    } cases[] = {
+        { 30, 60, 80 },
+        { 120, 300, 170 },
+        { 300, 10, 60 }, // the lowest wins
+        { 0, 15, 65 }, // 0 is disabled
+        { 0, 0, 30 }, // the fixed heartbeat
+    };
+
+    for (int i = 0; i < G_N_ELEMENTS (cases); i++) {
+        set_timeouts (f, cases[i].dim, cases[i].blank, cases[i].interval);
+
+        inhibit_engine_inhibit (f->engine, 0);
+        g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+        // each one is counted from the previous one
+        for (guint n = 1; n <= 2; n++) {
+            advance (cases[i].interval - 1, n);
+            advance (2, n + 1);
+        }
+
+        inhibit_engine_release (f->engine, INHIBIT_ENGINE_REASON_REQUEST,
+                NULL);
+        fake_mce_reset ();
+    }
+}
+
+// The armed timer follows the timeouts when they change while inhibiting
+static void
+test_interval_change (Fixture *f, gconstpointer data)
+{
+    set_timeouts (f, 120, 300, 170);
+    inhibit_engine_inhibit (f->engine, 0);
+    g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+
+    // lower, the last keepalive is already too old, so it's sent now
+    advance (100, 1);
+    set_timeouts (f, 15, 300, 65);
+    g_assert (test_wait_for (got_keepalives, GUINT_TO_POINTER (2),
+                TEST_TIMEOUT));
+    advance (64, 2);
+    advance (2, 3);
+
+    // higher, the timer that was armed doesn't fire
+    advance (30, 3);
+    set_timeouts (f, 120, 300, 170);
+    advance (60, 3);
+    advance (82, 4);
+}
+
+// Compared to a keepalive every 30 seconds
+static void
+test_wakeups_saved (Fixture *f, gconstpointer data)
+{
+    InhibitEngineStats stats;
+
+    set_timeouts (f, 120, 300, 170);
+    inhibit_engine_inhibit (f->engine, 0);
+    g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+    advance (172, 2);
+    advance (172, 3);
+    inhibit_engine_release (f->engine, INHIBIT_ENGINE_REASON_REQUEST, NULL);
+
+    // 344 seconds (and a bit) need 11 heartbeats
+    inhibit_engine_get_stats (f->engine, &stats);
+    g_assert_cmpuint (stats.wakeups, ==, 2);
+    g_assert_cmpuint (stats.wakeups_saved, ==, 9);
+    g_assert_cmpuint (stats.keepalives_sent, ==, 3);
+}
+
+// Timed inhibitions report their keepalives, so a countdown can follow
+// them, manual ones don't
+static void
+test_keepalive_notify (Fixture *f, gconstpointer data)
+{
+    set_timeouts (f, 0, 0, 30);
+
+    inhibit_engine_inhibit (f->engine, 600);
+    g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+    f->notifications = 0;
+    advance (31, 2);
+    g_assert_cmpuint (f->notifications, ==, 1);
+    g_assert_cmpint (f->state, ==, INHIBIT_ENGINE_TIMED);
+    g_assert_cmpint (f->reason, ==, INHIBIT_ENGINE_REASON_KEEPALIVE);
+
+    inhibit_engine_inhibit (f->engine, 0);
+    f->notifications = 0;
+    advance (31, 3);
+    g_assert_cmpuint (f->notifications, ==, 0);
+
+    inhibit_engine_release (f->engine, INHIBIT_ENGINE_REASON_REQUEST, NULL);
+}
+
+// The engine bookkeeping of an inhibit/release pair, without the keepalive
+// (the display is off)
+static void
+test_perf_transitions (Fixture *f, gconstpointer data)
+{
+    fake_mce_set_display (MCE_DISPLAY_OFF_STRING);
+
+    g_test_timer_start ();
+    for (int i = 0; i < PERF_TRANSITIONS; i++) {
+        inhibit_engine_inhibit (f->engine, i % 2 ? 0 : 60);
+        inhibit_engine_release (f->engine, INHIBIT_ENGINE_REASON_REQUEST,
+                NULL);
+    }
+    gdouble elapsed = g_test_timer_elapsed ();
+
+    g_assert_cmpuint (fake_mce_get_keepalives (NULL), ==, 0);
+    g_test_minimized_result (elapsed * G_USEC_PER_SEC / PERF_TRANSITIONS,
+            "inhibit/release transition: %.2f us",
+            elapsed * G_USEC_PER_SEC / PERF_TRANSITIONS);
+}
+
+static void
+add (const gchar *path, void (*test) (Fixture *, gconstpointer))
+{
+    g_test_add (path, Fixture, NULL, setup, test, teardown);
+}
+
+int
+main (int argc, char *argv[])
+{
+#if !GLIB_CHECK_VERSION (2, 36, 0)
+    g_type_init ();
+#endif
+    g_test_init (&argc, &argv, NULL);
+
+    add ("/engine/manual", test_manual);
+    add ("/engine/timed", test_timed);
+    add ("/engine/retime", test_retime);
+    add ("/engine/keepalive-latency", test_keepalive_latency);
+    add ("/engine/errors", test_errors);
+    add ("/engine/display-off", test_display_off);
+    add ("/engine/tklock", test_tklock);
+    add ("/engine/suspend", test_suspend);
+    add ("/engine/mce-restart", test_mce_restart);
+    add ("/engine/interval", test_interval);
+    add ("/engine/interval-change", test_interval_change);
+    add ("/engine/wakeups-saved", test_wakeups_saved);
+    add ("/engine/keepalive-notify", test_keepalive_notify);
+    if (g_test_perf ())
+        add ("/engine/perf/transitions", test_perf_transitions);
+
+    return g_test_run ();
+}
@@ -0,0 +1,173 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// User idle alarm tests, they need an X server with the SYNC extension
+// (run-tests starts Xvfb). Input is faked with the XTEST extension, which
+// resets the IDLETIME counter like a real touch does.
+
+#include <gdk/gdk.h>
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/XTest.h>
+
+#include "idle-alarm.h"
+#include "test-util.h"
+
+// what the notification can be early, the counter is sampled
+#define SLACK_US 200000
+// and late, on a busy machine
+#define LATE_US G_USEC_PER_SEC
+
+typedef struct
+{
+    Display *display;
+    IdleAlarm *alarm;
+    guint notifications;
+    gint64 notified;
+} Fixture;
+
+static void
+on_notify (IdleAlarm *alarm, Fixture *f)
+{
+    f->notifications++;
+    f->notified = test_monotonic_time ();
+}
+
+// Moves the pointer, returning when it was done
+static gint64
+fake_input (Fixture *f)
+{
+    static int x = 0;
+
+    x = !x;
+    XTestFakeMotionEvent (f->display, -1, x, 0, CurrentTime);
+    XSync (f->display, False);
+
+    return test_monotonic_time ();
+}
+
+static void
+setup (Fixture *f, gconstpointer data)
+{
+    f->display = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+    f->notifications = 0;
+    f->notified = 0;
+    f->alarm = idle_alarm_new ((IdleAlarmNotify) on_notify, f);
+    g_assert (f->alarm != NULL);
+}
+
+static void
+teardown (Fixture *f, gconstpointer data)
+{
+    idle_alarm_free (f->alarm);
+}
+
+static gboolean
+is_notified (Fixture *f)
+{
+    return f->notifications > 0;
+}
+
+static void
+test_fires (Fixture *f, gconstpointer data)
+{
+    gint64 input = fake_input (f);
+    idle_alarm_set (f->alarm, 1);
+
+    g_assert (test_wait_for ((TestCondition) is_notified, f, TEST_TIMEOUT));
+    g_assert_cmpint (f->notified - input, >=, G_USEC_PER_SEC - SLACK_US);
+    g_assert_cmpint (f->notified - input, <=, G_USEC_PER_SEC + LATE_US);
+
+    // only once, even if the user stays idle
+    test_run_for (1500);
+    g_assert_cmpuint (f->notifications, ==, 1);
+}
+
+// The timeout is counted from the last input, not from when it was set
+static void
+test_input (Fixture *f, gconstpointer data)
+{
+    fake_input (f);
+    idle_alarm_set (f->alarm, 2);
+
+    test_run_for (1000);
+    gint64 input = fake_input (f);
+    test_run_for (1500);
+    g_assert_cmpuint (f->notifications, ==, 0);
+
+    g_assert (test_wait_for ((TestCondition) is_notified, f, TEST_TIMEOUT));
+    g_assert_cmpint (f->notified - input, >=, 2 * G_USEC_PER_SEC - SLACK_US);
+}
+
+static void
+test_disarm (Fixture *f, gconstpointer data)
+{
+    fake_input (f);
+    idle_alarm_set (f->alarm, 1);
+    idle_alarm_set (f->alarm, 0);
+
+    test_run_for (1500);
+    g_assert_cmpuint (f->notifications, ==, 0);
+}
+
+// Setting it again replaces the alarm, it's not added
+static void
+test_reset (Fixture *f, gconstpointer data)
+{
+    gint64 input = fake_input (f);
+    idle_alarm_set (f->alarm, 1);
+    idle_alarm_set (f->alarm, 2);
+
+    g_assert (test_wait_for ((TestCondition) is_notified, f, TEST_TIMEOUT));
+    g_assert_cmpint (f->notified - input, >=, 2 * G_USEC_PER_SEC - SLACK_US);
+    test_run_for (500);
+    g_assert_cmpuint (f->notifications, ==, 1);
+}
+
+static void
+add (const gchar *path, void (*test) (Fixture *, gconstpointer))
+{
+    g_test_add (path, Fixture, NULL, setup, test, teardown);
+}
+
+int
+main (int argc, char *argv[])
+{
+    int event_base, error_base, major, minor;
+
+    g_test_init (&argc, &argv, NULL);
+    if (!gdk_init_check (&argc, &argv)) {
+        g_message ("No X display, skipping the idle alarm tests");
+        return 0;
+    }
+    if (!XTestQueryExtension (GDK_DISPLAY_XDISPLAY (
+                    gdk_display_get_default ()), &event_base, &error_base,
+                &major, &minor)) {
+        g_message ("No XTEST extension, skipping the idle alarm tests");
+        return 0;
+    }
+
+    add ("/idle-alarm/fires", test_fires);
+    add ("/idle-alarm/input", test_input);
+    add ("/idle-alarm/disarm", test_disarm);
+    add ("/idle-alarm/reset", test_reset);
+
+    return g_test_run ();
+}
@@ -0,0 +1,287 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Inhibition journal tests, on a scratch file. The soak test opens,
+// appends to and closes the journal over and over, checking no
+// descriptors, mappings or memory are left behind.
+
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "journal.h"
+
+#define SOAK_CYCLES 20000
+#define SOAK_WARMUP JOURNAL_CAPACITY // every page of the ring touched
+// allocator noise, in KiB
+#define MAX_RSS_GROWTH 64
+
+typedef struct
+{
+    gchar *path;
+    Journal *journal;
+} Fixture;
+
+static void
+setup (Fixture *f, gconstpointer data)
+{
+    GError *error = NULL;
+
+    f->path = g_build_filename (g_get_tmp_dir (), "sadba-test-journal",
+            NULL);
+    g_unlink (f->path);
+    f->journal = journal_open (f->path, TRUE, &error);
+    g_assert_no_error (error);
+}
+
+static void
+teardown (Fixture *f, gconstpointer data)
+{
+    if (f->journal != NULL)
+        journal_close (f->journal);
+    g_unlink (f->path);
+    g_free (f->path);
+}
+
+static void
+append (Fixture *f, gint64 start, JournalRef *ref)
+{
+    JournalRecord *record = journal_append (f->journal, ref);
+    record->start = start;
+    record->end = start + 1;
+}
+
+static void
+collect (const JournalRecord *record, GArray *starts)
+{
+    g_array_append_val (starts, record->start);
+}
+
+// The record starts, from the oldest to the newest, to be freed
+static GArray *
+get_starts (Journal *journal)
+{
+    GArray *starts = g_array_new (FALSE, FALSE, sizeof (gint64));
+    journal_foreach (journal, (JournalFunc) collect, starts);
+
+    return starts;
+}
+
+static void
+test_append (Fixture *f, gconstpointer data)
+{
+    JournalRef ref;
+
+    for (int i = 1; i <= 3; i++)
+        append (f, i, i == 2 ? &ref : NULL);
+
+    GArray *starts = get_starts (f->journal);
+    g_assert_cmpuint (starts->len, ==, 3);
+    for (int i = 0; i < 3; i++)
+        g_assert_cmpint (g_array_index (starts, gint64, i), ==, i + 1);
+    g_array_free (starts, TRUE);
+
+    JournalRecord *record = journal_get (f->journal, &ref);
+    g_assert (record != NULL);
+    g_assert_cmpint (record->start, ==, 2);
+}
+
+// A record can be updated until the ring wraps over it
+static void
+test_wrap (Fixture *f, gconstpointer data)
+{
+    JournalRef first, last;
+
+    append (f, 1, &first);
+    for (int i = 2; i <= JOURNAL_CAPACITY; i++)
+        append (f, i, &last);
+    g_assert (journal_get (f->journal, &first) != NULL);
+
+    append (f, JOURNAL_CAPACITY + 1, NULL);
+    g_assert (journal_get (f->journal, &first) == NULL);
+    g_assert (journal_get (f->journal, &last) != NULL);
+
+    GArray *starts = get_starts (f->journal);
+    g_assert_cmpuint (starts->len, ==, JOURNAL_CAPACITY);
+    g_assert_cmpint (g_array_index (starts, gint64, 0), ==, 2);
+    g_assert_cmpint (g_array_index (starts, gint64, JOURNAL_CAPACITY - 1),
+            ==, JOURNAL_CAPACITY + 1);
+    g_array_free (starts, TRUE);
+}
+
+static void
+test_reopen (Fixture *f, gconstpointer data)
+{
+    GError *error = NULL;
+    JournalRef ref;
+
+    append (f, 1, NULL);
+    append (f, 2, &ref);
+    journal_close (f->journal);
+
+    // the reader
+    f->journal = journal_open (f->path, FALSE, &error);
+    g_assert_no_error (error);
+    GArray *starts = get_starts (f->journal);
+    g_assert_cmpuint (starts->len, ==, 2);
+    g_array_free (starts, TRUE);
+    journal_close (f->journal);
+
+    // and the daemon starting again
+    f->journal = journal_open (f->path, TRUE, &error);
+    g_assert_no_error (error);
+    g_assert (journal_get (f->journal, &ref) != NULL);
+    append (f, 3, NULL);
+    starts = get_starts (f->journal);
+    g_assert_cmpuint (starts->len, ==, 3);
+    g_array_free (starts, TRUE);
+}
+
+static void
+test_invalid (Fixture *f, gconstpointer data)
+{
+    GError *error = NULL;
+
+    journal_close (f->journal);
+    f->journal = NULL;
+    g_assert (g_file_set_contents (f->path, "garbage", -1, NULL));
+
+    g_assert (journal_open (f->path, FALSE, &error) == NULL);
+    g_assert_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL);
+    g_clear_error (&error);
+
+    // the daemon starts a new one
+    f->journal = journal_open (f->path, TRUE, &error);
+    g_assert_no_error (error);
+    GArray *starts = get_starts (f->journal);
+    g_assert_cmpuint (starts->len, ==, 0);
+    g_array_free (starts, TRUE);
+}
+
+static guint
+count_lines (const gchar *path)
+{
+    gchar *contents;
+    g_assert (g_file_get_contents (path, &contents, NULL, NULL));
+
+    guint lines = 0;
+    for (const gchar *c = contents; *c != '\0'; c++)
+        if (*c == '\n')
+            lines++;
+    g_free (contents);
+
+    return lines;
+}
+
+typedef struct
+{
+    guint fds;
+    guint maps;
+    glong rss; // in KiB
+} Usage;
+
+static void
+get_usage (Usage *u)
+{
+    GDir *dir = g_dir_open ("/proc/self/fd", 0, NULL);
+    g_assert (dir != NULL);
+    u->fds = 0;
+    while (g_dir_read_name (dir) != NULL)
+        u->fds++;
+    g_dir_close (dir);
+
+    u->maps = count_lines ("/proc/self/maps");
+
+    u->rss = 0;
+    gchar *status;
+    g_assert (g_file_get_contents ("/proc/self/status", &status, NULL,
+                NULL));
+    const gchar *rss = strstr (status, "VmRSS:");
+    if (rss != NULL)
+        sscanf (rss, "VmRSS: %ld kB", &u->rss);
+    g_free (status);
+}
+
+// Like the daemon does over a long session: it's opened once, but
+// sessions keep being appended and updated through their refs
+static void
+soak_cycle (Fixture *f, int i)
+{
+    GError *error = NULL;
+
+    if (i % 100 == 0) {
+        journal_close (f->journal);
+        f->journal = journal_open (f->path, TRUE, &error);
+        g_assert_no_error (error);
+    }
+
+    JournalRef ref;
+    append (f, i, &ref);
+    JournalRecord *record = journal_get (f->journal, &ref);
+    g_assert (record != NULL);
+    record->keepalives++;
+}
+
+static void
+test_soak (Fixture *f, gconstpointer data)
+{
+    Usage warm, after;
+
+    for (int i = 0; i < SOAK_WARMUP; i++)
+        soak_cycle (f, i);
+    get_usage (&warm);
+
+    for (int i = SOAK_WARMUP; i < SOAK_WARMUP + SOAK_CYCLES; i++)
+        soak_cycle (f, i);
+    get_usage (&after);
+
+    g_test_message ("%d cycles: %+d descriptors, %+d mappings, %+ld KiB RSS",
+            SOAK_CYCLES, (gint) (after.fds - warm.fds),
+            (gint) (after.maps - warm.maps), after.rss - warm.rss);
+    g_assert_cmpuint (after.fds, ==, warm.fds);
+    g_assert_cmpuint (after.maps, ==, warm.maps);
+    g_assert_cmpint (after.rss - warm.rss, <, MAX_RSS_GROWTH);
+
+    GArray *starts = get_starts (f->journal);
+    g_assert_cmpuint (starts->len, ==, JOURNAL_CAPACITY);
+    g_assert_cmpint (g_array_index (starts, gint64, JOURNAL_CAPACITY - 1),
+            ==, SOAK_WARMUP + SOAK_CYCLES - 1);
+    g_array_free (starts, TRUE);
+}
+
+static void
+add (const gchar *path, void (*test) (Fixture *, gconstpointer))
+{
+    g_test_add (path, Fixture, NULL, setup, test, teardown);
+}
+
+int
+main (int argc, char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+
+    add ("/journal/append", test_append);
+    add ("/journal/wrap", test_wrap);
+    add ("/journal/reopen", test_reopen);
+    add ("/journal/invalid", test_invalid);
+    add ("/journal/soak", test_soak);
+
+    return g_test_run ();
+}
@@ -0,0 +1,357 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Plugin soak test: the menu callbacks (inhibit, timed inhibit, its
+// timeout and the mode dialog) are driven in random order, against the
+// fake MCE and the daemon, with a clock shared with the daemon (see
+// test-clock.h) so timed inhibitions end in no time. After every cycle
+// the live main loop sources, GObject instances, pixbufs, descriptors and
+// heap must be within what was seen during the warm up.
+//
+// It runs CYCLES cycles, SLOW_CYCLES with -m slow ("make soak"). The
+// random sequence is repeated with --seed. GObject instances are only
+// counted with GLib >= 2.44 and GOBJECT_DEBUG=instance-count, which
+// run-tests sets.
+
+#include <malloc.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gconf/gconf-client.h>
+
+#include "inhibit-engine.h"
+#include "test-clock.h"
+#include "test-plugin-util.h"
+
+#define WARMUP_CYCLES 500
+#define CYCLES 2000
+#define SLOW_CYCLES 100000
+// allocator noise over the whole run, in KiB
+#define MAX_HEAP_GROWTH 256
+
+// the timed inhibition dialog defaults, as in the plugin
+#define HOURS_GCONF_KEY   "/apps/Maemo/sadba/timed_inhibit_hours"
+#define MINUTES_GCONF_KEY "/apps/Maemo/sadba/timed_inhibit_minutes"
+#define TIMED_MINUTES 10
+// BANNER_DURATION and DIALOG_CACHE_TIMEOUT in the plugin, and then some
+#define BANNER_SECONDS 6
+#define DIALOG_CACHE_SECONDS 121
+
+typedef enum
+{
+    OP_INHIBIT, // the inhibit button
+    OP_TIMED, // the timed inhibit button, the dialog accepted or not
+    OP_TIMEOUT, // time passes, a timed inhibition ends
+    OP_MODE, // the mode dialog
+    OPS
+} Op;
+
+typedef struct
+{
+    guint sources;
+    guint objects;
+    guint pixbufs;
+    guint fds;
+    glong heap; // in KiB
+} Usage;
+
+typedef struct
+{
+    gchar *clock_path;
+    GConfClient *gconf_client;
+    GPid daemon;
+    TestPlugin *plugin;
+    InhibitEngineState state; // what the daemon should be doing
+    gint mode; // the last one picked
+    guint timeouts; // timed inhibitions that ended
+} Fixture;
+
+static void
+setup (Fixture *f, gconstpointer data)
+{
+    GError *error = NULL;
+    int fd = g_file_open_tmp ("test-clock-XXXXXX", &f->clock_path, &error);
+    g_assert_no_error (error);
+    close (fd);
+    g_assert (test_clock_share (f->clock_path) == 0);
+
+    f->gconf_client = gconf_client_get_default ();
+    gconf_client_set_int (f->gconf_client, HOURS_GCONF_KEY, 0, NULL);
+    gconf_client_set_int (f->gconf_client, MINUTES_GCONF_KEY, TIMED_MINUTES,
+            NULL);
+
+    fake_mce_start ();
+    // only the daemon gets the clock preloaded
+    const gchar *lib = g_getenv ("CLOCK_LIB");
+    g_setenv ("LD_PRELOAD", lib != NULL ? lib : "./libtest-clock.so", TRUE);
+    g_setenv (TEST_CLOCK_ENV, f->clock_path, TRUE);
+    f->daemon = test_daemon_start ();
+    g_unsetenv ("LD_PRELOAD");
+    g_unsetenv (TEST_CLOCK_ENV);
+
+    f->plugin = test_plugin_new ();
+    f->state = INHIBIT_ENGINE_OFF;
+    f->mode = 0;
+    f->timeouts = 0;
+}
+
+static void
+teardown (Fixture *f, gconstpointer data)
+{
+    test_plugin_free (f->plugin);
+    test_daemon_stop (f->daemon);
+    fake_mce_stop ();
+
+    gconf_client_unset (f->gconf_client, HOURS_GCONF_KEY, NULL);
+    gconf_client_unset (f->gconf_client, MINUTES_GCONF_KEY, NULL);
+    gconf_client_unset (f->gconf_client, MODE_GCONF_KEY, NULL);
+    g_object_unref (f->gconf_client);
+
+    g_unlink (f->clock_path);
+    g_free (f->clock_path);
+}
+
+static gboolean
+is_dead_source (gpointer id, gpointer value, gpointer data)
+{
+    return g_main_context_find_source_by_id (NULL, GPOINTER_TO_UINT (id))
+            == NULL;
+}
+
+static gboolean
+never_called (gpointer data)
+{
+    return FALSE;
+}
+
+// GLib can't list the sources of a main context, but it gives their IDs
+// in order: the new ones are looked up once, and only the live ones again
+static guint
+count_sources (void)
+{
+    static GHashTable *live = NULL;
+    static guint last = 0;
+    if (live == NULL)
+        live = g_hash_table_new (NULL, NULL);
+
+    g_hash_table_foreach_remove (live, is_dead_source, NULL);
+
+    guint next = g_idle_add (never_called, NULL);
+    g_source_remove (next);
+    for (guint id = last + 1; id < next; id++)
+        if (g_main_context_find_source_by_id (NULL, id) != NULL)
+            g_hash_table_insert (live, GUINT_TO_POINTER (id),
+                    GUINT_TO_POINTER (id));
+    last = next;
+
+    return g_hash_table_size (live);
+}
+
+// Instances of type and its subtypes
+static guint
+count_instances (GType type)
+{
+    guint n = 0;
+#if GLIB_CHECK_VERSION (2, 44, 0)
+    n = g_type_get_instance_count (type);
+    guint n_children;
+    GType *children = g_type_children (type, &n_children);
+    for (guint i = 0; i < n_children; i++)
+        n += count_instances (children[i]);
+    g_free (children);
+#endif
+
+    return n;
+}
+
+static void
+get_usage (Usage *u)
+{
+    u->sources = count_sources ();
+    u->objects = count_instances (G_TYPE_OBJECT);
+    u->pixbufs = count_instances (GDK_TYPE_PIXBUF);
+
+    GDir *dir = g_dir_open ("/proc/self/fd", 0, NULL);
+    g_assert (dir != NULL);
+    u->fds = 0;
+    while (g_dir_read_name (dir) != NULL)
+        u->fds++;
+    g_dir_close (dir);
+
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 mi = mallinfo2 ();
+#else
+    struct mallinfo mi = mallinfo ();
+#endif
+    u->heap = ((glong) mi.uordblks + mi.hblkhd) / 1024;
+}
+
+static void
+usage_max (Usage *max, const Usage *u)
+{
+    max->sources = MAX (max->sources, u->sources);
+    max->objects = MAX (max->objects, u->objects);
+    max->pixbufs = MAX (max->pixbufs, u->pixbufs);
+    max->fds = MAX (max->fds, u->fds);
+    max->heap = MAX (max->heap, u->heap);
+}
+
+static gboolean
+is_state (gpointer state)
+{
+    // it wakes the daemon up too, after the clock is moved
+    return test_daemon_get_state () == GPOINTER_TO_UINT (state);
+}
+
+static gboolean
+is_mode (Fixture *f)
+{
+    return gconf_client_get_int (f->gconf_client, MODE_GCONF_KEY, NULL)
+            == f->mode;
+}
+
+static gboolean
+is_active (Fixture *f, const gchar *name)
+{
+    return gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (
+                test_plugin_find (f->plugin, name)));
+}
+
+// Waits until the daemon does what the plugin was asked for, and the
+// plugin shows it
+static void
+settle (Fixture *f)
+{
+    g_assert (test_wait_for (is_state, GUINT_TO_POINTER (f->state),
+                TEST_TIMEOUT));
+    test_flush ();
+
+    g_assert (is_active (f, "inhibit_button")
+            == (f->state == INHIBIT_ENGINE_MANUAL));
+    g_assert (is_active (f, "timed_inhibit_button")
+            == (f->state == INHIBIT_ENGINE_TIMED));
+}
+
+static void
+advance (Fixture *f, guint seconds)
+{
+    test_clock_advance (seconds);
+    settle (f);
+}
+
+static void
+soak_cycle (Fixture *f)
+{
+    switch (g_test_rand_int_range (0, OPS)) {
+    case OP_INHIBIT:
+        test_plugin_click (f->plugin, "inhibit_button");
+        f->state = f->state == INHIBIT_ENGINE_MANUAL ? INHIBIT_ENGINE_OFF
+                : INHIBIT_ENGINE_MANUAL;
+        settle (f);
+        break;
+    case OP_TIMED:
+        if (f->state == INHIBIT_ENGINE_TIMED)
+            f->state = INHIBIT_ENGINE_OFF;
+        else if (g_test_rand_bit ()) {
+            test_plugin_set_dialog_response (GTK_RESPONSE_ACCEPT);
+            f->state = INHIBIT_ENGINE_TIMED;
+        }
+        else
+            test_plugin_set_dialog_response (GTK_RESPONSE_REJECT);
+        test_plugin_click (f->plugin, "timed_inhibit_button");
+        settle (f);
+        break;
+    case OP_TIMEOUT:
+        if (f->state == INHIBIT_ENGINE_TIMED) {
+            // the daemon ends it, the plugin shows a banner
+            f->state = INHIBIT_ENGINE_OFF;
+            advance (f, TIMED_MINUTES * 60 + 2);
+            f->timeouts++;
+            advance (f, BANNER_SECONDS);
+        }
+        else // the dialogs are dropped
+            advance (f, DIALOG_CACHE_SECONDS);
+        break;
+    case OP_MODE:
+        f->mode = g_test_rand_int_range (0, BLANKING_MODES);
+        // modes are the dialog response IDs
+        test_plugin_set_dialog_response (f->mode);
+        test_plugin_click (f->plugin, "mode_button");
+        g_assert (test_wait_for ((TestCondition) is_mode, f, TEST_TIMEOUT));
+        settle (f);
+        break;
+    }
+}
+
+static void
+report (const gchar *what, const Usage *u)
+{
+    g_test_message ("%s: %u sources, %u objects, %u pixbufs, "
+            "%u descriptors, %ld KiB heap", what, u->sources, u->objects,
+            u->pixbufs, u->fds, u->heap);
+}
+
+static void
+test_soak (Fixture *f, gconstpointer data)
+{
+    Usage warm = { 0, 0, 0, 0, 0 }, u;
+
+    for (int i = 0; i < WARMUP_CYCLES; i++) {
+        soak_cycle (f);
+        get_usage (&u);
+        usage_max (&warm, &u);
+    }
+    report ("warm up", &warm);
+
+    guint cycles = g_test_slow () ? SLOW_CYCLES : CYCLES;
+    for (guint i = 0; i < cycles; i++) {
+        soak_cycle (f);
+        get_usage (&u);
+        g_assert_cmpuint (u.sources, <=, warm.sources);
+        g_assert_cmpuint (u.objects, <=, warm.objects);
+        g_assert_cmpuint (u.pixbufs, <=, warm.pixbufs);
+        g_assert_cmpuint (u.fds, <=, warm.fds);
+        g_assert_cmpint (u.heap - warm.heap, <, MAX_HEAP_GROWTH);
+    }
+    report ("last cycle", &u);
+    g_test_message ("%u cycles, %u timed inhibitions ended", cycles,
+            f->timeouts);
+
+    // the random sequence got to the timeouts
+    g_assert_cmpuint (f->timeouts, >, 0);
+}
+
+int
+main (int argc, char *argv[])
+{
+    // so freed memory is seen as such
+    g_setenv ("G_SLICE", "always-malloc", TRUE);
+    g_test_init (&argc, &argv, NULL);
+    if (!test_plugin_init (&argc, &argv)) {
+        g_message ("No X display, skipping the plugin soak test");
+        return 0;
+    }
+    if (count_instances (G_TYPE_OBJECT) == 0)
+        g_message ("GObject instances are not counted, see "
+                "test-plugin-soak.c");
+
+    g_test_add ("/plugin/soak", Fixture, NULL, setup, test_soak, teardown);
+
+    return g_test_run ();
+}
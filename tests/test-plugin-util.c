@@ -0,0 +1,289 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+#include <string.h>
+#include <hildon/hildon.h>
+#include <libhildondesktop/libhildondesktop.h>
+#include <dbus/dbus-glib-lowlevel.h>
+
+#include "stats.h"
+#include "test-plugin-util.h"
+
+#define PLUGIN_PATH "../src/lib-displayblanking-status-menu.so"
+
+static HDPluginModule *module = NULL;
+
+static gint dialog_response = G_MININT;
+static guint dialogs = 0;
+static gint64 last_dialog = 0;
+
+static gboolean
+respond (GtkDialog *dialog)
+{
+    if (dialog_response != G_MININT && GTK_WIDGET_VISIBLE (dialog))
+        gtk_dialog_response (dialog, dialog_response);
+    g_object_unref (dialog);
+
+    // the source is removed when returning FALSE
+    return FALSE;
+}
+
+// The plugin runs its dialogs with gtk_dialog_run (), so they are answered
+// from an idle, inside that main loop
+static gboolean
+on_map_event (GSignalInvocationHint *hint, guint n_values,
+        const GValue *values, gpointer data)
+{
+    GObject *widget = g_value_get_object (&values[0]);
+
+    if (GTK_IS_DIALOG (widget)) {
+        dialogs++;
+        last_dialog = test_monotonic_time ();
+        g_idle_add ((GSourceFunc) respond, g_object_ref (widget));
+    }
+
+    // keep the hook
+    return TRUE;
+}
+
+gboolean
+test_plugin_init (int *argc, char **argv[])
+{
+    if (!gtk_init_check (argc, argv))
+        return FALSE;
+    hildon_init ();
+
+    g_signal_add_emission_hook (g_signal_lookup ("map-event",
+                GTK_TYPE_WIDGET), 0, on_map_event, NULL, NULL);
+
+    return TRUE;
+}
+
+static gboolean
+stats_has_owner (gpointer running)
+{
+    gboolean owned = dbus_bus_name_has_owner (test_system_bus (),
+            TEST_PLUGIN_STATS_NAME, NULL);
+    return owned == GPOINTER_TO_INT (running);
+}
+
+TestPlugin *
+test_plugin_new (void)
+{
+    if (module == NULL) {
+        const gchar *path = g_getenv ("PLUGIN");
+        module = hd_plugin_module_new (path != NULL ? path : PLUGIN_PATH);
+    }
+    // like hildon-desktop, the instance keeps the module loaded
+    if (!g_type_module_use (G_TYPE_MODULE (module)))
+        g_error ("Can't load the plugin module");
+
+    TestPlugin *plugin = g_slice_new (TestPlugin);
+    plugin->item = GTK_WIDGET (hd_plugin_module_new_object (module,
+                "test"));
+    g_type_module_unuse (G_TYPE_MODULE (module));
+    g_assert (plugin->item != NULL);
+
+    plugin->window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+    gtk_container_add (GTK_CONTAINER (plugin->window), plugin->item);
+    gtk_widget_show_all (plugin->window);
+
+    // the statistics are exported last
+    if (!test_wait_for (stats_has_owner, GINT_TO_POINTER (TRUE),
+                TEST_TIMEOUT))
+        g_error ("The plugin didn't finish its initialization");
+
+    return plugin;
+}
+
+void
+test_plugin_free (TestPlugin *plugin)
+{
+    gtk_widget_destroy (plugin->window);
+    g_slice_free (TestPlugin, plugin);
+
+    if (!test_wait_for (stats_has_owner, GINT_TO_POINTER (FALSE),
+                TEST_TIMEOUT))
+        g_error ("The plugin didn't release its statistics name");
+    // the calls it sent while going away
+    test_run_for (50);
+}
+
+typedef struct
+{
+    const gchar *name;
+    GtkWidget *found;
+} FindData;
+
+static void
+find_widget (GtkWidget *widget, FindData *d)
+{
+    if (d->found != NULL)
+        return;
+
+    if (g_strcmp0 (gtk_widget_get_name (widget), d->name) == 0)
+        d->found = widget;
+    else if (GTK_IS_CONTAINER (widget))
+        gtk_container_forall (GTK_CONTAINER (widget),
+                (GtkCallback) find_widget, d);
+}
+
+GtkWidget *
+test_plugin_find (TestPlugin *plugin, const gchar *name)
+{
+    FindData d = { name, NULL };
+    find_widget (plugin->item, &d);
+    if (d.found == NULL)
+        g_error ("There is no %s in the plugin", name);
+
+    return d.found;
+}
+
+static gboolean
+is_tappable (GtkWidget *widget)
+{
+    return GTK_WIDGET_IS_SENSITIVE (widget) && GTK_WIDGET_MAPPED (widget)
+            && gdk_window_is_viewable (widget->window);
+}
+
+gint64
+test_plugin_tap (TestPlugin *plugin, const gchar *name)
+{
+    GtkWidget *widget = test_plugin_find (plugin, name);
+
+    gtk_widget_show (plugin->window);
+    g_assert (test_wait_for ((TestCondition) is_tappable, widget,
+                TEST_TIMEOUT));
+
+    gint64 now = test_monotonic_time ();
+    g_assert (gtk_test_widget_click (widget, 1, 0));
+
+    return now;
+}
+
+void
+test_plugin_press (TestPlugin *plugin, const gchar *name, gboolean pressed)
+{
+    GtkWidget *widget = test_plugin_find (plugin, name);
+
+    gtk_widget_show (plugin->window);
+    g_assert (test_wait_for ((TestCondition) is_tappable, widget,
+                TEST_TIMEOUT));
+
+    // half of what gtk_test_widget_click () does
+    gint x = widget->allocation.width / 2;
+    gint y = widget->allocation.height / 2;
+    if (GTK_WIDGET_NO_WINDOW (widget)) {
+        x += widget->allocation.x;
+        y += widget->allocation.y;
+    }
+    g_assert (gdk_test_simulate_button (widget->window, x, y, 1, 0,
+                pressed ? GDK_BUTTON_PRESS : GDK_BUTTON_RELEASE));
+    gdk_display_sync (gtk_widget_get_display (widget));
+    test_flush ();
+}
+
+void
+test_plugin_click (TestPlugin *plugin, const gchar *name)
+{
+    GtkWidget *widget = test_plugin_find (plugin, name);
+    g_assert (GTK_IS_BUTTON (widget) && GTK_WIDGET_IS_SENSITIVE (widget));
+
+    gtk_button_clicked (GTK_BUTTON (widget));
+}
+
+gint
+test_plugin_set_dialog_response (gint response)
+{
+    gint old = dialog_response;
+    dialog_response = response;
+
+    return old;
+}
+
+guint
+test_plugin_get_dialogs (gint64 *last)
+{
+    if (last != NULL)
+        *last = last_dialog;
+
+    return dialogs;
+}
+
+static gboolean
+is_completed (DBusPendingCall *call)
+{
+    return dbus_pending_call_get_completed (call);
+}
+
+// The plugin shares the bus connection with us, so a blocking call would
+// never get its reply. The call goes through a private connection, and the
+// main loop runs meanwhile.
+guint64
+test_plugin_get_stat (const gchar *name)
+{
+    static DBusConnection *conn = NULL;
+    if (conn == NULL) {
+        DBusError error;
+        dbus_error_init (&error);
+        conn = dbus_bus_get_private (DBUS_BUS_SESSION, &error);
+        if (conn == NULL)
+            g_error ("Can't connect to the test session bus: %s",
+                    error.message);
+        dbus_connection_set_exit_on_disconnect (conn, FALSE);
+        dbus_connection_setup_with_g_main (conn, NULL);
+    }
+
+    DBusMessage *msg = dbus_message_new_method_call (TEST_PLUGIN_STATS_NAME,
+            STATS_PATH, STATS_INTERFACE, "GetStats");
+    g_assert (msg != NULL);
+    DBusPendingCall *call = NULL;
+    g_assert (dbus_connection_send_with_reply (conn, msg, &call,
+                TEST_TIMEOUT) && call != NULL);
+    dbus_message_unref (msg);
+
+    g_assert (test_wait_for ((TestCondition) is_completed, call,
+                TEST_TIMEOUT));
+    DBusMessage *reply = dbus_pending_call_steal_reply (call);
+    dbus_pending_call_unref (call);
+    g_assert (dbus_message_get_type (reply)
+            == DBUS_MESSAGE_TYPE_METHOD_RETURN);
+
+    guint64 value = 0;
+    DBusMessageIter iter, counters;
+    dbus_message_iter_init (reply, &iter);
+    dbus_message_iter_recurse (&iter, &counters);
+    while (dbus_message_iter_get_arg_type (&counters)
+            == DBUS_TYPE_DICT_ENTRY) {
+        DBusMessageIter entry;
+        const char *n;
+        dbus_uint64_t v;
+        dbus_message_iter_recurse (&counters, &entry);
+        dbus_message_iter_get_basic (&entry, &n);
+        dbus_message_iter_next (&entry);
+        dbus_message_iter_get_basic (&entry, &v);
+        if (strcmp (n, name) == 0)
+            value = v;
+        dbus_message_iter_next (&counters);
+    }
+    dbus_message_unref (reply);
+
+    return value;
+}
@@ -0,0 +1,82 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Helpers to drive the real plugin without hildon-desktop. The module is
+// loaded like hildon-desktop does ($PLUGIN, ../src by default) and the
+// status menu item is put in a plain window, the buttons are found by
+// their widget names and tapped with synthetic X events. They need an X
+// server and, besides the run-tests environment, the fake MCE and the
+// daemon running.
+
+#ifndef TEST_PLUGIN_UTIL_H
+#define TEST_PLUGIN_UTIL_H
+
+#include <gtk/gtk.h>
+
+#include "test-util.h"
+
+// Where the plugin exports its statistics (STATS_BUS_NAME in the plugin)
+#define TEST_PLUGIN_STATS_NAME "ar.com.llucax.Sadba.Applet"
+
+typedef struct
+{
+    GtkWidget *window; // stands for the status menu
+    GtkWidget *item; // the plugin
+} TestPlugin;
+
+// Initializes GTK and hildon, returns FALSE if there is no X display
+gboolean test_plugin_init (int *argc, char **argv[]);
+
+// Loads the module the first time and creates the plugin, returns once
+// its deferred initialization is done
+TestPlugin *test_plugin_new (void);
+
+void test_plugin_free (TestPlugin *plugin);
+
+// The widget named name inside the plugin, which must exist
+GtkWidget *test_plugin_find (TestPlugin *plugin, const gchar *name);
+
+// Shows the menu (the plugin hides it on every tap) and taps the widget
+// named name, returns when the tap was sent, in monotonic microseconds
+gint64 test_plugin_tap (TestPlugin *plugin, const gchar *name);
+
+// Presses (or releases) the first button in the middle of the widget
+// named name, showing the menu first, like a drag starts (or ends).
+// Returns once the event was handled.
+void test_plugin_press (TestPlugin *plugin, const gchar *name,
+        gboolean pressed);
+
+// Emits the clicked signal of the button named name, without X events or
+// showing the menu, so it runs the plugin callback as fast as it can be
+// driven
+void test_plugin_click (TestPlugin *plugin, const gchar *name);
+
+// Dialogs mapped from now on are answered with response, the previous
+// one is returned. G_MININT leaves them alone.
+gint test_plugin_set_dialog_response (gint response);
+
+// Dialogs mapped so far, last is when the last one was (in monotonic
+// microseconds), it can be NULL
+guint test_plugin_get_dialogs (gint64 *last);
+
+// A counter from the plugin statistics, 0 if there is no such counter
+guint64 test_plugin_get_stat (const gchar *name);
+
+#endif // TEST_PLUGIN_UTIL_H
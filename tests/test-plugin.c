@@ -0,0 +1,322 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Plugin tests, driving the real module under X (run-tests starts Xvfb)
+// against the fake MCE and the daemon. The memory tests report what the
+// plugin costs hildon-desktop (heap, RSS and dirty pages) and check it
+// stays flat with use. The slider tests check a drag doesn't flood gconfd
+// and changes made elsewhere are shown.
+
+#define _GNU_SOURCE // for sysconf ()
+
+#include <malloc.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <gconf/gconf-client.h>
+
+#include "inhibit-engine.h"
+#include "test-plugin-util.h"
+
+#define WARMUP_CYCLES 5
+#define CYCLES 50
+#define RELOADS 20
+// what steady state use can grow, mostly allocator noise, in KiB
+#define MAX_GROWTH 64
+
+// the brightness slider, as in the plugin
+#define BRIGHTNESS_GCONF_KEY MODE_GCONF_ROOT "/display_brightness"
+#define BRIGHTNESS_MIN 1
+#define BRIGHTNESS_MAX 5
+// SLIDER_WRITE_INTERVAL in the plugin, GConf is written at most once per
+// frame while dragging
+#define FRAME_MS 40
+#define DRAG_MS 1000
+// motion events come faster than frames
+#define DRAG_STEP_MS 5
+
+typedef struct
+{
+    GPid daemon;
+    TestPlugin *plugin;
+} Fixture;
+
+// In KiB
+typedef struct
+{
+    glong heap;
+    glong rss;
+    glong dirty;
+} Usage;
+
+static void
+get_usage (Usage *u)
+{
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 mi = mallinfo2 ();
+#else
+    struct mallinfo mi = mallinfo ();
+#endif
+    u->heap = ((glong) mi.uordblks + mi.hblkhd) / 1024;
+
+    u->rss = 0;
+    FILE *f = fopen ("/proc/self/statm", "r");
+    g_assert (f != NULL);
+    long size, resident;
+    if (fscanf (f, "%ld %ld", &size, &resident) == 2)
+        u->rss = resident * (sysconf (_SC_PAGESIZE) / 1024);
+    fclose (f);
+
+    u->dirty = 0;
+    f = fopen ("/proc/self/smaps", "r");
+    g_assert (f != NULL);
+    char line[256];
+    long kb;
+    while (fgets (line, sizeof (line), f) != NULL)
+        if (sscanf (line, "Private_Dirty: %ld kB", &kb) == 1)
+            u->dirty += kb;
+    fclose (f);
+}
+
+static void
+report (const gchar *what, const Usage *before, const Usage *after,
+        guint n)
+{
+    g_test_message ("%s: heap %+.1f KiB, RSS %+.1f KiB, dirty %+.1f KiB",
+            what, (gdouble) (after->heap - before->heap) / n,
+            (gdouble) (after->rss - before->rss) / n,
+            (gdouble) (after->dirty - before->dirty) / n);
+}
+
+static void
+setup (Fixture *f, gconstpointer data)
+{
+    fake_mce_start ();
+    f->daemon = test_daemon_start ();
+    f->plugin = NULL;
+}
+
+static void
+teardown (Fixture *f, gconstpointer data)
+{
+    if (f->plugin != NULL)
+        test_plugin_free (f->plugin);
+    test_daemon_stop (f->daemon);
+    fake_mce_stop ();
+}
+
+static gboolean
+got_keepalive (gpointer data)
+{
+    return fake_mce_get_keepalives (NULL) > 0;
+}
+
+static gboolean
+is_off (gpointer data)
+{
+    return test_daemon_get_state () == INHIBIT_ENGINE_OFF;
+}
+
+static gboolean
+got_dialog (gpointer before)
+{
+    return test_plugin_get_dialogs (NULL) > GPOINTER_TO_UINT (before);
+}
+
+// What a user does with the menu: inhibits, releases, and opens the
+// dialogs without picking anything
+static void
+use (TestPlugin *plugin)
+{
+    test_plugin_tap (plugin, "inhibit_button");
+    g_assert (test_wait_for (got_keepalive, NULL, TEST_TIMEOUT));
+    test_plugin_tap (plugin, "inhibit_button");
+    g_assert (test_wait_for (is_off, NULL, TEST_TIMEOUT));
+    fake_mce_reset ();
+
+    const gchar *dialog_buttons[] = { "mode_button", "timed_inhibit_button" };
+    for (int i = 0; i < G_N_ELEMENTS (dialog_buttons); i++) {
+        guint dialogs = test_plugin_get_dialogs (NULL);
+        test_plugin_tap (plugin, dialog_buttons[i]);
+        g_assert (test_wait_for (got_dialog, GUINT_TO_POINTER (dialogs),
+                    TEST_TIMEOUT));
+        // the answer is given from an idle
+        test_run_for (20);
+    }
+}
+
+static void
+test_memory_use (Fixture *f, gconstpointer data)
+{
+    Usage before, loaded, warm, after;
+
+    get_usage (&before);
+    f->plugin = test_plugin_new ();
+    get_usage (&loaded);
+    report ("load", &before, &loaded, 1);
+
+    for (int i = 0; i < WARMUP_CYCLES; i++)
+        use (f->plugin);
+    get_usage (&warm);
+    report ("first uses", &loaded, &warm, WARMUP_CYCLES);
+
+    for (int i = 0; i < CYCLES; i++)
+        use (f->plugin);
+    get_usage (&after);
+    report ("per use", &warm, &after, CYCLES);
+
+    if (g_test_perf ())
+        g_test_minimized_result (loaded.dirty - before.dirty,
+                "load dirty pages: %ld KiB", loaded.dirty - before.dirty);
+    g_assert_cmpint (after.heap - warm.heap, <, MAX_GROWTH);
+}
+
+// hildon-desktop creates the plugin again when it's disabled and enabled
+// in the status menu settings
+static void
+test_memory_reload (Fixture *f, gconstpointer data)
+{
+    Usage warm, after;
+
+    for (int i = 0; i < WARMUP_CYCLES; i++)
+        test_plugin_free (test_plugin_new ());
+    get_usage (&warm);
+
+    for (int i = 0; i < RELOADS; i++) {
+        TestPlugin *plugin = test_plugin_new ();
+        use (plugin);
+        test_plugin_free (plugin);
+    }
+    get_usage (&after);
+    report ("per reload", &warm, &after, RELOADS);
+
+    g_assert_cmpint (after.heap - warm.heap, <, MAX_GROWTH);
+}
+
+// The next brightness step, wrapping around
+static gint
+next_brightness (gint value)
+{
+    return value >= BRIGHTNESS_MAX ? BRIGHTNESS_MIN : value + 1;
+}
+
+typedef struct
+{
+    GtkRange *scale;
+    gint value;
+} SliderValue;
+
+static gboolean
+slider_shows (SliderValue *v)
+{
+    return (gint) gtk_range_get_value (v->scale) == v->value;
+}
+
+static void
+test_slider_writes (Fixture *f, gconstpointer data)
+{
+    f->plugin = test_plugin_new ();
+    GtkRange *scale = GTK_RANGE (test_plugin_find (f->plugin,
+                "brightness_scale"));
+    guint64 before = test_plugin_get_stat ("gconf_commits");
+
+    gint64 start = test_monotonic_time ();
+    test_plugin_press (f->plugin, "brightness_scale", TRUE);
+    gint value = gtk_range_get_value (scale);
+    while (test_monotonic_time () - start < DRAG_MS * 1000) {
+        value = next_brightness (value);
+        gtk_range_set_value (scale, value);
+        test_run_for (DRAG_STEP_MS);
+    }
+    // not written yet, the release does it
+    value = next_brightness (value);
+    gtk_range_set_value (scale, value);
+    test_plugin_press (f->plugin, "brightness_scale", FALSE);
+    gint64 elapsed = (test_monotonic_time () - start) / 1000;
+
+    GConfClient *client = gconf_client_get_default ();
+    g_assert_cmpint (gconf_client_get_int (client, BRIGHTNESS_GCONF_KEY,
+                NULL), ==, value);
+    guint64 writes = test_plugin_get_stat ("gconf_commits") - before;
+    g_test_message ("%" G_GUINT64_FORMAT " writes in %" G_GINT64_FORMAT
+            " ms", writes, elapsed);
+    // a partial frame at each end, and the release
+    g_assert_cmpuint (writes, <=, elapsed / FRAME_MS + 2);
+    g_assert_cmpuint (writes, >, 1);
+
+    // the writes coming back from gconfd don't move it
+    SliderValue v = { scale, value };
+    test_run_for (10 * FRAME_MS);
+    g_assert (slider_shows (&v));
+
+    gconf_client_unset (client, BRIGHTNESS_GCONF_KEY, NULL);
+    g_object_unref (client);
+}
+
+static void
+test_slider_notify (Fixture *f, gconstpointer data)
+{
+    f->plugin = test_plugin_new ();
+    GtkRange *scale = GTK_RANGE (test_plugin_find (f->plugin,
+                "brightness_scale"));
+    guint64 before = test_plugin_get_stat ("gconf_commits");
+
+    // like the control panel does, it comes back from gconfd
+    SliderValue v = { scale, next_brightness (gtk_range_get_value (scale)) };
+    GConfClient *client = gconf_client_get_default ();
+    gconf_client_set_int (client, BRIGHTNESS_GCONF_KEY, v.value, NULL);
+    g_assert (test_wait_for ((TestCondition) slider_shows, &v,
+                TEST_TIMEOUT));
+
+    // shown, not written back
+    test_flush ();
+    g_assert_cmpuint (test_plugin_get_stat ("gconf_commits"), ==, before);
+
+    gconf_client_unset (client, BRIGHTNESS_GCONF_KEY, NULL);
+    g_object_unref (client);
+}
+
+static void
+add (const gchar *path, void (*test) (Fixture *, gconstpointer))
+{
+    g_test_add (path, Fixture, NULL, setup, test, teardown);
+}
+
+int
+main (int argc, char *argv[])
+{
+    // so freed memory is seen as such
+    g_setenv ("G_SLICE", "always-malloc", TRUE);
+    g_test_init (&argc, &argv, NULL);
+    if (!test_plugin_init (&argc, &argv)) {
+        g_message ("No X display, skipping the plugin tests");
+        return 0;
+    }
+
+    // dialogs are just looked at
+    test_plugin_set_dialog_response (GTK_RESPONSE_CANCEL);
+
+    add ("/plugin/memory/use", test_memory_use);
+    add ("/plugin/memory/reload", test_memory_reload);
+    add ("/plugin/slider/writes", test_slider_writes);
+    add ("/plugin/slider/notify", test_slider_notify);
+
+    return g_test_run ();
+}
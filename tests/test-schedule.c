@@ -0,0 +1,338 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Schedule tests. The rules and the boundary arithmetic are checked
+// directly, the daylight saving time changes on a fixed timezone, and the
+// reaction to clockd time changes on the virtual clock, with the wall
+// clock jumping under an armed timer.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "schedule.h"
+#include "test-clock.h"
+#include "test-util.h"
+
+#define HOUR 3600
+#define DAY_SECONDS (24 * HOUR)
+
+// as the Rule days, minute of the week from a day (1 is Monday) and time
+#define AT(day, h, m) (((day) - 1) * SCHEDULE_DAY + (h) * 60 + (m))
+
+#define CLOCKD_PATH         "/com/nokia/clockd"
+#define CLOCKD_INTERFACE    "com.nokia.clockd"
+#define CLOCKD_TIME_CHANGED "time_changed"
+
+// Parses the rules in a NULL terminated list, they must be valid
+static GArray *
+parse_rules (const gchar **strs)
+{
+    GArray *rules = g_array_new (FALSE, FALSE, sizeof (ScheduleRule));
+
+    for (; *strs != NULL; strs++) {
+        ScheduleRule rule;
+        g_assert (schedule_rule_parse (*strs, &rule));
+        g_array_append_val (rules, rule);
+    }
+
+    return rules;
+}
+
+static void
+test_parse (void)
+{
+    static const struct {
+        const gchar *str;
+        guint days, start, length;
+        gint mode;
+    } valid[] = {
+        { "12345 08:00-18:00 3", 0x1f, AT (1, 8, 0), 10 * 60, 3 },
+        { "* 22:00-06:00 1", 0x7f, AT (1, 22, 0), 8 * 60, 1 },
+        { "7 00:00-24:00 0", 0x40, 0, SCHEDULE_DAY, 0 },
+        { "67 10:30-10:30 4", 0x60, AT (1, 10, 30), SCHEDULE_DAY, 4 },
+        { "71 23:59-00:00 2", 0x41, AT (1, 23, 59), 1, 2 },
+    };
+    static const gchar *invalid[] = {
+        "",
+        "12345 08:00-18:00",
+        "0 08:00-18:00 1",
+        "8 08:00-18:00 1",
+        "1a 08:00-18:00 1",
+        "1 24:00-01:00 1",
+        "1 08:60-09:00 1",
+        "1 08:00-24:30 1",
+        "1 08:00-25:00 1",
+        "1 08:00-09:00 -1",
+        "1 08:00-09:00 5",
+        "1 08:00-09:00 1 x",
+        "1 8-9 1",
+    };
+
+    for (guint i = 0; i < G_N_ELEMENTS (valid); i++) {
+        ScheduleRule rule;
+        g_assert (schedule_rule_parse (valid[i].str, &rule));
+        g_assert_cmphex (rule.days, ==, valid[i].days);
+        g_assert_cmpuint (rule.start, ==, valid[i].start);
+        g_assert_cmpuint (rule.length, ==, valid[i].length);
+        g_assert_cmpint (rule.mode, ==, valid[i].mode);
+    }
+
+    for (guint i = 0; i < G_N_ELEMENTS (invalid); i++) {
+        ScheduleRule rule;
+        if (schedule_rule_parse (invalid[i], &rule))
+            g_error ("'%s' was taken as a valid rule", invalid[i]);
+    }
+}
+
+// Rules spanning midnight go on into the next day, Sunday's into Monday
+static void
+test_wrap (void)
+{
+    static const gchar *strs[] = {
+        "5 22:00-06:00 1",
+        "7 23:00-01:00 2",
+        "* 00:30-00:45 3", // after the Sunday one, it loses on Monday
+        NULL,
+    };
+    static const struct {
+        guint minute;
+        gint mode;
+    } cases[] = {
+        { AT (5, 21, 59), -1 },
+        { AT (5, 22, 0), 1 },
+        { AT (6, 0, 0), 1 },
+        { AT (6, 5, 59), 1 },
+        { AT (6, 6, 0), -1 },
+        { AT (7, 22, 59), -1 },
+        { AT (7, 23, 0), 2 },
+        { AT (1, 0, 0), 2 },
+        { AT (1, 0, 30), 2 },
+        { AT (1, 0, 59), 2 },
+        { AT (1, 1, 0), -1 },
+        { AT (2, 0, 30), 3 },
+        { AT (2, 0, 45), -1 },
+    };
+    GArray *rules = parse_rules (strs);
+
+    for (guint i = 0; i < G_N_ELEMENTS (cases); i++)
+        g_assert_cmpint (schedule_rules_mode_at (rules, cases[i].minute),
+                ==, cases[i].mode);
+
+    g_array_free (rules, TRUE);
+}
+
+static gboolean
+is_boundary (GArray *boundaries, guint minute)
+{
+    for (guint i = 0; i < boundaries->len; i++)
+        if (g_array_index (boundaries, guint, i) == minute)
+            return TRUE;
+    return FALSE;
+}
+
+static void
+test_boundaries (void)
+{
+    static const gchar *strs[] = {
+        "12 08:00-18:00 3",
+        "7 22:00-06:00 1",
+        "1 08:00-09:00 2", // same start as the first one
+        NULL,
+    };
+    static const guint expected[] = {
+        AT (1, 6, 0), AT (1, 8, 0), AT (1, 9, 0), AT (1, 18, 0),
+        AT (2, 8, 0), AT (2, 18, 0), AT (7, 22, 0),
+    };
+    GArray *rules = parse_rules (strs);
+    GArray *boundaries = g_array_new (FALSE, FALSE, sizeof (guint));
+
+    schedule_rules_boundaries (rules, boundaries);
+    g_assert_cmpuint (boundaries->len, ==, G_N_ELEMENTS (expected));
+    for (guint i = 0; i < G_N_ELEMENTS (expected); i++)
+        g_assert_cmpuint (g_array_index (boundaries, guint, i), ==,
+                expected[i]);
+
+    // the mode only changes at a boundary, the single timer misses nothing
+    for (guint m = 0; m < SCHEDULE_WEEK; m++) {
+        guint prev = (m + SCHEDULE_WEEK - 1) % SCHEDULE_WEEK;
+        if (schedule_rules_mode_at (rules, m)
+                != schedule_rules_mode_at (rules, prev))
+            g_assert (is_boundary (boundaries, m));
+    }
+
+    g_array_free (boundaries, TRUE);
+    g_array_free (rules, TRUE);
+}
+
+// Central European time, the 2024 changes were on Sunday March 31 and
+// October 27
+static void
+test_dst (void)
+{
+    static const struct {
+        time_t now;
+        guint minute;
+        guint seconds;
+    } cases[] = {
+        // Saturday March 30 12:00 CET to Sunday 12:00 CEST
+        { 1711796400, AT (7, 12, 0), 23 * HOUR },
+        // Saturday October 26 12:00 CEST to Sunday 12:00 CET
+        { 1729936800, AT (7, 12, 0), 25 * HOUR },
+        // Saturday June 15 12:00 CEST, nothing changes in between
+        { 1718445600, AT (7, 12, 0), 24 * HOUR },
+        { 1718445600, AT (6, 12, 1), 60 },
+        // it's now, so the next one is a week away
+        { 1718445600, AT (6, 12, 0), 7 * DAY_SECONDS },
+        // Sunday March 24 12:00 CET, a week away crosses the change
+        { 1711278000, AT (7, 12, 0), 7 * DAY_SECONDS - HOUR },
+    };
+    gchar *tz = g_strdup (g_getenv ("TZ"));
+
+    g_setenv ("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", TRUE);
+    tzset ();
+    for (guint i = 0; i < G_N_ELEMENTS (cases); i++)
+        g_assert_cmpuint (schedule_seconds_until (cases[i].now,
+                    cases[i].minute), ==, cases[i].seconds);
+
+    if (tz != NULL)
+        g_setenv ("TZ", tz, TRUE);
+    else
+        g_unsetenv ("TZ");
+    tzset ();
+    g_free (tz);
+}
+
+typedef struct
+{
+    GConfClient *gconf_client;
+    Schedule *schedule;
+    guint notifications;
+    gint mode; // last notified
+} Fixture;
+
+static void
+on_notify (Schedule *schedule, gint mode, Fixture *f)
+{
+    f->notifications++;
+    f->mode = mode;
+}
+
+static void
+setup (Fixture *f, gconstpointer data)
+{
+    GError *error = NULL;
+    GSList *list = NULL;
+
+    // mornings in mode 1, afternoons in mode 2
+    list = g_slist_append (list, "* 00:00-12:00 1");
+    list = g_slist_append (list, "* 12:00-00:00 2");
+    f->gconf_client = gconf_client_get_default ();
+    gconf_client_unset (f->gconf_client, SCHEDULE_DEFAULT_MODE_GCONF_KEY,
+            NULL);
+    gconf_client_set_list (f->gconf_client, SCHEDULE_GCONF_KEY,
+            GCONF_VALUE_STRING, list, &error);
+    g_assert_no_error (error);
+    g_slist_free (list);
+
+    f->notifications = 0;
+    f->mode = -1;
+    f->schedule = schedule_new (test_system_bus (), f->gconf_client,
+            (ScheduleNotify) on_notify, f);
+}
+
+static void
+teardown (Fixture *f, gconstpointer data)
+{
+    schedule_free (f->schedule);
+    gconf_client_unset (f->gconf_client, SCHEDULE_GCONF_KEY, NULL);
+    g_object_unref (f->gconf_client);
+}
+
+static gboolean
+got_notification (Fixture *f)
+{
+    return f->notifications > 0;
+}
+
+static void
+emit_time_changed (void)
+{
+    DBusMessage *msg = dbus_message_new_signal (CLOCKD_PATH,
+            CLOCKD_INTERFACE, CLOCKD_TIME_CHANGED);
+    g_assert (msg != NULL);
+    g_assert (dbus_connection_send (test_system_bus (), msg, NULL));
+    dbus_message_unref (msg);
+}
+
+// The timer is armed on the monotonic clock, so when the wall clock jumps
+// nothing happens until clockd says so
+static void
+test_time_changed (Fixture *f, gconstpointer data)
+{
+    // the current mode is applied right away
+    guint now = time (NULL) % DAY_SECONDS;
+    gint mode = now < 12 * HOUR ? 1 : 2;
+    g_assert_cmpuint (f->notifications, ==, 1);
+    g_assert_cmpint (f->mode, ==, mode);
+
+    // to the middle of the other half of the day
+    test_clock_jump_wall (mode == 1 ? 18 * HOUR - now
+            : DAY_SECONDS + 6 * HOUR - now);
+    f->notifications = 0;
+    test_run_for (100);
+    g_assert_cmpuint (f->notifications, ==, 0);
+
+    emit_time_changed ();
+    g_assert (test_wait_for ((TestCondition) got_notification, f,
+                TEST_TIMEOUT));
+    g_assert_cmpint (f->mode, ==, 3 - mode);
+
+    // and the timer is armed for the next boundary, 6 hours from now
+    f->notifications = 0;
+    test_flush ();
+    test_clock_advance (6 * HOUR - 2);
+    test_run_for (100);
+    g_assert_cmpuint (f->notifications, ==, 0);
+    test_clock_advance (3);
+    g_assert (test_wait_for ((TestCondition) got_notification, f,
+                TEST_TIMEOUT));
+    g_assert_cmpint (f->mode, ==, mode);
+}
+
+int
+main (int argc, char *argv[])
+{
+#if !GLIB_CHECK_VERSION (2, 36, 0)
+    g_type_init ();
+#endif
+    // the day halves in test_time_changed () are in UTC
+    g_setenv ("TZ", "UTC", TRUE);
+    tzset ();
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/schedule/parse", test_parse);
+    g_test_add_func ("/schedule/wrap", test_wrap);
+    g_test_add_func ("/schedule/boundaries", test_boundaries);
+    g_test_add_func ("/schedule/dst", test_dst);
+    g_test_add ("/schedule/time-changed", Fixture, NULL, setup,
+            test_time_changed, teardown);
+
+    return g_test_run ();
+}
@@ -0,0 +1,345 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L // for clock_gettime () and kill ()
+
+#include <signal.h>
+#include <stdarg.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <dbus/dbus-glib-lowlevel.h>
+#include <mce/dbus-names.h>
+
+#include "fake-bme.h"
+#include "fake-mce.h"
+#include "sadba-dbus.h"
+#include "test-util.h"
+
+#define POLL_INTERVAL 1000 // in microseconds
+
+DBusConnection *
+test_system_bus (void)
+{
+    static DBusConnection *conn = NULL;
+
+    if (conn == NULL) {
+        DBusError error;
+        dbus_error_init (&error);
+        conn = dbus_bus_get (DBUS_BUS_SYSTEM, &error);
+        if (conn == NULL)
+            g_error ("Can't connect to the test system bus: %s",
+                    error.message);
+        dbus_connection_setup_with_g_main (conn, NULL);
+    }
+
+    return conn;
+}
+
+gint64
+test_monotonic_time (void)
+{
+    struct timespec ts;
+    int r = clock_gettime (CLOCK_MONOTONIC, &ts);
+    g_assert (r == 0);
+    return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+gboolean
+test_wait_for (TestCondition cond, gpointer data, guint timeout)
+{
+    gint64 end = test_monotonic_time () + (gint64) timeout * 1000;
+
+    while (!cond (data)) {
+        if (test_monotonic_time () >= end)
+            return FALSE;
+        if (!g_main_context_iteration (NULL, FALSE))
+            g_usleep (POLL_INTERVAL);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+never (gpointer data)
+{
+    return FALSE;
+}
+
+void
+test_run_for (guint ms)
+{
+    test_wait_for (never, NULL, ms);
+}
+
+void
+test_flush (void)
+{
+    dbus_connection_flush (test_system_bus ());
+    while (g_main_context_iteration (NULL, FALSE))
+        ;
+}
+
+// Blocking call to a control interface, the arguments are like in
+// dbus_message_append_args (), the reply must be unreferenced
+static DBusMessage *
+call_valist (const gchar *service, const gchar *path,
+        const gchar *interface, const gchar *method, int first_arg_type,
+        va_list args)
+{
+    DBusMessage *msg = dbus_message_new_method_call (service, path,
+            interface, method);
+    g_assert (msg != NULL);
+    dbus_message_append_args_valist (msg, first_arg_type, args);
+
+    DBusError error;
+    dbus_error_init (&error);
+    DBusMessage *reply = dbus_connection_send_with_reply_and_block (
+            test_system_bus (), msg, TEST_TIMEOUT, &error);
+    if (reply == NULL)
+        g_error ("%s %s failed: %s", interface, method, error.message);
+    dbus_message_unref (msg);
+
+    return reply;
+}
+
+// Calls the fake MCE control interface, see call_valist ()
+static DBusMessage *
+call (const gchar *method, int first_arg_type, ...)
+{
+    va_list args;
+    va_start (args, first_arg_type);
+    DBusMessage *reply = call_valist (MCE_SERVICE, FAKE_MCE_PATH,
+            FAKE_MCE_INTERFACE, method, first_arg_type, args);
+    va_end (args);
+
+    return reply;
+}
+
+// Calls the fake BME control interface, see call_valist ()
+static DBusMessage *
+bme_call (const gchar *method, int first_arg_type, ...)
+{
+    va_list args;
+    va_start (args, first_arg_type);
+    DBusMessage *reply = call_valist (FAKE_BME_SERVICE, FAKE_BME_PATH,
+            FAKE_BME_INTERFACE, method, first_arg_type, args);
+    va_end (args);
+
+    return reply;
+}
+
+static gboolean
+mce_has_owner (gpointer running)
+{
+    gboolean owned = dbus_bus_name_has_owner (test_system_bus (),
+            MCE_SERVICE, NULL);
+    return owned == GPOINTER_TO_INT (running);
+}
+
+static gboolean
+bme_has_owner (gpointer running)
+{
+    gboolean owned = dbus_bus_name_has_owner (test_system_bus (),
+            FAKE_BME_SERVICE, NULL);
+    return owned == GPOINTER_TO_INT (running);
+}
+
+// run-tests uses the same bus as the session one
+static gboolean
+daemon_has_owner (gpointer running)
+{
+    gboolean owned = dbus_bus_name_has_owner (test_system_bus (),
+            SADBA_SERVICE, NULL);
+    return owned == GPOINTER_TO_INT (running);
+}
+
+// Starts the program in $env (or fallback), not reaped by us, so GLib does
+// it
+static void
+spawn_fake (const gchar *env, const gchar *fallback)
+{
+    const gchar *path = g_getenv (env);
+    gchar *argv[] = { (gchar *) (path != NULL ? path : fallback), NULL };
+    GError *error = NULL;
+
+    if (!g_spawn_async (NULL, argv, NULL, 0, NULL, NULL, NULL, &error))
+        g_error ("Can't start %s: %s", argv[0], error->message);
+}
+
+void
+fake_mce_start (void)
+{
+    spawn_fake ("FAKE_MCE", "./fake-mce");
+    if (!test_wait_for (mce_has_owner, GINT_TO_POINTER (TRUE), TEST_TIMEOUT))
+        g_error ("The fake MCE didn't get the %s name", MCE_SERVICE);
+}
+
+void
+fake_mce_stop (void)
+{
+    dbus_message_unref (call (FAKE_MCE_QUIT, DBUS_TYPE_INVALID));
+
+    if (!test_wait_for (mce_has_owner, GINT_TO_POINTER (FALSE),
+                TEST_TIMEOUT))
+        g_error ("The fake MCE didn't quit");
+}
+
+void
+fake_mce_set_display (const gchar *status)
+{
+    dbus_message_unref (call (FAKE_MCE_SET_DISPLAY, DBUS_TYPE_STRING,
+                &status, DBUS_TYPE_INVALID));
+    // the signal is queued before the reply
+    test_flush ();
+}
+
+void
+fake_mce_set_tklock (const gchar *mode)
+{
+    dbus_message_unref (call (FAKE_MCE_SET_TKLOCK, DBUS_TYPE_STRING, &mode,
+                DBUS_TYPE_INVALID));
+    test_flush ();
+}
+
+guint
+fake_mce_get_keepalives (gint64 *last)
+{
+    DBusMessage *reply = call (FAKE_MCE_GET_KEEPALIVES, DBUS_TYPE_INVALID);
+
+    dbus_uint32_t count;
+    dbus_int64_t l;
+    gboolean ok = dbus_message_get_args (reply, NULL, DBUS_TYPE_UINT32,
+            &count, DBUS_TYPE_INT64, &l, DBUS_TYPE_INVALID);
+    g_assert (ok);
+    dbus_message_unref (reply);
+
+    if (last != NULL)
+        *last = l;
+
+    return count;
+}
+
+guint
+fake_mce_get_cancels (void)
+{
+    DBusMessage *reply = call (FAKE_MCE_GET_CANCELS, DBUS_TYPE_INVALID);
+
+    dbus_uint32_t count;
+    gboolean ok = dbus_message_get_args (reply, NULL, DBUS_TYPE_UINT32,
+            &count, DBUS_TYPE_INVALID);
+    g_assert (ok);
+    dbus_message_unref (reply);
+
+    return count;
+}
+
+void
+fake_mce_reset (void)
+{
+    dbus_message_unref (call (FAKE_MCE_RESET, DBUS_TYPE_INVALID));
+}
+
+void
+fake_bme_start (void)
+{
+    spawn_fake ("FAKE_BME", "./fake-bme");
+    if (!test_wait_for (bme_has_owner, GINT_TO_POINTER (TRUE), TEST_TIMEOUT))
+        g_error ("The fake BME didn't get the %s name", FAKE_BME_SERVICE);
+}
+
+void
+fake_bme_stop (void)
+{
+    dbus_message_unref (bme_call (FAKE_BME_QUIT, DBUS_TYPE_INVALID));
+
+    if (!test_wait_for (bme_has_owner, GINT_TO_POINTER (FALSE),
+                TEST_TIMEOUT))
+        g_error ("The fake BME didn't quit");
+}
+
+void
+fake_bme_set_charger (gboolean connected)
+{
+    dbus_bool_t c = connected;
+    dbus_message_unref (bme_call (FAKE_BME_SET_CHARGER, DBUS_TYPE_BOOLEAN,
+                &c, DBUS_TYPE_INVALID));
+    test_flush ();
+}
+
+void
+fake_bme_set_battery (guint now, guint max)
+{
+    dbus_uint32_t n = now, m = max;
+    dbus_message_unref (bme_call (FAKE_BME_SET_BATTERY, DBUS_TYPE_UINT32,
+                &n, DBUS_TYPE_UINT32, &m, DBUS_TYPE_INVALID));
+    test_flush ();
+}
+
+GPid
+test_daemon_start (void)
+{
+    const gchar *path = g_getenv ("SADBAD");
+    gchar *argv[] = { (gchar *) (path != NULL ? path : "../src/sadbad"),
+        NULL };
+    GPid pid;
+    GError *error = NULL;
+
+    if (!g_spawn_async (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL,
+                NULL, &pid, &error))
+        g_error ("Can't start the daemon: %s", error->message);
+
+    if (!test_wait_for (daemon_has_owner, GINT_TO_POINTER (TRUE),
+                TEST_TIMEOUT))
+        g_error ("The daemon didn't get the %s name", SADBA_SERVICE);
+
+    return pid;
+}
+
+void
+test_daemon_stop (GPid pid)
+{
+    kill (pid, SIGTERM);
+    waitpid (pid, NULL, 0);
+    g_spawn_close_pid (pid);
+
+    if (!test_wait_for (daemon_has_owner, GINT_TO_POINTER (FALSE),
+                TEST_TIMEOUT))
+        g_error ("The daemon didn't quit");
+}
+
+guint
+test_daemon_get_state (void)
+{
+    DBusMessage *msg = dbus_message_new_method_call (SADBA_SERVICE,
+            SADBA_PATH, SADBA_INTERFACE, SADBA_GET_STATE);
+    g_assert (msg != NULL);
+    DBusMessage *reply = dbus_connection_send_with_reply_and_block (
+            test_system_bus (), msg, TEST_TIMEOUT, NULL);
+    dbus_message_unref (msg);
+    g_assert (reply != NULL);
+
+    dbus_uint32_t state, remaining;
+    gboolean ok = dbus_message_get_args (reply, NULL, DBUS_TYPE_UINT32,
+            &state, DBUS_TYPE_UINT32, &remaining, DBUS_TYPE_INVALID);
+    g_assert (ok);
+    dbus_message_unref (reply);
+
+    return state;
+}
@@ -0,0 +1,91 @@
+/***********************************************************************************
+ *  Display blanking status area plugin
+ *  Copyright (C) 2012 Leandro Lucarella
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ ***********************************************************************************/
+
+// Helpers shared by the tests. They expect the environment set up by
+// run-tests: private buses and the paths of the fake MCE, the fake BME and
+// the daemon in $FAKE_MCE, $FAKE_BME and $SADBAD.
+
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <glib.h>
+#include <dbus/dbus.h>
+
+// How long to wait for something that should happen right away, in ms
+#define TEST_TIMEOUT 5000
+
+typedef gboolean (*TestCondition) (gpointer data);
+
+// Connection to the private system bus, integrated with the GLib main loop
+DBusConnection *test_system_bus (void);
+
+gint64 test_monotonic_time (void); // in microseconds
+
+// Runs the main loop until cond returns TRUE, returns FALSE if it didn't
+// after timeout ms
+gboolean test_wait_for (TestCondition cond, gpointer data, guint timeout);
+
+// Runs the main loop for ms milliseconds
+void test_run_for (guint ms);
+
+// Dispatches the messages and events that are already queued
+void test_flush (void);
+
+// Starts the fake MCE and waits until it owns the MCE name
+void fake_mce_start (void);
+
+// Stops the fake MCE and waits until the MCE name is gone
+void fake_mce_stop (void);
+
+void fake_mce_set_display (const gchar *status);
+
+void fake_mce_set_tklock (const gchar *mode);
+
+// Blank pause requests received, last is when the last one arrived (in
+// monotonic microseconds), it can be NULL
+guint fake_mce_get_keepalives (gint64 *last);
+
+// Blank pause cancel requests received
+guint fake_mce_get_cancels (void);
+
+void fake_mce_reset (void);
+
+// Starts the fake BME and waits until it owns the BME name, it reports a
+// full battery and no charger until told otherwise
+void fake_bme_start (void);
+
+// Stops the fake BME and waits until the BME name is gone
+void fake_bme_stop (void);
+
+void fake_bme_set_charger (gboolean connected);
+
+// The battery level in "bars", like BME reports it
+void fake_bme_set_battery (guint now, guint max);
+
+// Starts the inhibition daemon ($SADBAD) and waits until it owns its name
+GPid test_daemon_start (void);
+
+// Terminates the daemon and waits until its name is gone
+void test_daemon_stop (GPid pid);
+
+// The daemon aggregate state (an InhibitEngineState)
+guint test_daemon_get_state (void);
+
+#endif // TEST_UTIL_H